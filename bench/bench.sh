@@ -0,0 +1,102 @@
+#!/bin/sh
+#
+# Benchmarks of actFileTool on synthetic tracks (see mkTrk.c).
+# Run it from the top directory; e.g. with "make bench". By
+# default all the benchmarks are run; or pass the names of
+# the ones to run. The following environment variables can
+# be used to override the defaults:
+#
+#   ACT         actFileTool binary to benchmark; e.g. one built
+#               with -O2, or from an older commit
+#   BENCH_DIR   directory where the track files are generated
+#   RUNS        number of runs of each command
+#
+
+ACT=${ACT:-./actFileTool}
+BENCH_DIR=${BENCH_DIR:-/tmp/actFileTool-bench}
+RUNS=${RUNS:-5}
+
+mkdir -p "$BENCH_DIR" || exit 1
+
+# Generate the given track file, unless it is already there
+mkTrk() {
+    file="$BENCH_DIR/$1"
+    shift
+    if [ ! -f "$file" ]; then
+        bench/mkTrk "$@" > "$file.tmp" && mv "$file.tmp" "$file" || exit 1
+    fi
+}
+
+# Run the given command and report its best wall time and
+# its peak RSS.
+run() {
+    label=$1
+    shift
+    printf "  %-36s " "$label:"
+    bench/timeCmd -n "$RUNS" "$@" || exit 1
+}
+
+# Every file in the SampleGpxFiles and SampleTcxFiles dirs,
+# one --summary run per file, to show the parsing cost per
+# line of input. A few of the sample files are rejected on
+# purpose (e.g. a GPX route, or a track without points), so
+# their exit status is ignored. The time includes the start
+# up of each run, which is small next to the parsing.
+bench_parse() {
+    for dir in SampleGpxFiles SampleTcxFiles; do
+        numLines=$(cat $dir/* | wc -l)
+        printf "  %-36s " "$dir --summary:"
+        bench/timeCmd -n "$RUNS" -l "$numLines" sh -c \
+            'act=$1; shift; for f; do "$act" --summary "$f"; done; exit 0' \
+            sh "$ACT" $dir/* || exit 1
+    done
+}
+
+# 1M-point GPX track: CSV output, which is dominated by the
+# output formatting, and a compute-bound summary run.
+bench_array() {
+    mkTrk trk1m.gpx --points 1000000
+    run "1M GPX --output-format csv" "$ACT" --output-format csv "$BENCH_DIR/trk1m.gpx"
+    run "1M GPX --summary --xma-window 5" "$ACT" --summary --xma-window 5 "$BENCH_DIR/trk1m.gpx"
+}
+
+# 1M-point GPX track read through a FIFO, so the input file
+# is not mapped and the peak RSS is that of the TrkPt storage.
+# Run it with ACT pointing to a "make FLOAT_METRICS=1" or a
+# "make FIXED_POINT=1" build to compare the storage formats.
+bench_storage() {
+    mkTrk trk1m.gpx --points 1000000
+    fifo="$BENCH_DIR/fifo.gpx"
+    [ -p "$fifo" ] || mkfifo "$fifo" || exit 1
+    run "1M GPX --summary (FIFO)" sh -c "cat $BENCH_DIR/trk1m.gpx > $fifo & exec $ACT --summary $fifo"
+}
+
+# 40k-point GPX and TCX tracks where ~30% of the points are
+# duplicates or stopped points, all of which get discarded.
+bench_noisy() {
+    mkTrk noisy40k.gpx --points 40000 --noise 30
+    mkTrk noisy40k.tcx --points 40000 --noise 30 --format tcx
+    run "40k noisy GPX --summary" "$ACT" --summary "$BENCH_DIR/noisy40k.gpx"
+    run "40k noisy TCX --summary" "$ACT" --summary "$BENCH_DIR/noisy40k.tcx"
+}
+
+# Three consecutive 1M-point GPX tracks plus a 400k-point
+# FIT track, parsed in parallel and merged into one track.
+bench_merge() {
+    mkTrk trk1m.gpx --points 1000000
+    mkTrk trk1m-2.gpx --points 1000000 --start-time 1651000000
+    mkTrk trk1m-3.gpx --points 1000000 --start-time 1652000000
+    mkTrk trk400k-4.fit --points 400000 --start-time 1653000000 --format fit
+    run "3x1M GPX + 400k FIT --threads 3" "$ACT" --summary --threads 3 \
+        "$BENCH_DIR/trk1m.gpx" "$BENCH_DIR/trk1m-2.gpx" "$BENCH_DIR/trk1m-3.gpx" "$BENCH_DIR/trk400k-4.fit"
+}
+
+if [ $# -eq 0 ]; then
+    set -- parse array storage noisy merge
+fi
+
+echo "$ACT (best of $RUNS runs)"
+for name in "$@"; do
+    echo "$name:"
+    bench_$name
+done
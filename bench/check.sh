@@ -0,0 +1,77 @@
+#!/bin/sh
+#
+# Consistency checks of actFileTool on synthetic tracks (see
+# mkTrk.c). Run it from the top directory; e.g. with "make
+# check". By default all the checks are run; or pass the names
+# of the ones to run. The following environment variables can
+# be used to override the defaults:
+#
+#   ACT         actFileTool binary to check
+#   BENCH_DIR   directory where the track files are generated
+#   THREADS     number of threads of the parallel runs
+#
+
+ACT=${ACT:-./actFileTool}
+BENCH_DIR=${BENCH_DIR:-/tmp/actFileTool-bench}
+THREADS=${THREADS:-4}
+
+mkdir -p "$BENCH_DIR" || exit 1
+
+numFailed=0
+
+# Generate the given track file, unless it is already there
+mkTrk() {
+    file="$BENCH_DIR/$1"
+    shift
+    if [ ! -f "$file" ]; then
+        bench/mkTrk "$@" > "$file.tmp" && mv "$file.tmp" "$file" || exit 1
+    fi
+}
+
+# Report the result of the given check
+result() {
+    if [ $2 -eq 0 ]; then
+        printf "  %-44s OK\n" "$1:"
+    else
+        printf "  %-44s FAILED\n" "$1:"
+        numFailed=$((numFailed + 1))
+    fi
+}
+
+# Six consecutive pieces of the same track in FIT format, one
+# of them with duplicate and stopped points, decoded one after
+# another and then all at once by parallel threads. The CSV
+# output, which lists every TrkPt, must be the same.
+check_threads() {
+    mkTrk chk1.fit --points 200000 --format fit
+    mkTrk chk2.fit --points 50000 --skip 200000 --format fit
+    mkTrk chk3.fit --points 300000 --skip 250000 --format fit
+    mkTrk chk4.fit --points 1000 --skip 550000 --format fit
+    mkTrk chk5.fit --points 100000 --skip 551000 --format fit --noise 20
+    mkTrk chk6.fit --points 150000 --skip 651000 --format fit
+    set -- "$BENCH_DIR"/chk1.fit "$BENCH_DIR"/chk2.fit "$BENCH_DIR"/chk3.fit \
+           "$BENCH_DIR"/chk4.fit "$BENCH_DIR"/chk5.fit "$BENCH_DIR"/chk6.fit
+    "$ACT" --output-format csv --threads 1 "$@" > "$BENCH_DIR/chk-seq.csv" 2> /dev/null &&
+    "$ACT" --output-format csv --threads "$THREADS" "$@" > "$BENCH_DIR/chk-par.csv" 2> /dev/null &&
+    cmp "$BENCH_DIR/chk-seq.csv" "$BENCH_DIR/chk-par.csv"
+    result "6 FIT files, --threads 1 vs $THREADS" $?
+}
+
+# The bulk FIT CRC, which checks whole spans of the file at a
+# time, against the per-byte reference one.
+check_crc() {
+    bench/fitCrcCheck > /dev/null
+    result "FitCRC_Update16() vs FitCRC_Get16()" $?
+}
+
+if [ $# -eq 0 ]; then
+    set -- threads crc
+fi
+
+echo "$ACT"
+for name in "$@"; do
+    echo "$name:"
+    check_$name
+done
+
+[ $numFailed -eq 0 ]
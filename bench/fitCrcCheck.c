@@ -0,0 +1,99 @@
+/*=========================================================================
+ *
+ *   Filename:           fitCrcCheck.c
+ *
+ *   Author:             Marcelo Mourier
+ *   Created:            Fri Oct 16 09:40:12 MDT 2026
+ *
+ *   Description:        Check the bulk FIT CRC against the per-byte one
+ *
+ *=========================================================================
+ *
+ *                  Copyright (c) 2026 Marcelo Mourier
+ *
+ *=========================================================================
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "fit_crc.h"
+
+#define BUF_SIZE    (64 * 1024)
+#define NUM_SPANS   2000
+
+static uint64_t seed = 0x9E3779B97F4A7C15ULL;
+
+// Pseudo-random value (xorshift64)
+static uint64_t rnd(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+
+    return seed;
+}
+
+// Reference implementation: one byte at a time
+static FIT_UINT16 refCrc(FIT_UINT16 crc, const FIT_UINT8 *data, FIT_UINT32 size)
+{
+    FIT_UINT32 n;
+
+    for (n = 0; n < size; n++) {
+        crc = FitCRC_Get16(crc, data[n]);
+    }
+
+    return crc;
+}
+
+int main(void)
+{
+    static FIT_UINT8 buf[BUF_SIZE];
+    const char *check = "123456789";
+    int numFailed = 0;
+    FIT_UINT16 crc;
+    int n;
+
+    // Standard check value of the CRC-16/ARC used by FIT
+    if ((crc = FitCRC_Calc16(check, strlen(check))) != 0xBB3D) {
+        fprintf(stderr, "FitCRC_Calc16(\"%s\") = 0x%04X, expected 0xBB3D\n", check, crc);
+        numFailed++;
+    }
+
+    for (n = 0; n < BUF_SIZE; n++) {
+        buf[n] = (FIT_UINT8) rnd();
+    }
+
+    // Random spans, at any alignment, with random initial
+    // CRC values. Most of them are short, as the FIT decoder
+    // often checks just a few bytes at a time, but some span
+    // the whole buffer.
+    for (n = 0; n < NUM_SPANS; n++) {
+        FIT_UINT32 maxSize = ((n % 10) == 0) ? BUF_SIZE : 64;
+        FIT_UINT32 offset = rnd() % BUF_SIZE;
+        FIT_UINT32 size = rnd() % (maxSize + 1);
+        FIT_UINT16 init = (FIT_UINT16) rnd();
+        FIT_UINT16 expCrc;
+
+        if (size > (BUF_SIZE - offset)) {
+            size = BUF_SIZE - offset;
+        }
+
+        expCrc = refCrc(init, &buf[offset], size);
+        if ((crc = FitCRC_Update16(init, &buf[offset], size)) != expCrc) {
+            fprintf(stderr, "FitCRC_Update16(0x%04X, buf+%u, %u) = 0x%04X, expected 0x%04X\n",
+                    init, offset, size, crc, expCrc);
+            numFailed++;
+        }
+    }
+
+    if (numFailed != 0) {
+        fprintf(stderr, "%d FIT CRC checks failed !!!\n", numFailed);
+        return -1;
+    }
+
+    printf("FIT CRC: %d spans OK\n", NUM_SPANS);
+
+    return 0;
+}
@@ -0,0 +1,433 @@
+/*=========================================================================
+ *
+ *   Filename:           mkTrk.c
+ *
+ *   Author:             Marcelo Mourier
+ *   Created:            Fri Oct 16 08:12:40 MDT 2026
+ *
+ *   Description:        Synthetic track generator used by the benchmarks
+ *
+ *=========================================================================
+ *
+ *                  Copyright (c) 2026 Marcelo Mourier
+ *
+ *=========================================================================
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define EARTH_RADIUS    6371008.8   // mean radius (in meters)
+#define DEG_TO_RAD      (M_PI / 180.0)
+
+#define FIT_EPOCH       631065600   // 1989-12-31T00:00:00Z
+#define FIT_HDR_SIZE    14
+#define FIT_FILE_ID_SIZE    (6 + (3 * 3) + 8)   // definition + data message
+#define FIT_RECORD_DEF_SIZE (6 + (9 * 3))
+#define FIT_RECORD_SIZE     25
+
+typedef enum Format {
+    gpx,
+    tcx,
+    fit,
+} Format;
+
+// State of the synthetic rider. The track loops around in
+// circles of ~20 km, with rolling hills, so any number of
+// points stay within a small area. The pseudo-random noise
+// comes from a fixed seed, so the same arguments always
+// generate the same file.
+typedef struct TrkState {
+    uint64_t seed;      // xorshift64 state
+    long n;             // number of points generated so far
+    time_t time;        // seconds since the Epoch
+    double lat;         // in degrees
+    double lon;         // in degrees
+    double ele;         // in meters
+    double distance;    // in meters
+    double speed;       // in m/s
+    int heartRate;
+    int cadence;
+    int power;
+} TrkState;
+
+static uint16_t fitCrc;     // CRC of the FIT file written so far
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [--format {gpx|tcx|fit}] [--noise <pct>] [--points <num>] [--skip <num>] [--start-time <sec>]\n"
+                    "\n"
+                    "Writes a synthetic track with the specified number of points (1M by\n"
+                    "default), recorded at 1 Hz starting at the specified time (in seconds\n"
+                    "since the Epoch), to standard output. With --noise, the specified\n"
+                    "percentage of the points are either duplicates of the previous point\n"
+                    "(same timestamp) or stopped points (same position and distance, one\n"
+                    "second later). With --skip, the track starts after the specified\n"
+                    "number of points, so consecutive pieces of the same track can be\n"
+                    "written to different files.\n", prog);
+}
+
+// Uniform pseudo-random value in [0,1)
+static double rnd(TrkState *pState)
+{
+    uint64_t x = pState->seed;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    pState->seed = x;
+
+    return (double) (x >> 11) / 9007199254740992.0;
+}
+
+static void nextPoint(TrkState *pState)
+{
+    double bearing;
+
+    pState->n++;
+    pState->time++;
+    pState->speed = 6.0 + (2.0 * sin(pState->n / 300.0)) + (0.5 * rnd(pState));
+    bearing = (pState->n * (2.0 * M_PI / 3600.0)) + (0.2 * (rnd(pState) - 0.5));
+    pState->lat += ((pState->speed * cos(bearing)) / EARTH_RADIUS) / DEG_TO_RAD;
+    pState->lon += ((pState->speed * sin(bearing)) / (EARTH_RADIUS * cos(pState->lat * DEG_TO_RAD))) / DEG_TO_RAD;
+    pState->ele += (0.04 * pState->speed * sin(pState->n / 500.0)) + (0.2 * (rnd(pState) - 0.5));
+    pState->distance += pState->speed;
+    pState->heartRate = 120 + (int) (30.0 * sin(pState->n / 900.0)) + (int) (5.0 * rnd(pState));
+    pState->cadence = 80 + (int) (15.0 * rnd(pState));
+    pState->power = 150 + (int) (100.0 * rnd(pState));
+}
+
+static const char *fmtTime(time_t t)
+{
+    static char fmtBuf[32];
+    struct tm brkDwnTime;
+
+    gmtime_r(&t, &brkDwnTime);
+    strftime(fmtBuf, sizeof (fmtBuf), "%Y-%m-%dT%H:%M:%SZ", &brkDwnTime);
+
+    return fmtBuf;
+}
+
+static void printGpxHeader(const TrkState *pState)
+{
+    printf("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+           "<gpx creator=\"mkTrk\" version=\"1.1\"\n"
+           "  xmlns=\"http://www.topografix.com/GPX/1/1\"\n"
+           "  xmlns:ns3=\"http://www.garmin.com/xmlschemas/TrackPointExtension/v1\">\n"
+           "  <metadata>\n"
+           "    <time>%s</time>\n"
+           "  </metadata>\n"
+           "  <trk>\n"
+           "    <name>Synthetic Track</name>\n"
+           "    <type>cycling</type>\n"
+           "    <trkseg>\n", fmtTime(pState->time));
+}
+
+static void printGpxTrkPt(const TrkState *pState)
+{
+    printf("      <trkpt lat=\"%.10lf\" lon=\"%.10lf\">\n"
+           "        <ele>%.1lf</ele>\n"
+           "        <time>%s</time>\n"
+           "        <extensions>\n"
+           "          <power>%d</power>\n"
+           "          <ns3:TrackPointExtension>\n"
+           "            <ns3:hr>%d</ns3:hr>\n"
+           "            <ns3:cad>%d</ns3:cad>\n"
+           "          </ns3:TrackPointExtension>\n"
+           "        </extensions>\n"
+           "      </trkpt>\n",
+           pState->lat, pState->lon, pState->ele, fmtTime(pState->time),
+           pState->power, pState->heartRate, pState->cadence);
+}
+
+static void printGpxTrailer(void)
+{
+    printf("    </trkseg>\n"
+           "  </trk>\n"
+           "</gpx>\n");
+}
+
+static void printTcxHeader(const TrkState *pState)
+{
+    const char *startTime = fmtTime(pState->time);
+
+    printf("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+           "<TrainingCenterDatabase\n"
+           "  xmlns=\"http://www.garmin.com/xmlschemas/TrainingCenterDatabase/v2\"\n"
+           "  xmlns:ns3=\"http://www.garmin.com/xmlschemas/ActivityExtension/v2\">\n"
+           "  <Activities>\n"
+           "    <Activity Sport=\"Biking\">\n"
+           "      <Id>%s</Id>\n"
+           "      <Lap StartTime=\"%s\">\n"
+           "        <Track>\n", startTime, startTime);
+}
+
+static void printTcxTrkPt(const TrkState *pState)
+{
+    printf("          <Trackpoint>\n"
+           "            <Time>%s</Time>\n"
+           "            <Position>\n"
+           "              <LatitudeDegrees>%.10lf</LatitudeDegrees>\n"
+           "              <LongitudeDegrees>%.10lf</LongitudeDegrees>\n"
+           "            </Position>\n"
+           "            <AltitudeMeters>%.1lf</AltitudeMeters>\n"
+           "            <DistanceMeters>%.2lf</DistanceMeters>\n"
+           "            <HeartRateBpm>\n"
+           "              <Value>%d</Value>\n"
+           "            </HeartRateBpm>\n"
+           "            <Cadence>%d</Cadence>\n"
+           "            <Extensions>\n"
+           "              <ns3:TPX>\n"
+           "                <ns3:Speed>%.3lf</ns3:Speed>\n"
+           "                <ns3:Watts>%d</ns3:Watts>\n"
+           "              </ns3:TPX>\n"
+           "            </Extensions>\n"
+           "          </Trackpoint>\n",
+           fmtTime(pState->time), pState->lat, pState->lon, pState->ele, pState->distance,
+           pState->heartRate, pState->cadence, pState->speed, pState->power);
+}
+
+static void printTcxTrailer(void)
+{
+    printf("        </Track>\n"
+           "      </Lap>\n"
+           "    </Activity>\n"
+           "  </Activities>\n"
+           "</TrainingCenterDatabase>\n");
+}
+
+static uint16_t fitCrc16(uint16_t crc, uint8_t byte)
+{
+    static const uint16_t crcTable[16] = {
+        0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
+        0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400
+    };
+    uint16_t tmp;
+
+    // Compute checksum of the lower four bits of the byte
+    tmp = crcTable[crc & 0xF];
+    crc = (crc >> 4) & 0x0FFF;
+    crc = crc ^ tmp ^ crcTable[byte & 0xF];
+
+    // Now compute checksum of the upper four bits of the byte
+    tmp = crcTable[crc & 0xF];
+    crc = (crc >> 4) & 0x0FFF;
+    crc = crc ^ tmp ^ crcTable[(byte >> 4) & 0xF];
+
+    return crc;
+}
+
+static void fitWrite(const uint8_t *buf, size_t len)
+{
+    for (size_t n = 0; n < len; n++) {
+        fitCrc = fitCrc16(fitCrc, buf[n]);
+    }
+    fwrite(buf, len, 1, stdout);
+}
+
+// FIT files are little-endian
+static uint8_t *fitPut16(uint8_t *p, uint16_t val)
+{
+    *p++ = (uint8_t) val;
+    *p++ = (uint8_t) (val >> 8);
+    return p;
+}
+
+static uint8_t *fitPut32(uint8_t *p, uint32_t val)
+{
+    p = fitPut16(p, (uint16_t) val);
+    return fitPut16(p, (uint16_t) (val >> 16));
+}
+
+// Writes the definition message of the given local message
+// type, as a list of {fieldNum, size, baseType} triplets.
+static void fitWriteDef(uint8_t localMesg, uint16_t globalMesg, const uint8_t *fields, uint8_t numFields)
+{
+    uint8_t buf[6];
+
+    buf[0] = 0x40 | localMesg;  // definition message header
+    buf[1] = 0;                 // reserved
+    buf[2] = 0;                 // little-endian
+    fitPut16(&buf[3], globalMesg);
+    buf[5] = numFields;
+    fitWrite(buf, sizeof (buf));
+    fitWrite(fields, numFields * 3);
+}
+
+static void printFitHeader(const TrkState *pState, long numPts)
+{
+    static const uint8_t fileIdFields[] = {
+        0, 1, 0x00,     // type (enum)
+        1, 2, 0x84,     // manufacturer (uint16)
+        4, 4, 0x86,     // time_created (uint32)
+    };
+    static const uint8_t recordFields[] = {
+        253, 4, 0x86,   // timestamp (uint32)
+        0, 4, 0x85,     // position_lat (sint32)
+        1, 4, 0x85,     // position_long (sint32)
+        2, 2, 0x84,     // altitude (uint16)
+        3, 1, 0x02,     // heart_rate (uint8)
+        4, 1, 0x02,     // cadence (uint8)
+        5, 4, 0x86,     // distance (uint32)
+        6, 2, 0x84,     // speed (uint16)
+        7, 2, 0x84,     // power (uint16)
+    };
+    uint32_t dataSize = FIT_FILE_ID_SIZE + FIT_RECORD_DEF_SIZE + (numPts * FIT_RECORD_SIZE);
+    uint8_t hdr[FIT_HDR_SIZE];
+    uint8_t buf[8];
+    uint8_t *p;
+    uint16_t crc = 0;
+
+    hdr[0] = FIT_HDR_SIZE;
+    hdr[1] = 0x10;              // protocol version 1.0
+    fitPut16(&hdr[2], 2178);    // profile version 21.78
+    fitPut32(&hdr[4], dataSize);
+    memcpy(&hdr[8], ".FIT", 4);
+    for (int n = 0; n < 12; n++) {
+        crc = fitCrc16(crc, hdr[n]);
+    }
+    fitPut16(&hdr[12], crc);
+    fitWrite(hdr, sizeof (hdr));
+
+    // FILE_ID message: activity file by Garmin
+    fitWriteDef(0, 0, fileIdFields, sizeof (fileIdFields) / 3);
+    p = buf;
+    *p++ = 0;   // local message type
+    *p++ = 4;   // activity
+    p = fitPut16(p, 1);
+    fitPut32(p, (uint32_t) (pState->time - FIT_EPOCH));
+    fitWrite(buf, sizeof (buf));
+
+    fitWriteDef(1, 20, recordFields, sizeof (recordFields) / 3);
+}
+
+static void printFitTrkPt(const TrkState *pState)
+{
+    uint8_t buf[FIT_RECORD_SIZE];
+    uint8_t *p = buf;
+
+    *p++ = 1;   // local message type
+    p = fitPut32(p, (uint32_t) (pState->time - FIT_EPOCH));
+    p = fitPut32(p, (uint32_t) (int32_t) lround((pState->lat / 180.0) * 0x7FFFFFFF));
+    p = fitPut32(p, (uint32_t) (int32_t) lround((pState->lon / 180.0) * 0x7FFFFFFF));
+    p = fitPut16(p, (uint16_t) lround((pState->ele + 500.0) * 5.0));
+    *p++ = (uint8_t) pState->heartRate;
+    *p++ = (uint8_t) pState->cadence;
+    p = fitPut32(p, (uint32_t) lround(pState->distance * 100.0));
+    p = fitPut16(p, (uint16_t) lround(pState->speed * 1000.0));
+    fitPut16(p, (uint16_t) pState->power);
+    fitWrite(buf, sizeof (buf));
+}
+
+static void printFitTrailer(void)
+{
+    uint8_t buf[2];
+
+    fitPut16(buf, fitCrc);
+    fwrite(buf, sizeof (buf), 1, stdout);
+}
+
+static void printHeader(Format format, const TrkState *pState, long numPts)
+{
+    if (format == gpx) {
+        printGpxHeader(pState);
+    } else if (format == tcx) {
+        printTcxHeader(pState);
+    } else {
+        printFitHeader(pState, numPts);
+    }
+}
+
+static void printTrkPt(Format format, const TrkState *pState)
+{
+    if (format == gpx) {
+        printGpxTrkPt(pState);
+    } else if (format == tcx) {
+        printTcxTrkPt(pState);
+    } else {
+        printFitTrkPt(pState);
+    }
+}
+
+static void printTrailer(Format format)
+{
+    if (format == gpx) {
+        printGpxTrailer();
+    } else if (format == tcx) {
+        printTcxTrailer();
+    } else {
+        printFitTrailer();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Format format = gpx;
+    long numPts = 1000000;
+    long numOut = 0;
+    long numSkip = 0;
+    double noise = 0.0;
+    TrkState state = {0};
+    int n;
+
+    state.seed = 0x9E3779B97F4A7C15ULL;
+    state.time = 1650000000;    // 2022-04-15T05:20:00Z
+    state.lat = 43.6230;
+    state.lon = -114.3528;
+    state.ele = 1700.0;
+
+    for (n = 1; n < argc; n++) {
+        if ((strcmp(argv[n], "--format") == 0) && ((n + 1) < argc)) {
+            const char *val = argv[++n];
+            if (strcmp(val, "gpx") == 0) {
+                format = gpx;
+            } else if (strcmp(val, "tcx") == 0) {
+                format = tcx;
+            } else if (strcmp(val, "fit") == 0) {
+                format = fit;
+            } else {
+                usage(argv[0]);
+                return -1;
+            }
+        } else if ((strcmp(argv[n], "--noise") == 0) && ((n + 1) < argc)) {
+            noise = atof(argv[++n]) / 100.0;
+        } else if ((strcmp(argv[n], "--points") == 0) && ((n + 1) < argc)) {
+            numPts = atol(argv[++n]);
+        } else if ((strcmp(argv[n], "--skip") == 0) && ((n + 1) < argc)) {
+            numSkip = atol(argv[++n]);
+        } else if ((strcmp(argv[n], "--start-time") == 0) && ((n + 1) < argc)) {
+            state.time = (time_t) atol(argv[++n]);
+        } else {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    while (state.n < numSkip) {
+        nextPoint(&state);
+    }
+
+    printHeader(format, &state, numPts);
+
+    while (numOut < numPts) {
+        if ((noise > 0.0) && (numOut != 0) && (rnd(&state) < noise)) {
+            // Repeat the previous point, either as is or
+            // as if the rider had stopped for a second.
+            if (rnd(&state) < 0.5) {
+                state.time++;
+            }
+        } else {
+            nextPoint(&state);
+        }
+        printTrkPt(format, &state);
+        numOut++;
+    }
+
+    printTrailer(format);
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+/*=========================================================================
+ *
+ *   Filename:           timeCmd.c
+ *
+ *   Author:             Marcelo Mourier
+ *   Created:            Fri Oct 16 08:12:40 MDT 2026
+ *
+ *   Description:        Run a command and report its wall time and peak RSS
+ *
+ *=========================================================================
+ *
+ *                  Copyright (c) 2026 Marcelo Mourier
+ *
+ *=========================================================================
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-n <runs>] [-l <lines>] <cmd> [<arg> ...]\n"
+                    "\n"
+                    "Runs the command the specified number of times (1 by default), with\n"
+                    "its output discarded, and reports the best wall time and the peak\n"
+                    "RSS of all the runs. With -l, it also reports the best wall time\n"
+                    "per line of input, given the number of lines the command reads.\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    int numRuns = 1;
+    long numLines = 0;
+    int argn = 1;
+    double bestTime = 0.0;
+    long maxRss = 0;    // in KB
+    int run;
+
+    while (((argn + 1) < argc) && (argv[argn][0] == '-')) {
+        if (strcmp(argv[argn], "-n") == 0) {
+            numRuns = atoi(argv[argn + 1]);
+        } else if (strcmp(argv[argn], "-l") == 0) {
+            numLines = atol(argv[argn + 1]);
+        } else {
+            usage(argv[0]);
+            return -1;
+        }
+        argn += 2;
+    }
+
+    if ((argn >= argc) || (numRuns < 1)) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    for (run = 0; run < numRuns; run++) {
+        struct timespec start, end;
+        struct rusage rusage;
+        double elapsed;
+        int status;
+        pid_t pid;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        if ((pid = fork()) < 0) {
+            perror("fork");
+            return -1;
+        } else if (pid == 0) {
+            int fd = open("/dev/null", O_WRONLY);
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            execvp(argv[argn], &argv[argn]);
+            _exit(127);
+        }
+
+        if (wait4(pid, &status, 0, &rusage) < 0) {
+            perror("wait4");
+            return -1;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+            fprintf(stderr, "Command failed: %s (status=0x%x)\n", argv[argn], status);
+            return -1;
+        }
+
+        elapsed = (double) (end.tv_sec - start.tv_sec) + ((double) (end.tv_nsec - start.tv_nsec) / 1e9);
+        if ((run == 0) || (elapsed < bestTime)) {
+            bestTime = elapsed;
+        }
+        if (rusage.ru_maxrss > maxRss) {
+            maxRss = rusage.ru_maxrss;
+        }
+    }
+
+    if (numLines > 0) {
+        printf("%.2lf s, %ld MB peak RSS, %.0lf ns/line (best of %d)\n", bestTime, (maxRss + 512) / 1024,
+               (bestTime * 1e9) / numLines, numRuns);
+    } else {
+        printf("%.2lf s, %ld MB peak RSS (best of %d)\n", bestTime, (maxRss + 512) / 1024, numRuns);
+    }
+
+    return 0;
+}
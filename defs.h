@@ -17,10 +17,9 @@
 #ifndef DEFS_H_
 #define DEFS_H_
 
+#include <stdint.h>
 #include <stdio.h>
 
-#include "tailq.h"
-
 // Program version info
 #define PROG_VER_MAJOR      1
 #define PROG_VER_MINOR      10
@@ -77,6 +76,26 @@ typedef enum XmaMetric {
     speed = 4,          // speed
 } XmaMetric;
 
+// Max number of metrics that can be smoothed out
+#define XMA_MAX_METRICS 4
+
+// Max size of the SMA/WMA window
+#define XMA_MAX_WINDOW  1000001
+
+// SMA/WMA settings of a metric
+typedef struct XmaSpec {
+    XmaMetric xmaMetric;    // metric to be smoothed out
+    XmaMethod xmaMethod;    // method to compute the Moving Average
+    int xmaWindow;          // size of the SMA/WMA window
+} XmaSpec;
+
+// Units used to specify a range of TrkPt's
+typedef enum SpanUnits {
+    byIndex = 0,        // TrkPt index
+    byTime = 1,         // time (in seconds) from the start
+    byDist = 2          // distance (in meters) from the start
+} SpanUnits;
+
 // Sensor data bit masks
 #define SD_NONE     0x00    // no metrics
 #define SD_ATEMP    0x01    // ambient temperature
@@ -87,8 +106,6 @@ typedef enum XmaMetric {
 
 // GPS Track Point
 typedef struct TrkPt {
-    TAILQ_ENTRY(TrkPt)   tqEntry;   // node in the trkPtList
-
     int index;          // TrkPt index (0..N-1)
 
     int lineNum;        // line number in the input FIT/GPX/TCX file
@@ -112,7 +129,6 @@ typedef struct TrkPt {
 
     // Computed metrics
     Bool adjGrade;      // grade was adjusted
-    double adjTime;     // adjusted timestamp
     double deltaG;      // grade diff with previous point (in %)
     double deltaS;      // speed diff with previous point (in m/s)
     double deltaT;      // time diff with previous point (in seconds)
@@ -124,12 +140,129 @@ typedef struct TrkPt {
     double grade;       // actual grade (in %)
 } TrkPt;
 
+// Storage type of the metrics computed for each TrkPt
+// (deltaG, dist, run, rise, etc.). By default they are
+// kept in double precision, but building with -DFLOAT_METRICS
+// stores them in single precision, at half the memory.
+#ifdef FLOAT_METRICS
+typedef float MetricVal;
+#else
+typedef double MetricVal;
+#endif
+
+// Storage type of the latitude/longitude and timestamp of
+// each TrkPt. By default they are kept in double precision,
+// but building with -DFIXED_POINT stores the coordinates as
+// 32-bit semicircles (as in the FIT format) and the timestamps
+// as 64-bit milliseconds. Use the coordToDeg()/degToCoord()
+// and timeToSec()/secToTime() helpers to convert them.
+#ifdef FIXED_POINT
+typedef int32_t CoordVal;   // in semicircles
+typedef int64_t TimeVal;    // in millisec since the Epoch
+#else
+typedef double CoordVal;    // in degrees decimal
+typedef double TimeVal;     // in seconds+millisec since the Epoch
+#endif
+
+// TrkPt flags
+#define TP_ADJ_GRADE    0x01    // grade was adjusted
+#define TP_DELETED      0x02    // marked for deletion
+
+// Input file a run of consecutive TrkPt's came from. As the
+// TrkPt's read from a given file are always numbered in
+// sequence, one entry per input file is all that is needed
+// to find the file of any TrkPt.
+typedef struct TrkPtSrc {
+    int index;          // index of the first TrkPt read from the file
+    const char *inFile; // input FIT/GPX/TCX file
+} TrkPtSrc;
+
+// Block of consecutive TrkPt's packed with a delta+varint
+// encoding (see packTrkPts()). This is only used to stage the
+// TrkPt's of an input file parsed in parallel with others;
+// the track the processing stages work on is never packed.
+typedef struct TrkPtsBlk {
+    int count;          // number of TrkPt's in the block
+    size_t len;         // length (in bytes) of the packed data
+    uint8_t *data;      // packed data
+} TrkPtsBlk;
+
+// GPS Track Points stored as a Structure of Arrays; i.e. one
+// array per TrkPt field, all indexed by the position of the
+// TrkPt in the track. That way the loops that only look at a
+// few fields (e.g. latitude and longitude) stream through
+// contiguous memory, instead of striding over whole TrkPt's.
+// See the TrkPt definition above for the meaning and units
+// of each field. The sensor values use the narrowest type
+// that holds them (the same ones used by the FIT format).
+typedef struct TrkPts {
+    int count;          // number of TrkPt's in the arrays
+    int max;            // number of TrkPt's allocated
+    int numDel;         // number of TrkPt's marked for deletion
+    void *buf;          // memory block that holds all the arrays
+
+    // Cold data: only used to identify the TrkPt's
+    int *index;
+    int *lineNum;
+    TrkPtSrc *srcs;     // input file of each run of TrkPt's
+    int numSrcs;        // number of entries in srcs[]
+    int *pos;           // position of each TrkPt by index, or -1
+    int numPos;         // number of entries in pos[]
+
+    // Blocks of TrkPt's that have been packed away, which
+    // come before the TrkPt's in the arrays. Only the private
+    // tracks of the parallel parser have any.
+    Bool pack;          // pack the TrkPt's as each block fills up
+    TrkPtsBlk *blks;
+    int numBlks;
+    int maxBlks;
+    uint8_t *blkBuf;    // scratch buffer used to pack a block
+
+    TimeVal *timestamp;
+
+    CoordVal *latitude;
+    CoordVal *longitude;
+    double *elevation;
+
+    int8_t *ambTemp;
+    uint8_t *cadence;
+    uint8_t *heartRate;
+    uint16_t *power;
+    double *speed;
+    double *distance;
+
+    uint8_t *flags;     // TP_xxx flags
+    MetricVal *deltaG;
+    MetricVal *deltaS;
+    MetricVal *deltaT;
+    MetricVal *dist;
+    MetricVal *rise;
+    MetricVal *run;
+
+    MetricVal *bearing;
+    double *grade;
+} TrkPts;
+
+// Interpolated state of the track at a given time or
+// distance, between the two TrkPt's that bracket it.
+typedef struct TrkPtState {
+    int p1;             // TrkPt at or before the seek value
+    int p2;             // TrkPt at or after the seek value
+    double frac;        // fraction of the way from p1 to p2
+    double timestamp;
+    double distance;
+    double latitude;
+    double longitude;
+    double elevation;
+    double speed;
+} TrkPtState;
+
 // GPS Track (sequence of Track Points)
 typedef struct GpsTrk {
-    // List of TrkPt's
-    TAILQ_HEAD(TrkPtList, TrkPt) trkPtList;
+    // TrkPt's, in track order
+    TrkPts trkPts;
 
-    // Number of TrkPt's in trkPtList
+    // Number of TrkPt's read from the input file(s)
     int numTrkPts;
 
     // Number of TrkPt's that had their elevation values
@@ -197,26 +330,28 @@ typedef struct GpsTrk {
     double minGrade;
     double minSpeed;
 
-    const TrkPt *maxCadenceTrkPt;   // TrkPt with max cadence value
-    const TrkPt *maxDeltaDTrkPt;    // TrkPt with max dist diff
-    const TrkPt *maxDeltaGTrkPt;    // TrkPt with max grade diff
-    const TrkPt *maxDeltaTTrkPt;    // TrkPt with max time diff
-    const TrkPt *maxElevTrkPt;      // TrkPt with max elevation value
-    const TrkPt *maxGradeTrkPt;     // TrkPt with max grade value
-    const TrkPt *maxHeartRateTrkPt; // TrkPt with max HR value
-    const TrkPt *maxPowerTrkPt;     // TrkPt with max power value
-    const TrkPt *maxSpeedTrkPt;     // TrkPt with max speed value
-    const TrkPt *maxTempTrkPt;      // TrkPt with max temp value
-
-    const TrkPt *minCadenceTrkPt;   // TrkPt with min cadence value
-    const TrkPt *minDeltaDTrkPt;    // TrkPt with min dist diff
-    const TrkPt *minDeltaTTrkPt;    // TrkPt with min time diff
-    const TrkPt *minElevTrkPt;      // TrkPt with max elevation value
-    const TrkPt *minGradeTrkPt;     // TrkPt with min grade value
-    const TrkPt *minHeartRateTrkPt; // TrkPt with min HR value
-    const TrkPt *minPowerTrkPt;     // TrkPt with min power value
-    const TrkPt *minSpeedTrkPt;     // TrkPt with min speed value
-    const TrkPt *minTempTrkPt;      // TrkPt with min temp value
+    // Position in the track of the TrkPt's with the max/min
+    // values, or -1 if there is no such TrkPt.
+    int maxCadenceTrkPt;            // TrkPt with max cadence value
+    int maxDeltaDTrkPt;             // TrkPt with max dist diff
+    int maxDeltaGTrkPt;             // TrkPt with max grade diff
+    int maxDeltaTTrkPt;             // TrkPt with max time diff
+    int maxElevTrkPt;               // TrkPt with max elevation value
+    int maxGradeTrkPt;              // TrkPt with max grade value
+    int maxHeartRateTrkPt;          // TrkPt with max HR value
+    int maxPowerTrkPt;              // TrkPt with max power value
+    int maxSpeedTrkPt;              // TrkPt with max speed value
+    int maxTempTrkPt;               // TrkPt with max temp value
+
+    int minCadenceTrkPt;            // TrkPt with min cadence value
+    int minDeltaDTrkPt;             // TrkPt with min dist diff
+    int minDeltaTTrkPt;             // TrkPt with min time diff
+    int minElevTrkPt;               // TrkPt with max elevation value
+    int minGradeTrkPt;              // TrkPt with min grade value
+    int minHeartRateTrkPt;          // TrkPt with min HR value
+    int minPowerTrkPt;              // TrkPt with min power value
+    int minSpeedTrkPt;              // TrkPt with min speed value
+    int minTempTrkPt;               // TrkPt with min temp value
 } GpsTrk;
 
 typedef struct CmdArgs {
@@ -237,18 +372,27 @@ typedef struct CmdArgs {
     Bool quiet;             // don't print any warning messages
     int rangeFrom;          // start point (inclusive)
     int rangeTo;            // end point (inclusive)
+    SpanUnits rangeUnits;   // units of the range values
+    double rangeStart;      // start time/distance of the range (inclusive)
+    double rangeEnd;        // end time/distance of the range (inclusive)
     TsFmt tsFmt;            // format of the timestamp value
     double setSpeed;        // speed to use to generate timestamps (in m/s)
     int trimFrom;           // start point to trim (inclusive)
     int trimTo;             // end point to trim (inclusive)
+    SpanUnits trimUnits;    // units of the trim values
+    double trimStart;       // start time/distance to trim (inclusive)
+    double trimEnd;         // end time/distance to trim (inclusive)
     Units units;            // type of units to display
     XmaMethod xmaMethod;    // method to compute the Moving Average
-    XmaMetric xmaMetric;    // metric to use for the SMA/WMA
     int xmaWindow;          // size of the SMA/WMA window
+    XmaSpec xmaSpecs[XMA_MAX_METRICS];  // metrics to use for the SMA/WMA
+    int numXmaSpecs;        // number of metrics to use for the SMA/WMA
     double startTime;       // start time for the activity
     Bool noElevAdj;         // do not auto-adjust the elevation
+    Bool fused;             // run all the processing stages in a single pass
     Bool summary;           // show data summary
     Bool verbatim;          // no data adjustments
+    int numThreads;         // max number of worker threads
 } CmdArgs;
 
 #ifdef __cplusplus
@@ -260,6 +404,18 @@ static __inline__ double kmToM(double km) { return (km * 1000.0); }
 static __inline__ double mpsToKph(double mps) { return (mps * 3.6); }
 static __inline__ double kphToMps(double kph) { return (kph / 3.6); }
 
+#ifdef FIXED_POINT
+static __inline__ double coordToDeg(CoordVal c) { return (((double) c / (double) 0x7FFFFFFF) * 180.0); }
+static __inline__ CoordVal degToCoord(double deg) { double c = (deg / 180.0) * (double) 0x7FFFFFFF; return (CoordVal) ((c < 0.0) ? (c - 0.5) : (c + 0.5)); }
+static __inline__ double timeToSec(TimeVal t) { return ((double) t / 1000.0); }
+static __inline__ TimeVal secToTime(double sec) { double t = sec * 1000.0; return (TimeVal) ((t < 0.0) ? (t - 0.5) : (t + 0.5)); }
+#else
+static __inline__ double coordToDeg(CoordVal c) { return c; }
+static __inline__ CoordVal degToCoord(double deg) { return deg; }
+static __inline__ double timeToSec(TimeVal t) { return t; }
+static __inline__ TimeVal secToTime(double sec) { return sec; }
+#endif  // FIXED_POINT
+
 #ifdef __cplusplus
 };
 #endif
@@ -25,19 +25,47 @@
 // Private Variables
 //////////////////////////////////////////////////////////////////////////////////
 
-static FIT_CONVERT_STATE state_struct;
-#define state  (&state_struct)
+#if !defined(FIT_CONVERT_MULTI_THREAD)
+   static FIT_CONVERT_STATE state_struct;
+   #define state  (&state_struct)
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////
+// Private Function Prototypes
+//////////////////////////////////////////////////////////////////////////////////
+
+#if defined(FIT_CONVERT_MULTI_THREAD)
+static FIT_CONVERT_RETURN FitConvert_Decode(FIT_CONVERT_STATE *state, const void *data, FIT_UINT32 size, FIT_BOOL return_message_numbers);
+#else
+static FIT_CONVERT_RETURN FitConvert_Decode(const void *data, FIT_UINT32 size, FIT_BOOL return_message_numbers);
+#endif
+static void FitConvert_SwapField(FIT_UINT8 *field, FIT_UINT8 size, FIT_UINT8 type_size);
+static void FitConvert_TerminateString(FIT_UINT8 *field, FIT_UINT8 length);
+static void FitConvert_CompilePlan(FIT_CONVERT_PLAN *plan, const FIT_MESG_CONVERT *convert);
+static void FitConvert_RunPlan(const FIT_CONVERT_PLAN *plan, const FIT_UINT8 *data, FIT_UINT8 *mesg);
 
 //////////////////////////////////////////////////////////////////////////////////
 // Public Functions
 //////////////////////////////////////////////////////////////////////////////////
 
 ///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+void FitConvert_Init(FIT_CONVERT_STATE *state, FIT_BOOL read_file_header)
+#else
 void FitConvert_Init(FIT_BOOL read_file_header)
+#endif
 {
+    FIT_UINT8 mesg_index;
+
     state->mesg_offset = 0;
     state->data_offset = 0;
 
+    state->mesg_count = 0;
+    state->num_mesg_filter = 0;
+
+    for (mesg_index = 0; mesg_index < FIT_LOCAL_MESGS; mesg_index++)
+        state->plans[mesg_index].status = FIT_CONVERT_PLAN_NONE;
+
 #if defined(FIT_CONVERT_CHECK_CRC)
     state->crc = 0;
 #endif
@@ -56,14 +84,68 @@ void FitConvert_Init(FIT_BOOL read_file_header)
 }
 
 ///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+FIT_CONVERT_RETURN FitConvert_Read(FIT_CONVERT_STATE *state, const void *data, FIT_UINT32 size)
+#else
 FIT_CONVERT_RETURN FitConvert_Read(const void *data, FIT_UINT32 size)
+#endif
 {
+#if defined(FIT_CONVERT_MULTI_THREAD)
+    return FitConvert_ReadExt(state, data, size, FIT_FALSE);
+#else
     return FitConvert_ReadExt(data, size, FIT_FALSE);
+#endif
 }
 
 ///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+FIT_CONVERT_RETURN FitConvert_ReadExt(FIT_CONVERT_STATE *state, const void *data, FIT_UINT32 size,
+        FIT_BOOL return_message_numbers)
+#else
 FIT_CONVERT_RETURN FitConvert_ReadExt(const void *data, FIT_UINT32 size,
         FIT_BOOL return_message_numbers)
+#endif
+{
+    FIT_CONVERT_RETURN ret;
+#if defined(FIT_CONVERT_CHECK_CRC)
+    // Every byte consumed while file_bytes_left > 0 is part of the
+    // file CRC, so rather than updating the CRC one byte at a time,
+    // run it over the whole span consumed by this call.
+    FIT_BOOL check_crc = (state->file_bytes_left > 0) ? FIT_TRUE : FIT_FALSE;
+    FIT_UINT32 crc_offset = state->data_offset;
+    FIT_UINT32 crc_end;
+#endif
+
+#if defined(FIT_CONVERT_MULTI_THREAD)
+    ret = FitConvert_Decode(state, data, size, return_message_numbers);
+#else
+    ret = FitConvert_Decode(data, size, return_message_numbers);
+#endif
+
+    if (ret == FIT_CONVERT_MESSAGE_AVAILABLE)
+        state->mesg_count++;
+
+#if defined(FIT_CONVERT_CHECK_CRC)
+    if (check_crc) {
+        crc_end = (ret == FIT_CONVERT_CONTINUE) ? size : state->data_offset;    // data_offset is reset on CONTINUE
+        state->crc = FitCRC_Update16(state->crc, (const FIT_UINT8 *) data + crc_offset, crc_end - crc_offset);
+
+        if ((ret == FIT_CONVERT_END_OF_FILE) && (state->crc != 0))
+            ret = FIT_CONVERT_ERROR;
+    }
+#endif
+
+    return ret;
+}
+
+///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+static FIT_CONVERT_RETURN FitConvert_Decode(FIT_CONVERT_STATE *state, const void *data, FIT_UINT32 size,
+        FIT_BOOL return_message_numbers)
+#else
+static FIT_CONVERT_RETURN FitConvert_Decode(const void *data, FIT_UINT32 size,
+        FIT_BOOL return_message_numbers)
+#endif
 {
     while (state->data_offset < size) {
         FIT_UINT8 datum = *((FIT_UINT8*) data + state->data_offset);
@@ -72,10 +154,6 @@ FIT_CONVERT_RETURN FitConvert_ReadExt(const void *data, FIT_UINT32 size,
         //printf("fit_convert: 0x%02X - %d\n",datum, state->decode_state);
 
         if (state->file_bytes_left > 0) {
-#if defined(FIT_CONVERT_CHECK_CRC)
-            state->crc = FitCRC_Get16(state->crc, datum);
-#endif
-
             state->file_bytes_left--;
 
             if (state->file_bytes_left == 1) { // CRC low byte.
@@ -84,11 +162,7 @@ FIT_CONVERT_RETURN FitConvert_ReadExt(const void *data, FIT_UINT32 size,
 
                 continue; // Next byte.
             } else if (state->file_bytes_left == 0) { // CRC high byte.
-#if defined(FIT_CONVERT_CHECK_CRC)
-                if (state->crc != 0)
-                    return FIT_CONVERT_ERROR;
-#endif
-
+                // The CRC itself is checked by FitConvert_ReadExt()
                 return FIT_CONVERT_END_OF_FILE;
             }
         }
@@ -152,11 +226,130 @@ FIT_CONVERT_RETURN FitConvert_ReadExt(const void *data, FIT_UINT32 size,
 
                     state->mesg_sizes[state->mesg_index] = 0;
                     state->dev_data_sizes[state->mesg_index] = 0;
+                    if (state->mesg_index < FIT_LOCAL_MESGS)
+                        state->plans[state->mesg_index].status = FIT_CONVERT_PLAN_NONE;
                     state->decode_state = FIT_CONVERT_DECODE_RESERVED1;
                 }
             }
 
             if (state->decode_state == FIT_CONVERT_DECODE_FIELD_DATA) {
+                FIT_CONVERT_PLAN *plan = FIT_NULL;
+                FIT_UINT32 total_size = (FIT_UINT32) state->mesg_sizes[state->mesg_index] + state->dev_data_sizes[state->mesg_index];
+
+                if (state->mesg_index < FIT_LOCAL_MESGS) {
+                    plan = &state->plans[state->mesg_index];
+
+                    if (plan->status == FIT_CONVERT_PLAN_NONE) {
+                        FIT_UINT8 index;
+
+                        FitConvert_CompilePlan(plan, &state->convert_table[state->mesg_index]);
+
+                        plan->skip = (state->num_mesg_filter > 0) ? FIT_TRUE : FIT_FALSE;
+                        for (index = 0; index < state->num_mesg_filter; index++) {
+                            if (state->mesg_filter[index] == state->convert_table[state->mesg_index].global_mesg_num) {
+                                plan->skip = FIT_FALSE;
+                                break;
+                            }
+                        }
+                    }
+                }
+
+                // Skip the payload of any data message filtered out by
+                // the caller. Messages the byte-wise decoder wouldn't
+                // return aren't counted, and neither would their fields
+                // be decoded (e.g. unknown messages). Messages with a
+                // timestamp field still need to be decoded, to keep
+                // track of the time for compressed timestamps; unless
+                // they are split across buffers, in which case they are
+                // decoded and returned as usual.
+                if ((plan != FIT_NULL) && plan->skip &&
+                    (state->mesg_sizes[state->mesg_index] > 0) &&
+                    ((plan->status == FIT_CONVERT_PLAN_READY) || (plan->mesg_def == FIT_NULL)) &&
+                    (!plan->has_timestamp ||
+                     (((size - state->data_offset) >= total_size) &&
+                      ((state->file_bytes_left == 0) || (state->file_bytes_left >= (total_size + 2)))))) {
+                    if ((state->convert_table[state->mesg_index].num_fields > 0) ||
+                        (state->dev_data_sizes[state->mesg_index] > 0)) {
+                        state->mesg_count++;
+                    }
+
+                    if (plan->has_timestamp) {
+                        memcpy(state->u.mesg, plan->init_mesg, plan->mesg_size);
+#if defined(FIT_CONVERT_TIME_RECORD)
+                        if (datum & FIT_HDR_TIME_REC_BIT)
+                            memcpy(&state->u.mesg[plan->timestamp_offset], &state->timestamp, sizeof(state->timestamp));
+#endif
+                        FitConvert_RunPlan(plan, (const FIT_UINT8 *) data + state->data_offset, state->u.mesg);
+
+#if defined(FIT_CONVERT_TIME_RECORD)
+                        if (*((FIT_UINT32 *) &state->u.mesg[plan->timestamp_offset]) != FIT_DATE_TIME_INVALID) {
+                            memcpy(&state->timestamp, &state->u.mesg[plan->timestamp_offset], sizeof(state->timestamp));
+                            state->last_time_offset = (FIT_UINT8) (state->timestamp & FIT_HDR_TIME_OFFSET_MASK);
+                        }
+#endif
+                    }
+
+                    state->mesg_offset = 0;
+                    state->field_index = 0;
+                    state->field_offset = 0;
+
+                    if (((size - state->data_offset) >= total_size) &&
+                        ((state->file_bytes_left == 0) || (state->file_bytes_left >= (total_size + 2)))) {
+                        state->data_offset += total_size;
+                        if (state->file_bytes_left > 0)
+                            state->file_bytes_left -= total_size;
+                        state->decode_state = FIT_CONVERT_DECODE_RECORD;
+                    } else {
+                        state->skip_bytes_left = total_size;
+                        state->decode_state = FIT_CONVERT_DECODE_SKIP_DATA;
+                    }
+                    break;
+                }
+
+                // If the whole message is in the buffer, and it doesn't
+                // run into the file CRC, decode it in one go using the
+                // plan compiled from its definition message.
+                if ((plan != FIT_NULL) && (plan->status == FIT_CONVERT_PLAN_READY) &&
+                    (state->mesg_sizes[state->mesg_index] > 0) &&
+                    ((size - state->data_offset) >= total_size) &&
+                    ((state->file_bytes_left == 0) || (state->file_bytes_left >= (total_size + 2)))) {
+                    state->mesg_def = plan->mesg_def;
+                    memcpy(state->u.mesg, plan->init_mesg, plan->mesg_size);
+
+#if defined(FIT_CONVERT_TIME_RECORD)
+                    if ((datum & FIT_HDR_TIME_REC_BIT) && (plan->timestamp_offset != FIT_UINT16_INVALID))
+                        memcpy(&state->u.mesg[plan->timestamp_offset], &state->timestamp, sizeof(state->timestamp));
+#endif
+
+                    FitConvert_RunPlan(plan, (const FIT_UINT8 *) data + state->data_offset, state->u.mesg);
+
+                    state->data_offset += total_size;
+                    if (state->file_bytes_left > 0)
+                        state->file_bytes_left -= total_size;
+
+                    state->mesg_offset = 0;
+                    state->field_index = 0;
+                    state->field_offset = 0;
+                    state->decode_state = FIT_CONVERT_DECODE_RECORD;
+
+                    if (state->convert_table[state->mesg_index].num_fields > 0) {
+#if defined(FIT_CONVERT_TIME_RECORD)
+                        if (plan->timestamp_offset != FIT_UINT16_INVALID) {
+                            if (*((FIT_UINT32 *) &state->u.mesg[plan->timestamp_offset]) != FIT_DATE_TIME_INVALID) {
+                                memcpy(&state->timestamp, &state->u.mesg[plan->timestamp_offset], sizeof(state->timestamp));
+                                state->last_time_offset = (FIT_UINT8) (state->timestamp & FIT_HDR_TIME_OFFSET_MASK);
+                            }
+                        }
+#endif
+                        return FIT_CONVERT_MESSAGE_AVAILABLE;
+                    }
+
+                    if (state->dev_data_sizes[state->mesg_index] > 0)
+                        return FIT_CONVERT_MESSAGE_AVAILABLE;
+
+                    break;
+                }
+
                 if (state->mesg_index < FIT_LOCAL_MESGS) {
                     state->mesg_def = Fit_GetMesgDef(state->convert_table[state->mesg_index].global_mesg_num);
                     Fit_InitMesg(state->mesg_def, state->u.mesg);
@@ -241,7 +434,10 @@ FIT_CONVERT_RETURN FitConvert_ReadExt(const void *data, FIT_UINT32 size,
             state->field_num = FIT_FIELD_NUM_INVALID;
 
             if (state->mesg_index < FIT_LOCAL_MESGS) {
-                if (state->mesg_def != FIT_NULL) {
+                // A malformed definition could have more (duplicate) fields
+                // than the conversion table can hold.
+                if ((state->mesg_def != FIT_NULL) &&
+                    (state->convert_table[state->mesg_index].num_fields < FIT_CONVERT_MAX_FIELDS)) {
                     FIT_UINT8 local_field_index;
                     FIT_UINT16 local_field_offset = 0;
 
@@ -355,9 +551,6 @@ FIT_CONVERT_RETURN FitConvert_ReadExt(const void *data, FIT_UINT32 size,
                         if (state->field_offset >= state->convert_table[state->mesg_index].fields[state->field_index].size) {
                             if ((state->convert_table[state->mesg_index].fields[state->field_index].base_type & FIT_BASE_TYPE_ENDIAN_FLAG) &&
                                 ((state->convert_table[state->mesg_index].arch & FIT_ARCH_ENDIAN_MASK) != (Fit_GetArch() & FIT_ARCH_ENDIAN_MASK))) {
-                                FIT_UINT8 type_size;
-                                FIT_UINT8 element_size;
-                                FIT_UINT8 element;
                                 FIT_UINT8 index;
 
                                 index = state->convert_table[state->mesg_index].fields[state->field_index].base_type & FIT_BASE_TYPE_NUM_MASK;
@@ -365,49 +558,12 @@ FIT_CONVERT_RETURN FitConvert_ReadExt(const void *data, FIT_UINT32 size,
                                 if (index >= FIT_BASE_TYPES)
                                     return FIT_CONVERT_ERROR;
 
-                                type_size = fit_base_type_sizes[index];
-                                element_size = state->convert_table[state->mesg_index].fields[state->field_index].size/ type_size;
-
-                                for (element = 0; element < element_size; element++) {
-                                    for (index = 0; index < (type_size / 2); index++) {
-                                        FIT_UINT8 tmp = field[element * type_size + index];
-                                        field[element * type_size + index] = field[element * type_size + type_size - 1 - index];
-                                        field[element * type_size + type_size - 1 - index] = tmp;
-                                    }
-                                }
+                                FitConvert_SwapField(field, state->convert_table[state->mesg_index].fields[state->field_index].size, fit_base_type_sizes[index]);
                             }
 
                             // Null terminate last character if multi-byte beyond end of field.
-                            if (state->convert_table[state->mesg_index].fields[state->field_index].base_type == FIT_BASE_TYPE_STRING) {
-                                FIT_UINT8 length = state->convert_table[state->mesg_index].fields[state->field_index].size;
-                                FIT_UINT8 index = 0;
-
-                                while (index < length) {
-                                    FIT_UINT8 char_size;
-                                    FIT_UINT8 size_mask = 0x80;
-
-                                    if (field[index] & size_mask) {
-                                        char_size = 0;
-
-                                        while (field[index] & size_mask) // # of bytes in character = # of MSBits
-                                        {
-                                            char_size++;
-                                            size_mask >>= 1;
-                                        }
-                                    } else {
-                                        char_size = 1;
-                                    }
-
-                                    if ((FIT_UINT16) (index + char_size) > length) {
-                                        while (index < length) {
-                                            field[index++] = 0;
-                                        }
-                                        break;
-                                    }
-
-                                    index += char_size;
-                                }
-                            }
+                            if (state->convert_table[state->mesg_index].fields[state->field_index].base_type == FIT_BASE_TYPE_STRING)
+                                FitConvert_TerminateString(field, state->convert_table[state->mesg_index].fields[state->field_index].size);
 
                             state->field_offset = 0; // Reset the offset.
                             state->field_index++; // Move on to the next field.
@@ -449,6 +605,28 @@ FIT_CONVERT_RETURN FitConvert_ReadExt(const void *data, FIT_UINT32 size,
             }
             break;
 
+        case FIT_CONVERT_DECODE_SKIP_DATA:
+            {
+                // Skip as much of the rest of the message as we can in
+                // one go, without running into the file CRC.
+                FIT_UINT32 skip_size = state->skip_bytes_left - 1;
+
+                if (skip_size > (size - state->data_offset))
+                    skip_size = size - state->data_offset;
+
+                if ((state->file_bytes_left > 0) && (skip_size > (state->file_bytes_left - 2)))
+                    skip_size = state->file_bytes_left - 2;
+
+                state->data_offset += skip_size;
+                if (state->file_bytes_left > 0)
+                    state->file_bytes_left -= skip_size;
+
+                state->skip_bytes_left -= (skip_size + 1);
+                if (state->skip_bytes_left == 0)
+                    state->decode_state = FIT_CONVERT_DECODE_RECORD;
+            }
+            break;
+
         default:
             // This shouldn't happen.
             return FIT_CONVERT_ERROR;
@@ -469,19 +647,64 @@ void FitConvert_SetMessageDefinition(FIT_MESG_DEF *mesg_def)
 #endif
 
 ///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+FIT_BOOL FitConvert_SetMessageFilter(FIT_CONVERT_STATE *state, const FIT_MESG_NUM *mesg_nums, FIT_UINT8 num_mesg_nums)
+#else
+FIT_BOOL FitConvert_SetMessageFilter(const FIT_MESG_NUM *mesg_nums, FIT_UINT8 num_mesg_nums)
+#endif
+{
+    FIT_UINT8 mesg_index;
+
+    if (num_mesg_nums > FIT_CONVERT_MAX_MESG_FILTER)
+        return FIT_FALSE;
+
+    if (num_mesg_nums > 0)
+        memcpy(state->mesg_filter, mesg_nums, num_mesg_nums * sizeof(FIT_MESG_NUM));
+    state->num_mesg_filter = num_mesg_nums;
+
+    // Recompile the decode plans, which carry the filter decision
+    for (mesg_index = 0; mesg_index < FIT_LOCAL_MESGS; mesg_index++)
+        state->plans[mesg_index].status = FIT_CONVERT_PLAN_NONE;
+
+    return FIT_TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+FIT_UINT32 FitConvert_GetMessageIndex(FIT_CONVERT_STATE *state)
+#else
+FIT_UINT32 FitConvert_GetMessageIndex(void)
+#endif
+{
+    return state->mesg_count - 1;
+}
+
+///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+FIT_UINT16 FitConvert_GetMessageNumber(FIT_CONVERT_STATE *state)
+#else
 FIT_UINT16 FitConvert_GetMessageNumber(void)
+#endif
 {
     return state->convert_table[state->mesg_index].global_mesg_num;
 }
 
 ///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+const FIT_UINT8* FitConvert_GetMessageData(FIT_CONVERT_STATE *state)
+#else
 const FIT_UINT8* FitConvert_GetMessageData(void)
+#endif
 {
     return state->u.mesg;
 }
 
 ///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+void FitConvert_RestoreFields(FIT_CONVERT_STATE *state, const void *mesg)
+#else
 void FitConvert_RestoreFields(const void *mesg)
+#endif
 {
     FIT_UINT16 offset = 0;
     FIT_UINT8 field_index;
@@ -507,7 +730,11 @@ void FitConvert_RestoreFields(const void *mesg)
 }
 
 ///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+FIT_UINT8 FitConvert_GetFieldSize(FIT_CONVERT_STATE *state, FIT_UINT8 field_num)
+#else
 FIT_UINT8 FitConvert_GetFieldSize(FIT_UINT8 field_num)
+#endif
 {
     FIT_UINT8 field_index = 0;
 
@@ -521,3 +748,154 @@ FIT_UINT8 FitConvert_GetFieldSize(FIT_UINT8 field_num)
 
     return state->convert_table[state->mesg_index].fields[field_index].size;
 }
+
+//////////////////////////////////////////////////////////////////////////////////
+// Private Functions
+//////////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////
+// Byte-swap each type_size element of a field.
+///////////////////////////////////////////////////////////////////////
+static void FitConvert_SwapField(FIT_UINT8 *field, FIT_UINT8 size, FIT_UINT8 type_size)
+{
+    FIT_UINT8 element_size = size / type_size;
+    FIT_UINT8 element;
+    FIT_UINT8 index;
+
+    for (element = 0; element < element_size; element++) {
+        for (index = 0; index < (type_size / 2); index++) {
+            FIT_UINT8 tmp = field[element * type_size + index];
+            field[element * type_size + index] = field[element * type_size + type_size - 1 - index];
+            field[element * type_size + type_size - 1 - index] = tmp;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////
+// Null terminate last character if multi-byte beyond end of field.
+///////////////////////////////////////////////////////////////////////
+static void FitConvert_TerminateString(FIT_UINT8 *field, FIT_UINT8 length)
+{
+    FIT_UINT8 index = 0;
+
+    while (index < length) {
+        FIT_UINT8 char_size;
+        FIT_UINT8 size_mask = 0x80;
+
+        if (field[index] & size_mask) {
+            char_size = 0;
+
+            while (field[index] & size_mask) // # of bytes in character = # of MSBits
+            {
+                char_size++;
+                size_mask >>= 1;
+            }
+        } else {
+            char_size = 1;
+        }
+
+        if ((FIT_UINT16) (index + char_size) > length) {
+            while (index < length) {
+                field[index++] = 0;
+            }
+            break;
+        }
+
+        index += char_size;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////
+// Compile the conversion table of a local message into a decode
+// plan: the local message initialized to invalid values, plus a
+// flat list of field copies. Adjacent fields that need no byte
+// swapping are merged into a single copy. Anything the plan can't
+// reproduce exactly is left to the byte-wise decoder.
+///////////////////////////////////////////////////////////////////////
+static void FitConvert_CompilePlan(FIT_CONVERT_PLAN *plan, const FIT_MESG_CONVERT *convert)
+{
+    FIT_BOOL swap = ((convert->arch & FIT_ARCH_ENDIAN_MASK) != (Fit_GetArch() & FIT_ARCH_ENDIAN_MASK)) ? FIT_TRUE : FIT_FALSE;
+    FIT_UINT16 mesg_size = 0;
+    FIT_UINT8 field;
+
+    plan->status = FIT_CONVERT_PLAN_UNSUPPORTED;
+    plan->has_timestamp = FIT_FALSE;
+    plan->num_copies = 0;
+
+    if ((plan->mesg_def = Fit_GetMesgDef(convert->global_mesg_num)) == FIT_NULL)
+        return;
+
+    for (field = 0; field < plan->mesg_def->num_fields; field++)
+        mesg_size += plan->mesg_def->fields[FIT_MESG_DEF_FIELD_OFFSET(size, field)];
+
+    if (mesg_size > sizeof(plan->init_mesg))
+        return;
+
+    if (!Fit_InitMesg(plan->mesg_def, plan->init_mesg))
+        return;
+
+    plan->mesg_size = mesg_size;
+    plan->timestamp_offset = Fit_GetFieldOffset(plan->mesg_def, FIT_FIELD_NUM_TIMESTAMP);
+
+    for (field = 0; field < convert->num_fields; field++) {
+        const FIT_FIELD_CONVERT *field_convert = &convert->fields[field];
+        FIT_CONVERT_COPY *prev = (plan->num_copies > 0) ? &plan->copies[plan->num_copies - 1] : FIT_NULL;
+        FIT_UINT8 swap_size = 0;
+        FIT_BOOL is_string = (field_convert->base_type == FIT_BASE_TYPE_STRING) ? FIT_TRUE : FIT_FALSE;
+
+        if (field_convert->size == 0)
+            return;
+
+        if (field_convert->offset_local == plan->timestamp_offset)
+            plan->has_timestamp = FIT_TRUE;
+
+        if (swap && (field_convert->base_type & FIT_BASE_TYPE_ENDIAN_FLAG)) {
+            FIT_UINT8 index = field_convert->base_type & FIT_BASE_TYPE_NUM_MASK;
+
+            if (index >= FIT_BASE_TYPES)
+                return; // the byte-wise decoder flags this as an error
+
+            if (fit_base_type_sizes[index] > 1)
+                swap_size = fit_base_type_sizes[index];
+        }
+
+        if ((prev != FIT_NULL) && (prev->swap_size == 0) && !prev->is_string &&
+            (swap_size == 0) && !is_string &&
+            ((prev->offset_in + prev->size) == field_convert->offset_in) &&
+            ((prev->offset_local + prev->size) == field_convert->offset_local) &&
+            ((prev->size + field_convert->size) <= 0xFF)) {
+            prev->size += field_convert->size;
+        } else {
+            FIT_CONVERT_COPY *copy = &plan->copies[plan->num_copies++];
+
+            copy->offset_in = field_convert->offset_in;
+            copy->offset_local = field_convert->offset_local;
+            copy->size = field_convert->size;
+            copy->swap_size = swap_size;
+            copy->is_string = is_string;
+        }
+    }
+
+    plan->status = FIT_CONVERT_PLAN_READY;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Decode the fields of a data message using its decode plan.
+///////////////////////////////////////////////////////////////////////
+static void FitConvert_RunPlan(const FIT_CONVERT_PLAN *plan, const FIT_UINT8 *data, FIT_UINT8 *mesg)
+{
+    FIT_UINT8 index;
+
+    for (index = 0; index < plan->num_copies; index++) {
+        const FIT_CONVERT_COPY *copy = &plan->copies[index];
+        FIT_UINT8 *field = &mesg[copy->offset_local];
+
+        memcpy(field, &data[copy->offset_in], copy->size);
+
+        if (copy->swap_size != 0)
+            FitConvert_SwapField(field, copy->size, copy->swap_size);
+
+        if (copy->is_string)
+            FitConvert_TerminateString(field, copy->size);
+    }
+}
@@ -54,9 +54,51 @@ typedef enum
     FIT_CONVERT_DECODE_DEV_FIELD_SIZE,
     FIT_CONVERT_DECODE_DEV_FIELD_INDEX,
     FIT_CONVERT_DECODE_FIELD_DATA,
-    FIT_CONVERT_DECODE_DEV_FIELD_DATA
+    FIT_CONVERT_DECODE_DEV_FIELD_DATA,
+    FIT_CONVERT_DECODE_SKIP_DATA
 } FIT_CONVERT_DECODE_STATE;
 
+// Maximum number of global message numbers in a message filter
+#define FIT_CONVERT_MAX_MESG_FILTER 32
+
+// Maximum number of fields in a message conversion table
+#define FIT_CONVERT_MAX_FIELDS  (sizeof(((FIT_MESG_CONVERT *) 0)->fields) / sizeof(FIT_FIELD_CONVERT))
+
+// One step of a decode plan: copy size bytes of an incoming data
+// message to the local message, byte-swapping each swap_size-byte
+// element (if non-zero) and null-terminating strings.
+typedef struct
+{
+    FIT_UINT16 offset_in;
+    FIT_UINT16 offset_local;
+    FIT_UINT8 size;
+    FIT_UINT8 swap_size;
+    FIT_BOOL is_string;
+} FIT_CONVERT_COPY;
+
+// Decode plan compiled from a definition message, used to decode
+// the data messages of that local message type in one go rather
+// than one byte at a time.
+typedef enum
+{
+    FIT_CONVERT_PLAN_NONE,          // not compiled yet
+    FIT_CONVERT_PLAN_READY,         // use the decode plan
+    FIT_CONVERT_PLAN_UNSUPPORTED    // use the byte-wise decoder
+} FIT_CONVERT_PLAN_STATUS;
+
+typedef struct
+{
+    FIT_CONVERT_PLAN_STATUS status;
+    FIT_BOOL skip;                  // message is filtered out
+    FIT_BOOL has_timestamp;         // message carries a timestamp field
+    const FIT_MESG_DEF *mesg_def;
+    FIT_UINT16 mesg_size;           // size of the local message
+    FIT_UINT16 timestamp_offset;    // offset of the timestamp in the local message
+    FIT_UINT8 num_copies;
+    FIT_CONVERT_COPY copies[FIT_CONVERT_MAX_FIELDS];
+    FIT_UINT8 init_mesg[FIT_MESG_SIZE]; // local message with all fields set to invalid
+} FIT_CONVERT_PLAN;
+
 typedef struct
 {
     FIT_UINT32 file_bytes_left;
@@ -70,6 +112,7 @@ typedef struct
         FIT_UINT8 mesg[FIT_MESG_SIZE];
     } u;
     FIT_MESG_CONVERT convert_table[FIT_LOCAL_MESGS];
+    FIT_CONVERT_PLAN plans[FIT_LOCAL_MESGS];
     const FIT_MESG_DEF *mesg_def;
 #if defined(FIT_CONVERT_CHECK_CRC)
     FIT_UINT16 crc;
@@ -87,6 +130,10 @@ typedef struct
 #if defined(FIT_CONVERT_TIME_RECORD)
     FIT_UINT8 last_time_offset;
 #endif
+    FIT_UINT32 skip_bytes_left;
+    FIT_UINT32 mesg_count;
+    FIT_UINT8 num_mesg_filter;
+    FIT_MESG_NUM mesg_filter[FIT_CONVERT_MAX_MESG_FILTER];
 } FIT_CONVERT_STATE;
 
 
@@ -101,7 +148,11 @@ extern "C" {
 ///////////////////////////////////////////////////////////////////////
 // Initialize the state of the converter to start parsing the file.
 ///////////////////////////////////////////////////////////////////////
-void FitConvert_Init(FIT_BOOL read_file_header);
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   void FitConvert_Init(FIT_CONVERT_STATE *state, FIT_BOOL read_file_header);
+#else
+   void FitConvert_Init(FIT_BOOL read_file_header);
+#endif
 
 ///////////////////////////////////////////////////////////////////////
 // Convert a stream of bytes.
@@ -119,7 +170,11 @@ void FitConvert_Init(FIT_BOOL read_file_header);
 // Returns FIT_CONVERT_ERROR if a decoding error occurs.
 // Returns FIT_CONVERT_END_OF_FILE when the file has been decoded successfully.
 ///////////////////////////////////////////////////////////////////////
-FIT_CONVERT_RETURN FitConvert_Read(const void *data, FIT_UINT32 size);
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   FIT_CONVERT_RETURN FitConvert_Read(FIT_CONVERT_STATE *state, const void *data, FIT_UINT32 size);
+#else
+   FIT_CONVERT_RETURN FitConvert_Read(const void *data, FIT_UINT32 size);
+#endif
 
 ///////////////////////////////////////////////////////////////////////
 // Convert a stream of bytes.
@@ -141,7 +196,11 @@ FIT_CONVERT_RETURN FitConvert_Read(const void *data, FIT_UINT32 size);
 // Returns FIT_CONVERT_ERROR if a decoding error occurs.
 // Returns FIT_CONVERT_END_OF_FILE when the file has been decoded successfully.
 ///////////////////////////////////////////////////////////////////////
-FIT_CONVERT_RETURN FitConvert_ReadExt(const void *data, FIT_UINT32 size, FIT_BOOL return_message_numbers);
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   FIT_CONVERT_RETURN FitConvert_ReadExt(FIT_CONVERT_STATE *state, const void *data, FIT_UINT32 size, FIT_BOOL return_message_numbers);
+#else
+   FIT_CONVERT_RETURN FitConvert_ReadExt(const void *data, FIT_UINT32 size, FIT_BOOL return_message_numbers);
+#endif
 
 ///////////////////////////////////////////////////////////////////////
 // Overrides the message definition to be used when
@@ -149,30 +208,71 @@ FIT_CONVERT_RETURN FitConvert_ReadExt(const void *data, FIT_UINT32 size, FIT_BOO
 // In a multithreaded environment, you can set the state directly
 // in FitConvert_ReadExt().
 ///////////////////////////////////////////////////////////////////////
-void FitConvert_SetMessageDefinition(FIT_MESG_DEF *mesg_def);
+#if !defined(FIT_CONVERT_MULTI_THREAD)
+   void FitConvert_SetMessageDefinition(FIT_MESG_DEF *mesg_def);
+#endif
+
+///////////////////////////////////////////////////////////////////////
+// Restricts the messages returned by the converter to the given
+// global message numbers. The payload of any other data message is
+// skipped without being decoded. Passing no message numbers returns
+// all messages, which is also the default after FitConvert_Init().
+// Returns FIT_FALSE if there are too many message numbers.
+///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   FIT_BOOL FitConvert_SetMessageFilter(FIT_CONVERT_STATE *state, const FIT_MESG_NUM *mesg_nums, FIT_UINT8 num_mesg_nums);
+#else
+   FIT_BOOL FitConvert_SetMessageFilter(const FIT_MESG_NUM *mesg_nums, FIT_UINT8 num_mesg_nums);
+#endif
+
+///////////////////////////////////////////////////////////////////////
+// Returns the index of the decoded message among all the data
+// messages in the file, including the ones skipped by the filter.
+///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   FIT_UINT32 FitConvert_GetMessageIndex(FIT_CONVERT_STATE *state);
+#else
+   FIT_UINT32 FitConvert_GetMessageIndex(void);
+#endif
 
 ///////////////////////////////////////////////////////////////////////
 // Returns the global message number of the decoded message.
 ///////////////////////////////////////////////////////////////////////
-FIT_MESG_NUM FitConvert_GetMessageNumber(void);
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   FIT_MESG_NUM FitConvert_GetMessageNumber(FIT_CONVERT_STATE *state);
+#else
+   FIT_MESG_NUM FitConvert_GetMessageNumber(void);
+#endif
 
 ///////////////////////////////////////////////////////////////////////
 // Returns a pointer to the data of the decoded message.
 // Copy or cast to FIT_*_MESG structure.
 ///////////////////////////////////////////////////////////////////////
-const FIT_UINT8 *FitConvert_GetMessageData(void);
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   const FIT_UINT8 *FitConvert_GetMessageData(FIT_CONVERT_STATE *state);
+#else
+   const FIT_UINT8 *FitConvert_GetMessageData(void);
+#endif
 
 ///////////////////////////////////////////////////////////////////////
 // Restores fields that are not in decoded message from mesg_data.
 // Use when modifying an existing file.
 ///////////////////////////////////////////////////////////////////////
-void FitConvert_RestoreFields(const void *mesg_data);
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   void FitConvert_RestoreFields(FIT_CONVERT_STATE *state, const void *mesg_data);
+#else
+   void FitConvert_RestoreFields(const void *mesg_data);
+#endif
 
 ///////////////////////////////////////////////////////////////////////
 // Restores fields that are not in decoded message from mesg_data.
 // Use when modifying an existing file.
 ///////////////////////////////////////////////////////////////////////
-FIT_UINT8 FitConvert_GetFieldSize(FIT_UINT8 field);
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   FIT_UINT8 FitConvert_GetFieldSize(FIT_CONVERT_STATE *state, FIT_UINT8 field);
+#else
+   FIT_UINT8 FitConvert_GetFieldSize(FIT_UINT8 field);
+#endif
 
 #if defined(__cplusplus)
 }
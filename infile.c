@@ -0,0 +1,229 @@
+/*=========================================================================
+ *
+ *   Filename:           infile.c
+ *
+ *   Author:             Marcelo Mourier
+ *   Created:            Mon Apr 11 11:24:16 MDT 2022
+ *
+ *   Description:        Input file reader
+ *
+ *=========================================================================
+ *
+ *                  Copyright (c) 2022 Marcelo Mourier
+ *
+ *=========================================================================
+*/
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifndef _MSC_FULL_VER
+#include <sys/mman.h>
+#include <unistd.h>
+#endif  // _MSC_FULL_VER
+
+#include "infile.h"
+
+// Size of the blocks used to read binary (e.g. FIT) files
+// through the stdio reader.
+#define BLOCK_BUF_SIZE  (256 * 1024)
+
+// Largest block handed out from a mapped file
+#define MAX_BLOCK_SIZE  (1024 * 1024 * 1024)
+
+#ifndef _MSC_FULL_VER
+// Map the contents of the file into memory. We first reserve
+// an anonymous (zero-filled) region that is at least one byte
+// larger than the file, and then map the file on top of it.
+// That way the file contents are always followed by a null
+// byte, which keeps the number and timestamp parsers (see
+// numparse.c and isotime.c) from running off the end of the
+// mapping.
+static int mapInFile(InFile *pInFile, int fd, size_t size)
+{
+    size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    size_t mapLen = ((size / pageSize) + 1) * pageSize;
+    char *map;
+
+    if ((map = mmap(NULL, mapLen, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+        return -1;
+    }
+
+    if (mmap(map, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(map, mapLen);
+        return -1;
+    }
+
+    // We scan the file from start to end just once
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    pInFile->map = map;
+    pInFile->mapLen = mapLen;
+    pInFile->size = size;
+
+    return 0;
+}
+#endif  // _MSC_FULL_VER
+
+InFile *openInFile(const char *inFile)
+{
+    InFile *pInFile;
+
+    if ((pInFile = calloc(1, sizeof (InFile))) == NULL) {
+        fprintf(stderr, "Failed to alloc InFile object !!!\n");
+        return NULL;
+    }
+
+    pInFile->name = inFile;
+
+#ifndef _MSC_FULL_VER
+    {
+        struct stat statBuf;
+        int fd;
+
+        if ((fd = open(inFile, O_RDONLY)) < 0) {
+            free(pInFile);
+            return NULL;
+        }
+
+        // Only non-empty regular files can be mapped into
+        // memory; e.g. a named pipe can't...
+        if ((fstat(fd, &statBuf) == 0) && S_ISREG(statBuf.st_mode) && (statBuf.st_size > 0) &&
+            (mapInFile(pInFile, fd, (size_t) statBuf.st_size) == 0)) {
+            close(fd);
+            return pInFile;
+        }
+
+        // Fall back to the stdio reader, on the descriptor
+        // we already have open, so the file (e.g. a named
+        // pipe) is only opened once.
+        if ((pInFile->fp = fdopen(fd, "r")) == NULL) {
+            close(fd);
+            free(pInFile);
+            return NULL;
+        }
+    }
+#else
+    if ((pInFile->fp = fopen(inFile, "r")) == NULL) {
+        free(pInFile);
+        return NULL;
+    }
+#endif  // _MSC_FULL_VER
+
+    return pInFile;
+}
+
+void closeInFile(InFile *pInFile)
+{
+#ifndef _MSC_FULL_VER
+    if (pInFile->map != NULL) {
+        munmap(pInFile->map, pInFile->mapLen);
+    }
+#endif  // _MSC_FULL_VER
+
+    if (pInFile->fp != NULL) {
+        fclose(pInFile->fp);
+    }
+
+    free(pInFile->blockBuf);
+    free(pInFile);
+}
+
+// Find the first occurrence of the given string in the given
+// buffer, neither of which needs to be null-terminated. Same
+// as memmem(), which isn't available on all platforms.
+const char *findBytes(const char *buf, size_t len, const char *str, size_t strLen)
+{
+    const char *end = buf + len;
+    const char *p = buf;
+
+    if (strLen == 0)
+        return buf;
+
+    while (((size_t) (end - p) >= strLen) &&
+           ((p = memchr(p, str[0], ((end - p) - strLen + 1))) != NULL)) {
+        if (memcmp(p, str, strLen) == 0)
+            return p;
+        p++;
+    }
+
+    return NULL;
+}
+
+// Get the next line from the input file, skipping any blank
+// and XML comment lines. Returns the line number, or -1 at
+// the end of the file.
+int getLineView(InFile *pInFile, LineView *pLine)
+{
+    while (true) {
+        if (pInFile->map != NULL) {
+            const char *p = pInFile->map + pInFile->offset;
+            size_t n = pInFile->size - pInFile->offset;
+            const char *eol;
+
+            if (n == 0)
+                return -1;
+
+            if ((eol = memchr(p, '\n', n)) != NULL) {
+                n = (eol - p);
+                pInFile->offset += (n + 1);
+            } else {
+                pInFile->offset += n;   // last line has no EOL
+            }
+
+            pLine->ptr = p;
+            pLine->len = n;
+        } else {
+            char *lineBuf = pInFile->lineBuf;
+            size_t n;
+
+            if (fgets(lineBuf, sizeof (pInFile->lineBuf), pInFile->fp) == NULL)
+                return -1;
+
+            if (((n = strlen(lineBuf)) != 0) && (lineBuf[n-1] == '\n'))
+                lineBuf[--n] = '\0';
+
+            pLine->ptr = lineBuf;
+            pLine->len = n;
+        }
+
+        pInFile->lineNum++;
+
+        // Skip blank and XML comment lines
+        if ((pLine->len != 0) && (findBytes(pLine->ptr, pLine->len, "<!--", 4) == NULL))
+            break;
+    }
+
+    return pInFile->lineNum;
+}
+
+// Get the next block of raw data from the input file. When
+// the file is mapped into memory the block is (usually) the
+// whole file. Returns the number of bytes in the block, or 0
+// at the end of the file.
+size_t getBlock(InFile *pInFile, const void **pData)
+{
+    size_t n;
+
+    if (pInFile->map != NULL) {
+        if ((n = pInFile->size - pInFile->offset) > MAX_BLOCK_SIZE)
+            n = MAX_BLOCK_SIZE;
+        *pData = pInFile->map + pInFile->offset;
+        pInFile->offset += n;
+        return n;
+    }
+
+    if ((pInFile->blockBuf == NULL) &&
+        ((pInFile->blockBuf = malloc(BLOCK_BUF_SIZE)) == NULL)) {
+        fprintf(stderr, "Failed to alloc block buffer !!!\n");
+        return 0;
+    }
+
+    n = fread(pInFile->blockBuf, 1, BLOCK_BUF_SIZE, pInFile->fp);
+    *pData = pInFile->blockBuf;
+
+    return n;
+}
+
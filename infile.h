@@ -0,0 +1,60 @@
+/*=========================================================================
+ *
+ *   Filename:           infile.h
+ *
+ *   Author:             Marcelo Mourier
+ *   Created:            Mon Apr 11 11:24:16 MDT 2022
+ *
+ *   Description:        Input file reader
+ *
+ *=========================================================================
+ *
+ *                  Copyright (c) 2022 Marcelo Mourier
+ *
+ *=========================================================================
+*/
+
+#ifndef INFILE_H_
+#define INFILE_H_
+
+#include <stddef.h>
+
+#include "defs.h"
+
+// Input file reader. Regular files are mapped into memory
+// and scanned in place, while pipes and any other files that
+// can't be mapped fall back to the stdio line reader.
+typedef struct InFile {
+    const char *name;   // input file name
+    FILE *fp;           // stdio stream (fallback path)
+    char *map;          // file contents mapped into memory
+    size_t mapLen;      // length of the mapping
+    size_t size;        // size of the file contents
+    size_t offset;      // current read offset into the mapping
+    int lineNum;        // current line number
+    char lineBuf[1024]; // line buffer (fallback path)
+    char *blockBuf;     // block buffer (fallback path)
+} InFile;
+
+// A line of text in the input file. Notice that the text is
+// NOT null-terminated, and that it doesn't include the EOL.
+typedef struct LineView {
+    const char *ptr;    // start of the line
+    size_t len;         // length of the line
+} LineView;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern InFile *openInFile(const char *inFile);
+extern void closeInFile(InFile *pInFile);
+extern int getLineView(InFile *pInFile, LineView *pLine);
+extern size_t getBlock(InFile *pInFile, const void **pData);
+extern const char *findBytes(const char *buf, size_t len, const char *str, size_t strLen);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* INFILE_H_ */
@@ -14,13 +14,21 @@
  *=========================================================================
 */
 
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
+#ifndef _MSC_FULL_VER
+#include <pthread.h>
+#endif  // _MSC_FULL_VER
+
 #include "const.h"
 #include "defs.h"
+#include "infile.h"
+#include "isotime.h"
+#include "numparse.h"
 #include "trkpt.h"
 
 // FIT SDK files
@@ -48,15 +56,273 @@ static int getLine(FILE *fp, char *lineBuf, size_t bufLen, int lineNum)
     return lineNum;
 }
 
-static void spongExit(const char *msg, const char *inFile, int lineNum, const char *lineBuf)
+static void spongExit(const char *msg, const char *inFile, int lineNum, const LineView *pLine)
 {
-    fprintf(stderr, "SPONG! %s %s:%u \"%s\"\n", msg, inFile, lineNum, lineBuf);
+    fprintf(stderr, "SPONG! %s %s:%u \"%.*s\"\n", msg, inFile, lineNum, (int) pLine->len, pLine->ptr);
     exit(-1);
 }
 
-static void noActTrkPt(const char *inFile, int lineNum, const char *lineBuf)
+static void noActTrkPt(const char *inFile, int lineNum, const LineView *pLine)
+{
+    spongExit("No active TrkPt !!!", inFile, lineNum, pLine);
+}
+
+// Check whether the line contains the given string
+static Bool findStr(const LineView *pLine, const char *str)
+{
+    return (findBytes(pLine->ptr, pLine->len, str, strlen(str)) != NULL) ? true : false;
+}
+
+// If the text at *pp matches the given string, advance *pp
+// past it and return true.
+static Bool matchStr(const char **pp, const char *end, const char *str)
 {
-    spongExit("No active TrkPt !!!", inFile, lineNum, lineBuf);
+    size_t len = strlen(str);
+
+    if (((size_t) (end - *pp) < len) || (memcmp(*pp, str, len) != 0))
+        return false;
+
+    *pp += len;
+
+    return true;
+}
+
+// Parse a floating-point value at *pp, without going past
+// the end of the line.
+static Bool scanDouble(const char **pp, const char *end, double *pVal)
+{
+    const char *endPtr;
+
+    if ((endPtr = parseDouble(*pp, end, pVal)) == NULL)
+        return false;
+
+    *pp = endPtr;
+
+    return true;
+}
+
+// Parse an integer value at *pp, without going past the
+// end of the line.
+static Bool scanLong(const char **pp, const char *end, long *pVal)
+{
+    char *endPtr;
+    long val = strtol(*pp, &endPtr, 10);
+
+    if ((endPtr == *pp) || (endPtr > end))
+        return false;
+
+    *pp = endPtr;
+    *pVal = val;
+
+    return true;
+}
+
+// Parse an integer value at *pp, without going past the
+// end of the line.
+static Bool scanInt(const char **pp, const char *end, int *pVal)
+{
+    long val;
+
+    if (!scanLong(pp, end, &val))
+        return false;
+
+    *pVal = (int) val;
+
+    return true;
+}
+
+// Parse a CSV column separator at *pp
+static Bool scanComma(const char **pp, const char *end)
+{
+    return matchStr(pp, end, ",");
+}
+
+// Parse a "YYYY-MM-DDTHH:MM:SS[.fff]" UTC timestamp at *pp,
+// without going past the end of the line.
+static Bool scanTime(const char **pp, const char *end, IsoTimeCache *pCache, double *pTimestamp)
+{
+    const char *endPtr;
+
+    if ((endPtr = parseIsoTime(*pp, end, pCache, pTimestamp)) == NULL)
+        return false;
+
+    *pp = endPtr;
+
+    return true;
+}
+
+// XML elements we care about in the GPX/TCX files
+typedef enum XmlTag {
+    tagEol = -1,            // end of line
+    tagUnknown = 0,         // any other element
+    tagActivity,
+    tagAltitudeMeters,
+    tagAtemp,
+    tagCadence,
+    tagDistanceMeters,
+    tagEle,
+    tagGradePercent,
+    tagHeartRate,
+    tagHeartRateBpm,
+    tagHeartRateBpmEnd,
+    tagLatitudeDegrees,
+    tagLongitudeDegrees,
+    tagMetadata,
+    tagMetadataEnd,
+    tagPower,
+    tagSpeed,
+    tagTime,
+    tagTrack,
+    tagTrackEnd,
+    tagTrackpoint,
+    tagTrackpointEnd,
+    tagTrkpt,
+    tagTrkptEnd,
+    tagType,
+    tagValue,
+} XmlTag;
+
+typedef struct XmlTagDef {
+    const char *name;       // element name (an end tag starts with '/')
+    XmlTag tag;
+} XmlTagDef;
+
+typedef struct XmlTagTbl {
+    const XmlTagDef *defs;
+    size_t numDefs;
+} XmlTagTbl;
+
+// NOTE: the entries in these tables must be sorted by name,
+// in strcmp() order, as they are searched using bsearch() !!!
+static const XmlTagDef gpxTagDefs[] = {
+    { "/metadata",          tagMetadataEnd },
+    { "/trkpt",             tagTrkptEnd },
+    { "ele",                tagEle },
+    { "gpxdata:atemp",      tagAtemp },
+    { "gpxdata:cadence",    tagCadence },
+    { "gpxdata:hr",         tagHeartRate },
+    { "gpxtpx:atemp",       tagAtemp },
+    { "gpxtpx:cad",         tagCadence },
+    { "gpxtpx:hr",          tagHeartRate },
+    { "metadata",           tagMetadata },
+    { "ns3:atemp",          tagAtemp },
+    { "ns3:cad",            tagCadence },
+    { "ns3:hr",             tagHeartRate },
+    { "power",              tagPower },
+    { "time",               tagTime },
+    { "trkpt",              tagTrkpt },
+    { "type",               tagType },
+};
+
+static const XmlTagDef tcxTagDefs[] = {
+    { "/HeartRateBpm",      tagHeartRateBpmEnd },
+    { "/Track",             tagTrackEnd },
+    { "/Trackpoint",        tagTrackpointEnd },
+    { "Activity",           tagActivity },
+    { "AltitudeMeters",     tagAltitudeMeters },
+    { "Cadence",            tagCadence },
+    { "DistanceMeters",     tagDistanceMeters },
+    { "GradePercent",       tagGradePercent },
+    { "HeartRateBpm",       tagHeartRateBpm },
+    { "LatitudeDegrees",    tagLatitudeDegrees },
+    { "LongitudeDegrees",   tagLongitudeDegrees },
+    { "Speed",              tagSpeed },
+    { "Time",               tagTime },
+    { "Track",              tagTrack },
+    { "Trackpoint",         tagTrackpoint },
+    { "Value",              tagValue },
+    { "Watts",              tagPower },
+    { "ns3:Speed",          tagSpeed },
+    { "ns3:Watts",          tagPower },
+};
+
+static const XmlTagTbl gpxTagTbl = { gpxTagDefs, sizeof (gpxTagDefs) / sizeof (gpxTagDefs[0]) };
+static const XmlTagTbl tcxTagTbl = { tcxTagDefs, sizeof (tcxTagDefs) / sizeof (tcxTagDefs[0]) };
+
+static int cmpXmlTag(const void *key, const void *elem)
+{
+    const LineView *pName = key;
+    const XmlTagDef *pDef = elem;
+    int n;
+
+    if ((n = strncmp(pName->ptr, pDef->name, pName->len)) == 0) {
+        // Name is equal to, or a prefix of, the table entry
+        n = (pDef->name[pName->len] == '\0') ? 0 : -1;
+    }
+
+    return n;
+}
+
+// Find the next XML element in the line, starting at *pp,
+// and look up its name in the given table. On return *pp
+// points right after the element's name; i.e. at its
+// attributes (if any) or at the closing '>' of its tag.
+static XmlTag nextXmlTag(const XmlTagTbl *pTbl, const char **pp, const char *end)
+{
+    const char *p = *pp;
+    const XmlTagDef *pDef;
+    LineView name;
+
+    if ((p = memchr(p, '<', (end - p))) == NULL) {
+        *pp = end;
+        return tagEol;
+    }
+
+    // The name ends at the first white space, '>', or
+    // the '/' of an empty-element tag.
+    name.ptr = ++p;
+    while ((p < end) && (*p != '>') && !isspace((unsigned char) *p) &&
+           ((*p != '/') || (p == name.ptr))) {
+        p++;
+    }
+    name.len = (p - name.ptr);
+
+    *pp = p;
+
+    if ((name.len == 0) ||
+        ((pDef = bsearch(&name, pTbl->defs, pTbl->numDefs, sizeof (XmlTagDef), cmpXmlTag)) == NULL)) {
+        return tagUnknown;
+    }
+
+    return pDef->tag;
+}
+
+// Get the end of the start tag of the element; i.e. the
+// position of its closing '>'.
+static const char *xmlTagEnd(const char *p, const char *end)
+{
+    const char *gt = memchr(p, '>', (end - p));
+
+    return (gt != NULL) ? gt : end;
+}
+
+// Get the text content of the element; i.e. the text right
+// after the closing '>' of its start tag.
+static const char *xmlText(const char *p, const char *end)
+{
+    const char *gt = xmlTagEnd(p, end);
+
+    return (gt < end) ? (gt + 1) : end;
+}
+
+// Get the value of the given attribute of the element. The
+// search is limited to the element's start tag.
+static const char *xmlAttr(const char *p, const char *end, const char *attr)
+{
+    size_t len = strlen(attr);
+    const char *q;
+
+    end = xmlTagEnd(p, end);
+
+    while ((q = findBytes(p, (end - p), attr, len)) != NULL) {
+        p = q + len;
+        if (isspace((unsigned char) q[-1]) &&
+            ((end - p) >= 2) && (p[0] == '=') && (p[1] == '"')) {
+            return (p + 2);
+        }
+    }
+
+    return NULL;
 }
 
 static const char *garminEpoch = "1989-12-31T00:00:00Z";
@@ -66,7 +332,7 @@ int parseCsvFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile)
 {
     FILE *fp;
     int lineNum = 0;
-    static char lineBuf[1024];
+    char lineBuf[1024];     // private to each call, as files may be parsed in parallel
     size_t bufLen = sizeof (lineBuf);
 
     // Open the CSV file for reading
@@ -91,33 +357,41 @@ int parseCsvFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile)
 
     // Process one line at a time...
     while ((lineNum = getLine(fp, lineBuf, bufLen, lineNum)) != -1) {
+        TrkPt trkPt;
         TrkPt *pTrkPt = NULL;
         const char *p = lineBuf;
-        time_t timestamp;
+        const char *end;
+        long timestamp;
         double distance, speed, dummy;
 
-        // Alloc and init new TrkPt object
-        if ((pTrkPt = newTrkPt(pTrk->numTrkPts++, inFile, lineNum)) == NULL) {
-            fprintf(stderr, "Failed to create TrkPt object !!!\n");
-            return -1;
-        }
+        // Init new TrkPt object
+        pTrkPt = newTrkPt(pTrk, &trkPt, inFile, lineNum);
 
         // Skip the first 3 columns: "<trkpt>,<inFile>,<line#>,"
         for (int n = 0; n < 3; n++, p++) {
             if ((p = strchr(p, ',')) == NULL) {
-                fprintf(stderr, "Failed to parse line: %s !!!\n", p);
+                fprintf(stderr, "Failed to parse line: %s !!!\n", lineBuf);
                 return -1;
             }
         }
 
         // Parse the columns: "<time>,<latitude>,<longitude>,<elevation>,<distance>,<speed>,<power>,<ambTemp>,<cadence>,<heartRate>,<run>,<rise>,<dist>,<grade>"
-        if (sscanf(p, "%ld,%le,%le,%le,%le,%le,%d,%d,%d,%d,%le,%le,%le,%le",
-                   &timestamp, &pTrkPt->latitude, &pTrkPt->longitude, &pTrkPt->elevation,
-                   &distance, &speed,
-                   &pTrkPt->power, &pTrkPt->ambTemp, &pTrkPt->cadence, &pTrkPt->heartRate,
-                   &dummy, &dummy, &dummy,
-                   &pTrkPt->grade) != 14) {
-            fprintf(stderr, "Failed to parse line: %s !!!\n", p);
+        end = p + strlen(p);
+        if (!scanLong(&p, end, &timestamp) || !scanComma(&p, end) ||
+            !scanDouble(&p, end, &pTrkPt->latitude) || !scanComma(&p, end) ||
+            !scanDouble(&p, end, &pTrkPt->longitude) || !scanComma(&p, end) ||
+            !scanDouble(&p, end, &pTrkPt->elevation) || !scanComma(&p, end) ||
+            !scanDouble(&p, end, &distance) || !scanComma(&p, end) ||
+            !scanDouble(&p, end, &speed) || !scanComma(&p, end) ||
+            !scanInt(&p, end, &pTrkPt->power) || !scanComma(&p, end) ||
+            !scanInt(&p, end, &pTrkPt->ambTemp) || !scanComma(&p, end) ||
+            !scanInt(&p, end, &pTrkPt->cadence) || !scanComma(&p, end) ||
+            !scanInt(&p, end, &pTrkPt->heartRate) || !scanComma(&p, end) ||
+            !scanDouble(&p, end, &dummy) || !scanComma(&p, end) ||
+            !scanDouble(&p, end, &dummy) || !scanComma(&p, end) ||
+            !scanDouble(&p, end, &dummy) || !scanComma(&p, end) ||
+            !scanDouble(&p, end, &pTrkPt->grade)) {
+            fprintf(stderr, "Failed to parse line: %s !!!\n", lineBuf);
             return -1;
         }
 
@@ -129,8 +403,10 @@ int parseCsvFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile)
         //       pTrkPt->index, pTrkPt->timestamp, pTrkPt->latitude, pTrkPt->longitude,
         //       pTrkPt->elevation, pTrkPt->distance, pTrkPt->speed);
 
-        // Insert track point at the tail of the queue
-        TAILQ_INSERT_TAIL(&pTrk->trkPtList, pTrkPt, tqEntry);
+        // Insert track point at the tail of the track
+        if (addTrkPt(pTrk, pTrkPt) != 0) {
+            return -1;
+        }
 
         pTrkPt = NULL;
     }
@@ -146,43 +422,55 @@ int parseCsvFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile)
     return 0;
 }
 
+// FIT messages handled by parseFitFile(); the decoder skips
+// all the others.
+static const FIT_MESG_NUM fitMesgFilter[] = {
+    FIT_MESG_NUM_FILE_ID,
+    FIT_MESG_NUM_SPORT,
+    FIT_MESG_NUM_RECORD,
+    FIT_MESG_NUM_EVENT,
+};
+
 // Parse the FIT file and create a list of Track Points (TrkPt's)
 int parseFitFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile)
 {
-    FILE *fp;
+    InFile *pInFile;
+    TrkPt trkPt;
     TrkPt *pTrkPt = NULL;
-    FIT_UINT8 inBuf[8];
+    FIT_CONVERT_STATE convState = {0};  // per-file decoder state
+    const void *inBuf;
     FIT_CONVERT_RETURN conRet = FIT_CONVERT_CONTINUE;
     FIT_UINT32 bufSize;
-    FIT_UINT32 mesgIndex = 0;
     FIT_MANUFACTURER manufacturer = FIT_MANUFACTURER_INVALID;
-    struct tm brkDwnTime = {0};
-    time_t timeStampOffset;
+    double timeStampOffset;
     Bool timerRunning = true;
 
     // Compute the UTC of the Garmin Epoch
-    strptime(garminEpoch, "%Y-%m-%dT%H:%M:%S", &brkDwnTime);
-    timeStampOffset = mktime(&brkDwnTime);
+    parseIsoTime(garminEpoch, garminEpoch + strlen(garminEpoch), NULL, &timeStampOffset);
 
     // Open the FIT file for reading
-    if ((fp = fopen(inFile, "r")) == NULL) {
+    if ((pInFile = openInFile(inFile)) == NULL) {
         fprintf(stderr, "Failed to open input file %s\n", inFile);
         return -1;
     }
 
-    FitConvert_Init(FIT_TRUE);
+    FitConvert_Init(&convState, FIT_TRUE);
 
-    while (!feof(fp) && (conRet == FIT_CONVERT_CONTINUE)) {
-        for (bufSize = 0; (bufSize < sizeof (inBuf)) && !feof(fp); bufSize++) {
-            inBuf[bufSize] = (FIT_UINT8) getc(fp);
-        }
+    // Only these messages are of any use to us; the decoder
+    // skips over all the others without decoding them.
+    FitConvert_SetMessageFilter(&convState, fitMesgFilter, sizeof (fitMesgFilter) / sizeof (fitMesgFilter[0]));
 
+    // Feed the decoder whole blocks of the file; it returns each
+    // time it completes a message, and resumes where it left off
+    // in the block on the next call.
+    while ((conRet == FIT_CONVERT_CONTINUE) &&
+           ((bufSize = (FIT_UINT32) getBlock(pInFile, &inBuf)) != 0)) {
         do {
-            if ((conRet = FitConvert_Read(inBuf, bufSize)) == FIT_CONVERT_MESSAGE_AVAILABLE) {
-                const FIT_UINT8 *mesg = FitConvert_GetMessageData();
-                FIT_UINT16 mesgNum = FitConvert_GetMessageNumber();
+            if ((conRet = FitConvert_ReadExt(&convState, inBuf, bufSize, FIT_FALSE)) == FIT_CONVERT_MESSAGE_AVAILABLE) {
+                const FIT_UINT8 *mesg = FitConvert_GetMessageData(&convState);
+                FIT_UINT16 mesgNum = FitConvert_GetMessageNumber(&convState);
 
-                //printf("Mesg %d (%d) - ", mesgIndex, mesgNum);
+                //printf("Mesg %d (%d) - ", FitConvert_GetMessageIndex(&convState), mesgNum);
 
                 switch (mesgNum) {
                 case FIT_MESG_NUM_FILE_ID: {
@@ -193,35 +481,6 @@ int parseFitFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile)
                     break;
                 }
 
-                case FIT_MESG_NUM_DEVICE_SETTINGS: {
-                    //const FIT_DEVICE_SETTINGS_MESG *dev = (FIT_DEVICE_SETTINGS_MESG *) mesg;
-                    //printf("Device Settings: utc_offset=%u time_offset=%u:%u clock_time=%u\n",
-                    //        dev->utc_offset, dev->time_offset[0], dev->time_offset[1], dev->clock_time);
-                    break;
-                }
-
-                case FIT_MESG_NUM_USER_PROFILE: {
-                    //const FIT_USER_PROFILE_MESG *user_profile = (FIT_USER_PROFILE_MESG *) mesg;
-                    //printf("User Profile: weight=%0.1fkg gender=%u age=%u\n",
-                    //        user_profile->weight / 10.0f, user_profile->gender, user_profile->age);
-                    break;
-                }
-
-                case FIT_MESG_NUM_ZONES_TARGET: {
-                    //printf("Zones Target: \n");
-                    break;
-                }
-
-                case FIT_MESG_NUM_HR_ZONE: {
-                    //printf("HR Zone: \n");
-                    break;
-                }
-
-                case FIT_MESG_NUM_POWER_ZONE: {
-                    //printf("Power Zone: \n");
-                    break;
-                }
-
                 case FIT_MESG_NUM_SPORT: {
                     const FIT_SPORT_MESG *sport = (FIT_SPORT_MESG *) mesg;
                     //printf("Sport: sport=%u sub_sport=%u\n", sport->sport, sport->sub_sport);
@@ -239,22 +498,6 @@ int parseFitFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile)
                     break;
                 }
 
-                case FIT_MESG_NUM_SESSION: {
-                    //const FIT_SESSION_MESG *session = (FIT_SESSION_MESG *) mesg;
-                    //printf("Session: timestamp=%u start_lat=%d start_long=%d elapsed_time=%d distance=%d num_laps: %d\n",
-                    //        session->timestamp, session->start_position_lat, session->start_position_long,
-                    //        session->total_elapsed_time, session->total_distance, session->num_laps);
-                    break;
-                }
-
-                case FIT_MESG_NUM_LAP: {
-                    //const FIT_LAP_MESG *lap = (FIT_LAP_MESG *) mesg;
-                    //printf("Lap: timestamp=%u start_lat=%d start_long=%d end_lat=%d end_long=%d elapsed_time=%d distance=%d\n",
-                    //        lap->timestamp, lap->start_position_lat, lap->end_position_long, lap->end_position_lat, lap->end_position_long,
-                    //        lap->total_elapsed_time, lap->total_distance);
-                    break;
-                }
-
                 case FIT_MESG_NUM_RECORD: {
                     const FIT_RECORD_MESG *record = (FIT_RECORD_MESG *) mesg;
 #if 0
@@ -301,11 +544,8 @@ int parseFitFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile)
                              (record->enhanced_altitude == FIT_UINT32_INVALID))) {
                             //printf(" *** SKIPPED ***");
                         } else {
-                            // Alloc and init new TrkPt object
-                            if ((pTrkPt = newTrkPt(pTrk->numTrkPts++, inFile, mesgIndex)) == NULL) {
-                                fprintf(stderr, "Failed to create TrkPt object !!!\n");
-                                return -1;
-                            }
+                            // Init new TrkPt object
+                            pTrkPt = newTrkPt(pTrk, &trkPt, inFile, FitConvert_GetMessageIndex(&convState));
 
                             pTrkPt->timestamp = (double) ((time_t) record->timestamp + timeStampOffset);
 
@@ -357,8 +597,10 @@ int parseFitFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile)
                                 pTrk->inMask |= SD_POWER;
                             }
 
-                            // Insert track point at the tail of the queue
-                            TAILQ_INSERT_TAIL(&pTrk->trkPtList, pTrkPt, tqEntry);
+                            // Insert track point at the tail of the track
+                            if (addTrkPt(pTrk, pTrkPt) != 0) {
+                                return -1;
+                            }
 
                             pTrkPt = NULL;
                         }
@@ -383,66 +625,15 @@ int parseFitFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile)
                     break;
                 }
 
-                case FIT_MESG_NUM_DEVICE_INFO: {
-                    //const FIT_DEVICE_INFO_MESG *device_info = (FIT_DEVICE_INFO_MESG *) mesg;
-                    //printf("Device Info: timestamp=%u manufacturer=%u product=%u\n",
-                    //        device_info->timestamp, device_info->manufacturer, device_info->product);
-                    break;
-                }
-
-                case FIT_MESG_NUM_ACTIVITY: {
-                    //const FIT_ACTIVITY_MESG *activity = (FIT_ACTIVITY_MESG *) mesg;
-                    //printf("Activity: timestamp=%u, type=%u, event=%u, event_type=%u, num_sessions=%u\n",
-                    //       activity->timestamp, activity->type,
-                    //       activity->event, activity->event_type,
-                    //       activity->num_sessions);
-                    {
-                        FIT_ACTIVITY_MESG old_mesg;
-                        old_mesg.num_sessions = 1;
-                        FitConvert_RestoreFields(&old_mesg);
-                        //printf("Restored num_sessions=1 - Activity: timestamp=%u, actType=%u, event=%u, event_type=%u, num_sessions=%u\n",
-                        //       activity->timestamp, activity->type,
-                        //       activity->event, activity->event_type,
-                        //       activity->num_sessions);
-                    }
-                    break;
-                }
-
-                case FIT_MESG_NUM_FILE_CREATOR: {
-                    //const FIT_FILE_CREATOR_MESG *creator = (FIT_FILE_CREATOR_MESG *) mesg;
-                    //printf("File Creator: sw_ver=%u hw_ver=%u\n", creator->software_version, creator->hardware_version);
-                    break;
-                }
-
-                case FIT_MESG_NUM_HRV: {
-                    //const FIT_HRV_MESG *hrv = (FIT_HRV_MESG *) mesg;
-                    //printf("HRV: time=%.3lf\n", ((double) hrv->time[0] / 1000.0));
-                    break;
-                }
-
-                case FIT_MESG_NUM_FIELD_DESCRIPTION: {
-                    //const FIT_FIELD_DESCRIPTION_MESG *desc = (FIT_FIELD_DESCRIPTION_MESG *) mesg;
-                    //printf("Field Description: field_name=%s\n", desc->field_name);
-                    break;
-                }
-
-                case FIT_MESG_NUM_DEVELOPER_DATA_ID: {
-                    //const FIT_DEVELOPER_DATA_ID_MESG *id = (FIT_DEVELOPER_DATA_ID_MESG *) mesg;
-                    //printf("Developer Data ID: manufacturer_id=%u\n", id->manufacturer_id);
-                    break;
-                }
-
                 default:
                     //printf("Unknown\n");
                     break;
                 }
             }
-
-            mesgIndex++;
         } while (conRet == FIT_CONVERT_MESSAGE_AVAILABLE);
     }
 
-    fclose(fp);
+    closeInFile(pInFile);
 
     if (conRet != FIT_CONVERT_END_OF_FILE) {
         const char *errMsg = NULL;
@@ -512,15 +703,16 @@ int parseFitFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile)
 //
 int parseGpxFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile)
 {
-    FILE *fp;
+    InFile *pInFile;
+    TrkPt trkPt;
     TrkPt *pTrkPt = NULL;
+    LineView line;
     int lineNum = 0;
     int metaData = 0;
-    static char lineBuf[1024];
-    size_t bufLen = sizeof (lineBuf);
+    IsoTimeCache timeCache = {0};
 
     // Open the GPX file for reading
-    if ((fp = fopen(inFile, "r")) == NULL) {
+    if ((pInFile = openInFile(inFile)) == NULL) {
         fprintf(stderr, "Failed to open input file %s\n", inFile);
         return -1;
     }
@@ -534,136 +726,166 @@ int parseGpxFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile)
     //   .
     // </gpx>
     //
-    lineNum = getLine(fp, lineBuf, bufLen, lineNum);
+    lineNum = getLineView(pInFile, &line);
     if ((lineNum < 0) ||
-        (strstr(lineBuf, "<?xml ") == NULL)) {
+        !findStr(&line, "<?xml ")) {
         fprintf(stderr, "Input file is not an XML file !!!\n");
         return -1;
     }
-    lineNum = getLine(fp, lineBuf, bufLen, lineNum);
+    lineNum = getLineView(pInFile, &line);
     if ((lineNum < 0) ||
-        (strstr(lineBuf, "<gpx ") == NULL)) {
+        !findStr(&line, "<gpx ")) {
         fprintf(stderr, "Input file is not a recognized GPX file !!!\n");
         return -1;
     }
 
     // Process one line at a time, looking for <trkpt> ... </trkpt>
-    // blocks that define each individual track point.
-    while ((lineNum = getLine(fp, lineBuf, bufLen, lineNum)) != -1) {
-        double latitude, longitude, elevation;
-        struct tm brkDwnTime = {0};
-        int type, ambTemp, cadence, heartRate, power;
-        const char *p;
-
-        // Ignore the metadata
-        if (strstr(lineBuf, "<metadata>") != NULL) {
-            metaData++;
-            continue;
-        } else if (strstr(lineBuf, "</metadata>") != NULL) {
-            metaData--;
-            continue;
-        } else if (metaData) {
-            continue;
-        }
-
-        if (sscanf(lineBuf, " <type>%d</type>", &type) == 1) {
-            // Set the activity actType
-            pTrk->actType = type;
-        } else if ((sscanf(lineBuf, " <trkpt lat=\"%le\" lon=\"%le\">", &latitude, &longitude) == 2) ||
-                   (sscanf(lineBuf, " <trkpt lon=\"%le\" lat=\"%le\">", &longitude, &latitude) == 2)) {
-            if (pTrkPt != NULL) {
-                // Hu?
-                spongExit("Nested <trkpt> block !!!", inFile, lineNum, lineBuf);
+    // blocks that define each individual track point. Each XML
+    // element in the line is dispatched based on its name.
+    while ((lineNum = getLineView(pInFile, &line)) != -1) {
+        const char *p = line.ptr;
+        const char *end = line.ptr + line.len;
+        XmlTag tag;
+
+        while ((tag = nextXmlTag(&gpxTagTbl, &p, end)) != tagEol) {
+            double latitude, longitude, elevation, timestamp;
+            int type, ambTemp, cadence, heartRate, power;
+            const char *lat, *lon, *txt;
+
+            // Ignore the metadata
+            if (tag == tagMetadata) {
+                metaData++;
+                continue;
+            } else if (tag == tagMetadataEnd) {
+                metaData--;
+                continue;
+            } else if (metaData) {
+                continue;
             }
 
-            // Alloc and init new TrkPt object
-            if ((pTrkPt = newTrkPt(pTrk->numTrkPts++, inFile, lineNum)) == NULL) {
-                fprintf(stderr, "Failed to create TrkPt object !!!\n");
-                return -1;
-            }
+            switch (tag) {
+            case tagType:
+                txt = xmlText(p, end);
+                if (scanInt(&txt, end, &type)) {
+                    // Set the activity actType
+                    pTrk->actType = type;
+                }
+                break;
 
-            pTrkPt->latitude = latitude;
-            pTrkPt->longitude = longitude;
-        } else if (sscanf(lineBuf, " <ele>%le</ele>", &elevation) == 1) {
-            // Got the elevation!
-            if (pTrkPt == NULL) {
-                // Hu?
-                noActTrkPt(inFile, lineNum, lineBuf);
-            }
-            pTrkPt->elevation = elevation;
-        } else if ((p = strptime(lineBuf, " <time>%Y-%m-%dT%H:%M:%S", &brkDwnTime)) != NULL) {
-            time_t timeStamp;
-            int ms = 0;
-
-            // Got the time!
-            if (pTrkPt == NULL) {
-                // Hu?
-                noActTrkPt(inFile, lineNum, lineBuf);
-            }
+            case tagTrkpt:
+                if (((lat = xmlAttr(p, end, "lat")) == NULL) || !scanDouble(&lat, end, &latitude) ||
+                    ((lon = xmlAttr(p, end, "lon")) == NULL) || !scanDouble(&lon, end, &longitude)) {
+                    break;
+                }
+
+                if (pTrkPt != NULL) {
+                    // Hu?
+                    spongExit("Nested <trkpt> block !!!", inFile, lineNum, &line);
+                }
 
-            // Convert to seconds since the Epoch
-            timeStamp = mktime(&brkDwnTime);
+                // Init new TrkPt object
+                pTrkPt = newTrkPt(pTrk, &trkPt, inFile, lineNum);
 
-            // If present, read the millisec portion
-            if (sscanf(p, ".%d", &ms) == 1) {
-                if ((ms < 0) || (ms > 999)) {
-                    fprintf(stderr, "TrkPt %s has an invalid millisec value %d in its timestamp !!!\n", fmtTrkPtIdx(pTrkPt), ms);
-                    return -1;
+                pTrkPt->latitude = latitude;
+                pTrkPt->longitude = longitude;
+                break;
+
+            case tagEle:
+                txt = xmlText(p, end);
+                if (scanDouble(&txt, end, &elevation)) {
+                    // Got the elevation!
+                    if (pTrkPt == NULL) {
+                        // Hu?
+                        noActTrkPt(inFile, lineNum, &line);
+                    }
+                    pTrkPt->elevation = elevation;
                 }
-            }
+                break;
 
-            pTrkPt->timestamp = (double) timeStamp + ((double) ms / 1000.0);  // sec.millisec since the Epoch
-        } else if (sscanf(lineBuf, " <power>%d</power>", &power) == 1) {
-            // Got the power!
-            if (pTrkPt == NULL) {
-                // Hu?
-                noActTrkPt(inFile, lineNum, lineBuf);
-            }
-            pTrkPt->power = power;
-            pTrk->inMask |= SD_POWER;
-        } else if ((sscanf(lineBuf, " <gpxdata:atemp>%d</gpxdata:atemp>", &ambTemp) == 1) ||
-                   (sscanf(lineBuf, " <gpxtpx:atemp>%d</gpxtpx:atemp>", &ambTemp) == 1) ||
-                   (sscanf(lineBuf, " <ns3:atemp>%d</ns3:atemp>", &ambTemp) == 1)) {
-            // Got the ambient temperature!
-            if (pTrkPt == NULL) {
-                // Hu?
-                noActTrkPt(inFile, lineNum, lineBuf);
-            }
-            pTrkPt->ambTemp = ambTemp;
-            pTrk->inMask |= SD_ATEMP;
-        } else if ((sscanf(lineBuf, " <gpxdata:cadence>%d</gpxdata:cadence>", &cadence) == 1) ||
-                   (sscanf(lineBuf, " <gpxtpx:cad>%d</gpxtpx:cad>", &cadence) == 1) ||
-                   (sscanf(lineBuf, " <ns3:cad>%d</ns3:cad>", &cadence) == 1)) {
-            // Got the cadence!
-            if (pTrkPt == NULL) {
-                // Hu?
-                noActTrkPt(inFile, lineNum, lineBuf);
-            }
-            pTrkPt->cadence = cadence;
-            pTrk->inMask |= SD_CADENCE;
-        } else if ((sscanf(lineBuf, " <gpxdata:hr>%d</gpxdata:hr>", &heartRate) == 1) ||
-                   (sscanf(lineBuf, " <gpxtpx:hr>%d</gpxtpx:hr>", &heartRate) == 1) ||
-                   (sscanf(lineBuf, " <ns3:hr>%d</ns3:hr>", &heartRate) == 1)) {
-            // Got the heart rate!
-            if (pTrkPt == NULL) {
-                // Hu?
-                noActTrkPt(inFile, lineNum, lineBuf);
-            }
-            pTrkPt->heartRate = heartRate;
-            pTrk->inMask |= SD_HR;
-        } else if (strstr(lineBuf, "</trkpt>") != NULL) {
-            // End of Track Point!
-            if (pTrkPt == NULL) {
-                // Hu?
-                noActTrkPt(inFile, lineNum, lineBuf);
-            }
+            case tagTime:
+                txt = xmlText(p, end);
+                if (scanTime(&txt, end, &timeCache, &timestamp)) {
+                    // Got the time!
+                    if (pTrkPt == NULL) {
+                        // Hu?
+                        noActTrkPt(inFile, lineNum, &line);
+                    }
+
+                    pTrkPt->timestamp = timestamp;  // sec.millisec since the Epoch
+                }
+                break;
+
+            case tagPower:
+                txt = xmlText(p, end);
+                if (scanInt(&txt, end, &power)) {
+                    // Got the power!
+                    if (pTrkPt == NULL) {
+                        // Hu?
+                        noActTrkPt(inFile, lineNum, &line);
+                    }
+                    pTrkPt->power = power;
+                    pTrk->inMask |= SD_POWER;
+                }
+                break;
+
+            case tagAtemp:
+                txt = xmlText(p, end);
+                if (scanInt(&txt, end, &ambTemp)) {
+                    // Got the ambient temperature!
+                    if (pTrkPt == NULL) {
+                        // Hu?
+                        noActTrkPt(inFile, lineNum, &line);
+                    }
+                    pTrkPt->ambTemp = ambTemp;
+                    pTrk->inMask |= SD_ATEMP;
+                }
+                break;
+
+            case tagCadence:
+                txt = xmlText(p, end);
+                if (scanInt(&txt, end, &cadence)) {
+                    // Got the cadence!
+                    if (pTrkPt == NULL) {
+                        // Hu?
+                        noActTrkPt(inFile, lineNum, &line);
+                    }
+                    pTrkPt->cadence = cadence;
+                    pTrk->inMask |= SD_CADENCE;
+                }
+                break;
 
-            // Insert track point at the tail of the queue
-            TAILQ_INSERT_TAIL(&pTrk->trkPtList, pTrkPt, tqEntry);
+            case tagHeartRate:
+                txt = xmlText(p, end);
+                if (scanInt(&txt, end, &heartRate)) {
+                    // Got the heart rate!
+                    if (pTrkPt == NULL) {
+                        // Hu?
+                        noActTrkPt(inFile, lineNum, &line);
+                    }
+                    pTrkPt->heartRate = heartRate;
+                    pTrk->inMask |= SD_HR;
+                }
+                break;
 
-            pTrkPt = NULL;
-        } else {
-            // Ignore this line...
+            case tagTrkptEnd:
+                // End of Track Point!
+                if (pTrkPt == NULL) {
+                    // Hu?
+                    noActTrkPt(inFile, lineNum, &line);
+                }
+
+                // Insert track point at the tail of the track
+                if (addTrkPt(pTrk, pTrkPt) != 0) {
+                    return -1;
+                }
+
+                pTrkPt = NULL;
+                break;
+
+            default:
+                // Ignore this element...
+                break;
+            }
         }
     }
 
@@ -673,7 +895,7 @@ int parseGpxFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile)
         pArgs->outFmt = gpx;
     }
 
-    fclose(fp);
+    closeInFile(pInFile);
 
     return 0;
 }
@@ -793,15 +1015,17 @@ int parseGpxFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile)
 
 int parseTcxFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile)
 {
-    FILE *fp;
+    InFile *pInFile;
+    TrkPt trkPt;
     TrkPt *pTrkPt = NULL;
+    LineView line;
     int lineNum = 0;
-    static char lineBuf[1024];
-    size_t bufLen = sizeof (lineBuf);
     int trackBlock = false;
+    int hrBlock = false;
+    IsoTimeCache timeCache = {0};
 
     // Open the TCX file for reading
-    if ((fp = fopen(inFile, "r")) == NULL) {
+    if ((pInFile = openInFile(inFile)) == NULL) {
         fprintf(stderr, "Failed to open input file %s\n", inFile);
         return -1;
     }
@@ -815,183 +1039,238 @@ int parseTcxFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile)
     //   .
     //   .
     // </TrainingCenterDatabase>
-    lineNum = getLine(fp, lineBuf, bufLen, lineNum);
+    lineNum = getLineView(pInFile, &line);
     if ((lineNum < 0) ||
-        (strstr(lineBuf, "<?xml ") == NULL)) {
+        !findStr(&line, "<?xml ")) {
         fprintf(stderr, "Input file is not an XML file !!!\n");
         return -1;
     }
-    lineNum = getLine(fp, lineBuf, bufLen, lineNum);
+    lineNum = getLineView(pInFile, &line);
     if ((lineNum < 0) ||
-        (strstr(lineBuf, "<TrainingCenterDatabase") == NULL)) {
+        !findStr(&line, "<TrainingCenterDatabase")) {
         fprintf(stderr, "Input file is not a recognized TCX file !!!\n");
         return -1;
     }
 
     // Process one line at a time, looking for <Trackpoint> ... </Trackpoint>
-    // blocks that define each individual track point.
-    while ((lineNum = getLine(fp, lineBuf, bufLen, lineNum)) != -1) {
-        if (pTrk->actType == 0) {
-            if (strstr(lineBuf, "<Activity Sport=\"Biking\">") != NULL) {
-                pTrk->actType = ride;
-            } else if (strstr(lineBuf, "<Activity Sport=\"Hiking\">") != NULL) {
-                pTrk->actType = hike;
-            } else if (strstr(lineBuf, "<Activity Sport=\"Running\">") != NULL) {
-                pTrk->actType = run;
-            } else if (strstr(lineBuf, "<Activity Sport=\"Walking\">") != NULL) {
-                pTrk->actType = walk;
-            } else if (strstr(lineBuf, "<Activity Sport=\"Other\">") != NULL) {
-                pTrk->actType = other;
-            }
-            if (pTrk->actType != 0) {
-                // Got the activity type/sport!
-                continue;
-            }
-        }
-
-        if (strstr(lineBuf, "<Track>") != NULL) {
-            if (!trackBlock) {
-                // Start of a <Track> ... </Track> block
-                trackBlock = true;
-            } else {
-                // Hu?
-                fprintf(stderr, "SPONG! Nested <Track> block !!! %s:%u \"%s\"\n", inFile, lineNum, lineBuf);
-                return -1;
-            }
-        } else if (strstr(lineBuf, "</Track>") != NULL) {
-            if (trackBlock) {
-                // End of a <Track> ... </Track> block
-                trackBlock = false;
-            } else {
-                // Hu?
-                fprintf(stderr, "SPONG! Bogus </Track> tag !!! %s:%u \"%s\"\n", inFile, lineNum, lineBuf);
-                return -1;
-            }
-        } else if (trackBlock) {
-            double latitude, longitude, elevation;
+    // blocks that define each individual track point. Each XML
+    // element in the line is dispatched based on its name.
+    while ((lineNum = getLineView(pInFile, &line)) != -1) {
+        const char *p = line.ptr;
+        const char *end = line.ptr + line.len;
+        XmlTag tag;
+
+        while ((tag = nextXmlTag(&tcxTagTbl, &p, end)) != tagEol) {
+            double latitude, longitude, elevation, timestamp;
             double distance, grade, speed;
-            struct tm brkDwnTime = {0};
             int cadence, heartRate, power;
-            const char *p;
+            const char *sport, *txt;
 
-            if (strstr(lineBuf, "<Trackpoint>") != NULL) {
-                if (pTrkPt != NULL) {
-                    // Hu?
-                    fprintf(stderr, "SPONG! Nested <Trackpoint> block !!! %s:%u \"%s\"\n", inFile, lineNum, lineBuf);
-                    return -1;
+            if ((tag == tagActivity) && (pTrk->actType == 0)) {
+                if ((sport = xmlAttr(p, end, "Sport")) != NULL) {
+                    if (matchStr(&sport, end, "Biking\"")) {
+                        pTrk->actType = ride;
+                    } else if (matchStr(&sport, end, "Hiking\"")) {
+                        pTrk->actType = hike;
+                    } else if (matchStr(&sport, end, "Running\"")) {
+                        pTrk->actType = run;
+                    } else if (matchStr(&sport, end, "Walking\"")) {
+                        pTrk->actType = walk;
+                    } else if (matchStr(&sport, end, "Other\"")) {
+                        pTrk->actType = other;
+                    }
                 }
+                continue;
+            }
 
-                // Alloc and init new TrkPt object
-                if ((pTrkPt = newTrkPt(pTrk->numTrkPts++, inFile, lineNum)) == NULL) {
-                    fprintf(stderr, "Failed to create TrkPt object !!!\n");
+            if (tag == tagTrack) {
+                if (!trackBlock) {
+                    // Start of a <Track> ... </Track> block
+                    trackBlock = true;
+                } else {
+                    // Hu?
+                    fprintf(stderr, "SPONG! Nested <Track> block !!! %s:%u \"%.*s\"\n", inFile, lineNum, (int) line.len, line.ptr);
                     return -1;
                 }
-            } else if (sscanf(lineBuf, " <LatitudeDegrees>%le</LatitudeDegrees>", &latitude) == 1) {
-                // Got the latitude!
-                if (pTrkPt == NULL) {
+                continue;
+            } else if (tag == tagTrackEnd) {
+                if (trackBlock) {
+                    // End of a <Track> ... </Track> block
+                    trackBlock = false;
+                } else {
                     // Hu?
-                    noActTrkPt(inFile, lineNum, lineBuf);
+                    fprintf(stderr, "SPONG! Bogus </Track> tag !!! %s:%u \"%.*s\"\n", inFile, lineNum, (int) line.len, line.ptr);
+                    return -1;
                 }
-                pTrkPt->latitude = latitude;
-            } else if (sscanf(lineBuf, " <LongitudeDegrees>%le</LongitudeDegrees>", &longitude) == 1) {
-                // Got the longitude!
-                if (pTrkPt == NULL) {
+                continue;
+            } else if (!trackBlock) {
+                continue;
+            }
+
+            switch (tag) {
+            case tagTrackpoint:
+                if (pTrkPt != NULL) {
                     // Hu?
-                    noActTrkPt(inFile, lineNum, lineBuf);
+                    fprintf(stderr, "SPONG! Nested <Trackpoint> block !!! %s:%u \"%.*s\"\n", inFile, lineNum, (int) line.len, line.ptr);
+                    return -1;
                 }
-                pTrkPt->longitude = longitude;
-            } else if (sscanf(lineBuf, " <AltitudeMeters>%le</AltitudeMeters>", &elevation) == 1) {
-                // Got the elevation!
-                if (pTrkPt == NULL) {
-                    // Hu?
-                    noActTrkPt(inFile, lineNum, lineBuf);
+
+                // Init new TrkPt object
+                pTrkPt = newTrkPt(pTrk, &trkPt, inFile, lineNum);
+                break;
+
+            case tagLatitudeDegrees:
+                txt = xmlText(p, end);
+                if (scanDouble(&txt, end, &latitude)) {
+                    // Got the latitude!
+                    if (pTrkPt == NULL) {
+                        // Hu?
+                        noActTrkPt(inFile, lineNum, &line);
+                    }
+                    pTrkPt->latitude = latitude;
                 }
-                pTrkPt->elevation = elevation;
-            } else if (sscanf(lineBuf, " <DistanceMeters>%le</DistanceMeters>", &distance) == 1) {
-                // Got the distance!
-                if (pTrkPt == NULL) {
-                    // Hu?
-                    noActTrkPt(inFile, lineNum, lineBuf);
+                break;
+
+            case tagLongitudeDegrees:
+                txt = xmlText(p, end);
+                if (scanDouble(&txt, end, &longitude)) {
+                    // Got the longitude!
+                    if (pTrkPt == NULL) {
+                        // Hu?
+                        noActTrkPt(inFile, lineNum, &line);
+                    }
+                    pTrkPt->longitude = longitude;
                 }
-                pTrkPt->distance = distance;
-            } else if ((p = strptime(lineBuf, " <Time>%Y-%m-%dT%H:%M:%S", &brkDwnTime)) != NULL) {
-                time_t timeStamp;
-                int ms = 0;
+                break;
 
-                // Got the time!
-                if (pTrkPt == NULL) {
-                    // Hu?
-                    noActTrkPt(inFile, lineNum, lineBuf);
+            case tagAltitudeMeters:
+                txt = xmlText(p, end);
+                if (scanDouble(&txt, end, &elevation)) {
+                    // Got the elevation!
+                    if (pTrkPt == NULL) {
+                        // Hu?
+                        noActTrkPt(inFile, lineNum, &line);
+                    }
+                    pTrkPt->elevation = elevation;
                 }
+                break;
 
-                // Convert to seconds since the Epoch
-                timeStamp = mktime(&brkDwnTime);
+            case tagDistanceMeters:
+                txt = xmlText(p, end);
+                if (scanDouble(&txt, end, &distance)) {
+                    // Got the distance!
+                    if (pTrkPt == NULL) {
+                        // Hu?
+                        noActTrkPt(inFile, lineNum, &line);
+                    }
+                    pTrkPt->distance = distance;
+                }
+                break;
 
-                // If present, read the millisec portion
-                if (sscanf(p, ".%d", &ms) == 1) {
-                    if ((ms < 0) || (ms > 999)) {
-                        fprintf(stderr, "TrkPt %s has an invalid millisec value %d in timestamp !!!\n", fmtTrkPtIdx(pTrkPt), ms);
-                        return -1;
+            case tagTime:
+                txt = xmlText(p, end);
+                if (scanTime(&txt, end, &timeCache, &timestamp)) {
+                    // Got the time!
+                    if (pTrkPt == NULL) {
+                        // Hu?
+                        noActTrkPt(inFile, lineNum, &line);
                     }
+
+                    pTrkPt->timestamp = timestamp;  // sec+millisec since the Epoch
                 }
+                break;
 
-                pTrkPt->timestamp = (double) timeStamp + ((double) ms / 1000.0);  // sec+millisec since the Epoch
-            } else if (sscanf(lineBuf, " <GradePercent>%le</GradePercent>", &grade) == 1) {
-                // Got the grade!
-                if (pTrkPt == NULL) {
-                    // Hu?
-                    noActTrkPt(inFile, lineNum, lineBuf);
+            case tagGradePercent:
+                txt = xmlText(p, end);
+                if (scanDouble(&txt, end, &grade)) {
+                    // Got the grade!
+                    if (pTrkPt == NULL) {
+                        // Hu?
+                        noActTrkPt(inFile, lineNum, &line);
+                    }
+                    pTrkPt->grade = grade;
                 }
-                pTrkPt->grade = grade;
-            } else if ((sscanf(lineBuf, " <ns3:Speed>%le<ns3:/Speed>", &speed) == 1) ||
-                       (sscanf(lineBuf, " <Speed>%le</Speed>", &speed) == 1)) {
-                // Got the speed!
-                if (pTrkPt == NULL) {
-                    // Hu?
-                    noActTrkPt(inFile, lineNum, lineBuf);
+                break;
+
+            case tagSpeed:
+                txt = xmlText(p, end);
+                if (scanDouble(&txt, end, &speed)) {
+                    // Got the speed!
+                    if (pTrkPt == NULL) {
+                        // Hu?
+                        noActTrkPt(inFile, lineNum, &line);
+                    }
+                    pTrkPt->speed = speed;
                 }
-                pTrkPt->speed = speed;
-            } else if ((sscanf(lineBuf, " <ns3:Watts>%d<ns3:/Watts>", &power) == 1) ||
-                       (sscanf(lineBuf, " <Watts>%d</Watts>", &power) == 1)) {
-                // Got the power!
-                if (pTrkPt == NULL) {
-                    // Hu?
-                    noActTrkPt(inFile, lineNum, lineBuf);
+                break;
+
+            case tagPower:
+                txt = xmlText(p, end);
+                if (scanInt(&txt, end, &power)) {
+                    // Got the power!
+                    if (pTrkPt == NULL) {
+                        // Hu?
+                        noActTrkPt(inFile, lineNum, &line);
+                    }
+                    pTrkPt->power = power;
+                    pTrk->inMask |= SD_POWER;
                 }
-                pTrkPt->power = power;
-                pTrk->inMask |= SD_POWER;
-            } else if (sscanf(lineBuf, " <Cadence>%d</Cadence>", &cadence) == 1) {
-                // Got the cadence!
-                if (pTrkPt == NULL) {
-                    // Hu?
-                    noActTrkPt(inFile, lineNum, lineBuf);
+                break;
+
+            case tagCadence:
+                txt = xmlText(p, end);
+                if (scanInt(&txt, end, &cadence)) {
+                    // Got the cadence!
+                    if (pTrkPt == NULL) {
+                        // Hu?
+                        noActTrkPt(inFile, lineNum, &line);
+                    }
+                    pTrkPt->cadence = cadence;
+                    pTrk->inMask |= SD_CADENCE;
                 }
-                pTrkPt->cadence = cadence;
-                pTrk->inMask |= SD_CADENCE;
-            } else if (strstr(lineBuf, "<HeartRateBpm") != NULL) {
-                lineNum = getLine(fp, lineBuf, bufLen, lineNum);
-                if (sscanf(lineBuf, " <Value>%d</Value>", &heartRate) == 1) {
+                break;
+
+            case tagHeartRateBpm:
+                // The heart rate value comes in the <Value>
+                // element of the <HeartRateBpm> block.
+                hrBlock = true;
+                break;
+
+            case tagHeartRateBpmEnd:
+                hrBlock = false;
+                break;
+
+            case tagValue:
+                txt = xmlText(p, end);
+                if (hrBlock && scanInt(&txt, end, &heartRate)) {
                     // Got the heart rate!
                     if (pTrkPt == NULL) {
                         // Hu?
-                        noActTrkPt(inFile, lineNum, lineBuf);
+                        noActTrkPt(inFile, lineNum, &line);
                     }
                     pTrkPt->heartRate = heartRate;
                     pTrk->inMask |= SD_HR;
                 }
-            } else if (strstr(lineBuf, "</Trackpoint>") != NULL) {
+                break;
+
+            case tagTrackpointEnd:
                 // End of Track Point!
                 if (pTrkPt == NULL) {
                     // Hu?
-                    noActTrkPt(inFile, lineNum, lineBuf);
+                    noActTrkPt(inFile, lineNum, &line);
                 }
 
-                // Insert track point at the tail of the queue
-                TAILQ_INSERT_TAIL(&pTrk->trkPtList, pTrkPt, tqEntry);
+                // Insert track point at the tail of the track
+                if (addTrkPt(pTrk, pTrkPt) != 0) {
+                    return -1;
+                }
 
                 pTrkPt = NULL;
-            } else {
-                // Ignore this line...
+                break;
+
+            default:
+                // Ignore this element...
+                break;
             }
         }
     }
@@ -1002,7 +1281,195 @@ int parseTcxFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile)
         pArgs->outFmt = tcx;
     }
 
-    fclose(fp);
+    closeInFile(pInFile);
+
+    return 0;
+}
+
+// Parse the input file, based on its file suffix
+static int parseInFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile)
+{
+    const char *fileSuffix = strrchr(inFile, '.');
+
+    if (strcmp(fileSuffix, ".csv") == 0) {
+        return parseCsvFile(pArgs, pTrk, inFile);
+    } else if (strcmp(fileSuffix, ".fit") == 0) {
+        return parseFitFile(pArgs, pTrk, inFile);
+    } else if (strcmp(fileSuffix, ".gpx") == 0) {
+        return parseGpxFile(pArgs, pTrk, inFile);
+    } else if (strcmp(fileSuffix, ".tcx") == 0) {
+        return parseTcxFile(pArgs, pTrk, inFile);
+    }
+
+    return -1;
+}
+
+#ifndef _MSC_FULL_VER
+// Each input file is parsed by a worker thread into its own
+// private GpsTrk object, using a private copy of the command
+// args, so the parsers don't need to know about each other.
+typedef struct InFileJob {
+    const char *inFile;     // input file name
+    CmdArgs args;           // private copy of the command args
+    GpsTrk trk;             // TrkPt's of this input file
+    int status;             // parser's return status
+} InFileJob;
+
+typedef struct InFileJobQueue {
+    InFileJob *jobs;        // one job per input file
+    int numJobs;            // number of jobs
+    int nextJob;            // next job to be picked up
+} InFileJobQueue;
+
+static void *inFileWorker(void *arg)
+{
+    InFileJobQueue *pQueue = arg;
+    int n;
+
+    while ((n = __sync_fetch_and_add(&pQueue->nextJob, 1)) < pQueue->numJobs) {
+        InFileJob *pJob = &pQueue->jobs[n];
+        packTrkPts(&pJob->trk);     // until it gets appended to the main track
+        pJob->status = parseInFile(&pJob->args, &pJob->trk, pJob->inFile);
+        if (flushTrkPts(&pJob->trk) != 0) {
+            pJob->status = -1;
+        }
+    }
+
+    return NULL;
+}
+
+// Parse the input files in parallel, and then splice their
+// TrkPt lists together in the order the files were specified
+// in the command line. The result is the same as if the files
+// had been parsed one after another into the same track.
+static int parseInFilesParallel(CmdArgs *pArgs, GpsTrk *pTrk, int numFiles, char **inFiles, int numThreads)
+{
+    InFileJobQueue queue = {0};
+    pthread_t *threads;
+    int numWorkers = 0;
+    int numPts;
+    int n, s = 0;
+
+    if (((queue.jobs = calloc(numFiles, sizeof (InFileJob))) == NULL) ||
+        ((threads = calloc(numThreads, sizeof (pthread_t))) == NULL)) {
+        fprintf(stderr, "Failed to alloc input file jobs !!!\n");
+        free(queue.jobs);
+        return -1;
+    }
+
+    queue.numJobs = numFiles;
+
+    for (n = 0; n < numFiles; n++) {
+        InFileJob *pJob = &queue.jobs[n];
+        pJob->inFile = inFiles[n];
+        pJob->args = *pArgs;
+        pJob->args.inFile = inFiles[n];
+    }
+
+    // The calling thread picks up jobs as well, so we
+    // can live with fewer threads than requested.
+    for (n = 1; n < numThreads; n++) {
+        if (pthread_create(&threads[numWorkers], NULL, inFileWorker, &queue) == 0) {
+            numWorkers++;
+        }
+    }
+
+    inFileWorker(&queue);
+
+    for (n = 0; n < numWorkers; n++) {
+        pthread_join(threads[n], NULL);
+    }
+
+    free(threads);
+
+    // Make room for all the TrkPt's at once
+    for (n = 0, numPts = pTrk->trkPts.count; n < numFiles; n++) {
+        numPts += queue.jobs[n].trk.numTrkPts;
+    }
+    if (reserveTrkPts(pTrk, numPts) != 0) {
+        s = -1;
+    }
+
+    for (n = 0; (s == 0) && (n < numFiles); n++) {
+        InFileJob *pJob = &queue.jobs[n];
+
+        if (pJob->status != 0) {
+            fprintf(stderr, "Failed to parse input file %s\n", pJob->inFile);
+            s = -1;
+            break;
+        }
+
+        if (appendTrkPts(pTrk, &pJob->trk) != 0) {
+            s = -1;
+            break;
+        }
+
+        pTrk->inMask |= pJob->trk.inMask;
+
+        // The activity type is set by the last file that
+        // specifies one, except for TCX files, which don't
+        // override the type set by a previous file.
+        if ((pJob->trk.actType != undef) &&
+            ((pTrk->actType == undef) || (strcmp(strrchr(pJob->inFile, '.'), ".tcx") != 0))) {
+            pTrk->actType = pJob->trk.actType;
+        }
+
+        // The output format defaults to the format of
+        // the first input file.
+        if (pArgs->outFmt == nil) {
+            pArgs->outFmt = pJob->args.outFmt;
+        }
+    }
+
+    for (n = 0; n < numFiles; n++) {
+        freeTrkPts(&queue.jobs[n].trk);
+    }
+
+    free(queue.jobs);
+
+    return s;
+}
+#endif  // _MSC_FULL_VER
+
+// Parse all the input files, appending their TrkPt's to the
+// track in the order the files were specified.
+int parseInFiles(CmdArgs *pArgs, GpsTrk *pTrk, int numFiles, char **inFiles)
+{
+    int numThreads = pArgs->numThreads;
+    int n;
+
+    // Make sure we support all the input files before
+    // we start parsing any of them.
+    for (n = 0; n < numFiles; n++) {
+        const char *fileSuffix = strrchr(inFiles[n], '.');
+
+        if ((fileSuffix == NULL) ||
+            ((strcmp(fileSuffix, ".csv") != 0) && (strcmp(fileSuffix, ".fit") != 0) &&
+             (strcmp(fileSuffix, ".gpx") != 0) && (strcmp(fileSuffix, ".tcx") != 0))) {
+            fprintf(stderr, "Unsupported input file %s\n", inFiles[n]);
+            return -1;
+        }
+    }
+
+    if (numThreads > numFiles) {
+        numThreads = numFiles;
+    }
+
+#ifndef _MSC_FULL_VER
+    if (numThreads > 1) {
+        return parseInFilesParallel(pArgs, pTrk, numFiles, inFiles, numThreads);
+    }
+#endif  // _MSC_FULL_VER
+
+    for (n = 0; n < numFiles; n++) {
+        pArgs->inFile = inFiles[n];
+        if (parseInFile(pArgs, pTrk, inFiles[n]) != 0) {
+            fprintf(stderr, "Failed to parse input file %s\n", inFiles[n]);
+            return -1;
+        }
+    }
+
+    pArgs->inFile = NULL;
 
     return 0;
 }
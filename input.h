@@ -27,6 +27,7 @@ extern int parseCsvFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile);
 extern int parseFitFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile);
 extern int parseGpxFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile);
 extern int parseTcxFile(CmdArgs *pArgs, GpsTrk *pTrk, const char *inFile);
+extern int parseInFiles(CmdArgs *pArgs, GpsTrk *pTrk, int numFiles, char **inFiles);
 
 #ifdef __cplusplus
 };
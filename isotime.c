@@ -0,0 +1,175 @@
+/*=========================================================================
+ *
+ *   Filename:           isotime.c
+ *
+ *   Author:             Marcelo Mourier
+ *   Created:            Mon Apr 11 11:24:16 MDT 2022
+ *
+ *   Description:        ISO-8601 timestamp decoder
+ *
+ *=========================================================================
+ *
+ *                  Copyright (c) 2022 Marcelo Mourier
+ *
+ *=========================================================================
+*/
+
+#include <string.h>
+
+#include "isotime.h"
+
+// Parse exactly numDigits decimal digits at p
+static __inline__ Bool scanDigits(const char *p, int numDigits, int *pVal)
+{
+    int val = 0;
+
+    for (int n = 0; n < numDigits; n++, p++) {
+        if ((*p < '0') || (*p > '9'))
+            return false;
+        val = (val * 10) + (*p - '0');
+    }
+
+    *pVal = val;
+
+    return true;
+}
+
+// Number of days since 1970-01-01 of the given date in the
+// proleptic Gregorian calendar. See Howard Hinnant's
+// "days_from_civil" algorithm.
+static long daysFromCivil(int year, int mon, int day)
+{
+    long era, yoe, doy, doe;
+
+    year -= (mon <= 2);
+    era = ((year >= 0) ? year : (year - 399)) / 400;
+    yoe = year - (era * 400);                                       // [0, 399]
+    doy = ((153 * (mon + ((mon > 2) ? -3 : 9)) + 2) / 5) + day - 1; // [0, 365]
+    doe = (yoe * 365) + (yoe / 4) - (yoe / 100) + doy;              // [0, 146096]
+
+    return (era * 146097) + doe - 719468;
+}
+
+time_t utcTime(int year, int mon, int day, int hour, int min, int sec)
+{
+    return (time_t) ((daysFromCivil(year, mon, day) * 86400L) + (hour * 3600L) + (min * 60L) + sec);
+}
+
+// Decode the "YYYY-MM-DD" date at p
+static Bool scanDate(const char *p, time_t *pDayStart)
+{
+    int year, mon, day;
+
+    if (!scanDigits(p, 4, &year) || (p[4] != '-') ||
+        !scanDigits(p+5, 2, &mon) || (p[7] != '-') ||
+        !scanDigits(p+8, 2, &day)) {
+        return false;
+    }
+
+    if ((mon < 1) || (mon > 12) || (day < 1) || (day > 31))
+        return false;
+
+    *pDayStart = utcTime(year, mon, day, 0, 0, 0);
+
+    return true;
+}
+
+const char *parseIsoTime(const char *str, const char *end, IsoTimeCache *pCache, double *pTime)
+{
+    const char *p = str;
+    time_t dayStart;
+    int hour, min, sec;
+    double frac = 0.0;
+
+    while ((p < end) && ((*p == ' ') || (*p == '\t')))
+        p++;
+
+    // Need at least "YYYY-MM-DDTHH:MM:SS"
+    if ((end - p) < 19)
+        return NULL;
+
+    if ((pCache != NULL) && pCache->valid && (memcmp(p, pCache->date, sizeof (pCache->date)) == 0)) {
+        // Same date as the previous timestamp
+        dayStart = pCache->dayStart;
+    } else {
+        if (!scanDate(p, &dayStart))
+            return NULL;
+
+        if (pCache != NULL) {
+            memcpy(pCache->date, p, sizeof (pCache->date));
+            pCache->dayStart = dayStart;
+            pCache->valid = true;
+        }
+    }
+    p += 10;
+
+    if ((*p != 'T') ||
+        !scanDigits(p+1, 2, &hour) || (p[3] != ':') ||
+        !scanDigits(p+4, 2, &min) || (p[6] != ':') ||
+        !scanDigits(p+7, 2, &sec)) {
+        return NULL;
+    }
+
+    if ((hour > 23) || (min > 59) || (sec > 60))
+        return NULL;
+    p += 9;
+
+    // If present, read the fractional seconds, which can have
+    // any number of digits; e.g. FulGaz uses 7 of them.
+    if ((p < end) && (*p == '.')) {
+        double scale = 1.0;
+        long digits = 0;
+
+        for (p++; (p < end) && (*p >= '0') && (*p <= '9'); p++) {
+            if (scale < 1e15) {
+                digits = (digits * 10) + (*p - '0');
+                scale *= 10.0;
+            }
+        }
+
+        frac = (double) digits / scale;
+    }
+
+    *pTime = (double) (dayStart + (hour * 3600L) + (min * 60L) + sec) + frac;
+
+    return p;
+}
+
+const char *parseIsoZone(const char *str, const char *end, double *pOffset)
+{
+    const char *p = str;
+    int hour, min = 0;
+    int sign;
+
+    *pOffset = 0.0;
+
+    if (p == end)
+        return p;   // no designator: UTC
+
+    if (*p == 'Z')
+        return (p + 1);
+
+    if ((*p != '+') && (*p != '-'))
+        return NULL;
+    sign = (*p++ == '-') ? -1 : 1;
+
+    // "+HH", "+HHMM", or "+HH:MM"
+    if (((end - p) < 2) || !scanDigits(p, 2, &hour))
+        return NULL;
+    p += 2;
+    if ((p < end) && (*p == ':'))
+        p++;
+    if ((p < end) && (*p >= '0') && (*p <= '9')) {
+        if (((end - p) < 2) || !scanDigits(p, 2, &min))
+            return NULL;
+        p += 2;
+    }
+
+    if ((hour > 23) || (min > 59))
+        return NULL;
+
+    *pOffset = (double) (sign * ((hour * 3600L) + (min * 60L)));
+
+    return p;
+}
+
@@ -0,0 +1,56 @@
+/*=========================================================================
+ *
+ *   Filename:           isotime.h
+ *
+ *   Author:             Marcelo Mourier
+ *   Created:            Mon Apr 11 11:24:16 MDT 2022
+ *
+ *   Description:        ISO-8601 timestamp decoder
+ *
+ *=========================================================================
+ *
+ *                  Copyright (c) 2022 Marcelo Mourier
+ *
+ *=========================================================================
+*/
+
+#ifndef ISOTIME_H_
+#define ISOTIME_H_
+
+#include <time.h>
+
+#include "defs.h"
+
+// On 1 Hz tracks consecutive timestamps share the same date,
+// so we remember the last one and the UTC of its midnight.
+typedef struct IsoTimeCache {
+    char date[10];      // "YYYY-MM-DD" of the last timestamp
+    time_t dayStart;    // seconds since the Epoch at 00:00:00Z
+    Bool valid;         // cache contents are valid
+} IsoTimeCache;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Seconds since the Epoch of the given UTC date and time
+extern time_t utcTime(int year, int mon, int day, int hour, int min, int sec);
+
+// Decode the "YYYY-MM-DDTHH:MM:SS[.fff...]" timestamp at str,
+// without going past end, as UTC. The cache is optional and
+// can be NULL. Returns a pointer to the character right after
+// the timestamp, or NULL if there is no valid timestamp.
+extern const char *parseIsoTime(const char *str, const char *end, IsoTimeCache *pCache, double *pTime);
+
+// Decode the optional time zone designator ("Z", "+HH:MM",
+// "-HHMM", "+HH", etc.) at str, without going past end, and
+// return its offset from UTC in seconds; no designator means
+// UTC. Returns a pointer to the character right after the
+// designator, or NULL if it is not valid.
+extern const char *parseIsoZone(const char *str, const char *end, double *pOffset);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* ISOTIME_H_ */
@@ -72,13 +72,16 @@
 #include "const.h"
 #include "defs.h"
 #include "input.h"
+#include "isotime.h"
 #include "output.h"
 #include "trkpt.h"
 
 #ifdef _MSC_FULL_VER
 // As usual, Windows/MSC has its own idiosyncrasies...
 #include "win/gmtime_r.c"
-#include "win/strptime.c"
+#else
+#include <pthread.h>
+#include <unistd.h>
 #endif  // _MSC_FULL_VER
 
 // Compile-time build info
@@ -103,6 +106,12 @@ static const char *help =
         "        absolute timestamps.\n"
         "    --csv-units {imperial|metric}\n"
         "        Specifies the type of units to use in the CSV output.\n"
+        "    --fused\n"
+        "        Run all the processing stages in a single pass over the track\n"
+        "        points, instead of one full pass per stage, so large tracks\n"
+        "        are processed faster. The output data is the same, but the\n"
+        "        warning and info messages of the different stages may be\n"
+        "        printed in a different order.\n"
         "    --help\n"
         "        Show this help and exit.\n"
         "    --max-grade <value>\n"
@@ -141,21 +150,42 @@ static const char *help =
         "    --range <a,b>\n"
         "        Limit the track points to be processed to the range between point\n"
         "        'a' and point 'b', inclusive.\n"
+        "    --range-dist <a,b>\n"
+        "        Same as --range, but with the range specified as the distance\n"
+        "        (in km) from the start of the track.\n"
+        "    --range-time <a,b>\n"
+        "        Same as --range, but with the range specified as the time (in\n"
+        "        seconds) from the start of the track.\n"
         "    --set-speed <avg-speed>\n"
         "        Use the specified average speed value (in km/h) to generate missing\n"
         "        timestamps, or to replace the existing timestamps, in the input file.\n"
         "    --start-time <time>\n"
-        "        Start time for the activity (in UTC time). The timestamp of each\n"
-        "        point is adjusted accordingly. Format is: 2018-01-22T10:01:10Z.\n"
+        "        Start time for the activity. The timestamp of each point is\n"
+        "        adjusted accordingly. Format is: 2018-01-22T10:01:10Z, with an\n"
+        "        optional time zone offset instead of the 'Z'; e.g. -06:00. A\n"
+        "        time without a 'Z' or offset is taken as UTC, not local time.\n"
         "    --summary\n"
         "        Print only a summary of the activity metrics in human-readable\n"
         "        form and exit.\n"
+        "    --threads <num>\n"
+        "        Max number of threads used to process the data; e.g. to parse\n"
+        "        multiple input files, or to compute the metrics of, or smooth,\n"
+        "        large tracks, in parallel.\n"
+        "        By default one thread per CPU is used. Use 1 to disable multi-\n"
+        "        threading. The results are the same regardless of the number\n"
+        "        of threads.\n"
         "    --trim <a,b>\n"
         "        Trim all the points in the specified range. The timestamps of\n"
         "        the points after point 'b' are adjusted accordingly, to avoid\n"
         "        a discontinuity in the time sequence. If point 'a' happens to be\n"
         "        the first point in the track, then the start time of the activity\n"
         "        is adjusted as well.\n"
+        "    --trim-dist <a,b>\n"
+        "        Same as --trim, but with the range specified as the distance\n"
+        "        (in km) from the start of the track.\n"
+        "    --trim-time <a,b>\n"
+        "        Same as --trim, but with the range specified as the time (in\n"
+        "        seconds) from the start of the track.\n"
         "    --verbatim\n"
         "        Process the input file(s) verbatim, without making any adjust-\n"
         "        ments to the data.\n"
@@ -163,21 +193,96 @@ static const char *help =
         "        Show version information and exit.\n"
         "    --xma-method {simple|weighed}\n"
         "        Specifies the type of Moving Average to compute: SMA or WMA.\n"
-        "    --xma-metric {elevation|grade|power|speed}\n"
-        "        Specifies the metric to be smoothed out by the selected Moving\n"
-        "        Average method.\n"
+        "    --xma-metric <metric>[:<window>][:<method>][,...]\n"
+        "        Specifies the metric(s) to be smoothed out by the selected Moving\n"
+        "        Average method: elevation, grade, power, or speed. Each metric\n"
+        "        can optionally specify its own window size and method (simple\n"
+        "        or weighed); e.g. \"elevation:9,power:5:weighed\". Otherwise the\n"
+        "        values given by --xma-window and --xma-method are used.\n"
         "    --xma-window <size>\n"
         "        Size of the window used to compute the selected Moving Average.\n"
-        "        It must be an odd value.\n";
+        "        It must be an odd value between 1 and 1000001.\n";
 
 static void invalidArgument(const char *arg, const char *val)
 {
     fprintf(stderr, "Invalid argument: %s %s\n", arg, (val != NULL) ? val : "");
 }
 
+// The SMA/WMA window must have an odd number of points, and
+// be small enough for its buffers and sums to stay in range.
+static Bool isValidXmaWindow(int xmaWindow)
+{
+    return ((xmaWindow >= 1) && (xmaWindow <= XMA_MAX_WINDOW) && ((xmaWindow % 2) != 0));
+}
+
+// Parse the list of metrics given to --xma-metric, each one
+// of them with its optional window size and method; e.g.
+// "elevation:9,power:5:weighed".
+static int parseXmaSpecs(const char *val, CmdArgs *pArgs)
+{
+    const char *s = val;
+
+    for (;;) {
+        XmaSpec spec = {0};
+        char name[16];
+        int len, n;
+
+        if (sscanf(s, "%15[a-z]%n", name, &len) != 1) {
+            return -1;
+        }
+        if (strcmp(name, "elevation") == 0) {
+            spec.xmaMetric = elevation;
+        } else if (strcmp(name, "grade") == 0) {
+            spec.xmaMetric = grade;
+        } else if (strcmp(name, "power") == 0) {
+            spec.xmaMetric = power;
+        } else if (strcmp(name, "speed") == 0) {
+            spec.xmaMetric = speed;
+        } else {
+            return -1;
+        }
+        s += len;
+
+        while (*s == ':') {
+            s++;
+            if ((*s >= '0') && (*s <= '9')) {
+                if ((sscanf(s, "%d%n", &spec.xmaWindow, &len) != 1) ||
+                    !isValidXmaWindow(spec.xmaWindow)) {
+                    return -1;
+                }
+            } else if (sscanf(s, "%15[a-z]%n", name, &len) == 1) {
+                if (strcmp(name, "simple") == 0) {
+                    spec.xmaMethod = simple;
+                } else if (strcmp(name, "weighed") == 0) {
+                    spec.xmaMethod = weighed;
+                } else {
+                    return -1;
+                }
+            } else {
+                return -1;
+            }
+            s += len;
+        }
+
+        // Each metric can only be specified once
+        for (n = 0; n < pArgs->numXmaSpecs; n++) {
+            if (pArgs->xmaSpecs[n].xmaMetric == spec.xmaMetric) {
+                return -1;
+            }
+        }
+        pArgs->xmaSpecs[pArgs->numXmaSpecs++] = spec;
+
+        if (*s == '\0') {
+            return 0;
+        } else if (*s++ != ',') {
+            return -1;
+        }
+    }
+}
+
 static int parseArgs(int argc, char **argv, CmdArgs *pArgs)
 {
-    int numArgs, n;
+    int numArgs, n, x;
 
     if (argc < 2) {
         fprintf(stderr, "Invalid syntax.  Use 'gpxFileTool --help' for more information.\n");
@@ -192,7 +297,6 @@ static int parseArgs(int argc, char **argv, CmdArgs *pArgs)
 
     // By default run the SMA over the elevation value
     pArgs->xmaMethod = simple;
-    pArgs->xmaMetric = elevation;
 
     // By default no max/min grade limits
     pArgs->maxGrade = nilGrade;
@@ -201,6 +305,15 @@ static int parseArgs(int argc, char **argv, CmdArgs *pArgs)
     // By default display metric units
     pArgs->units = metric;
 
+    // By default use one thread per CPU
+#ifdef _MSC_FULL_VER
+    pArgs->numThreads = 1;
+#else
+    if ((pArgs->numThreads = (int) sysconf(_SC_NPROCESSORS_ONLN)) < 1) {
+        pArgs->numThreads = 1;
+    }
+#endif  // _MSC_FULL_VER
+
     for (n = 1, numArgs = argc -1; n <= numArgs; n++) {
         const char *arg;
         const char *val;
@@ -256,6 +369,8 @@ static int parseArgs(int argc, char **argv, CmdArgs *pArgs)
                 invalidArgument(arg, val);
                 return -1;
             }
+        } else if (strcmp(arg, "--fused") == 0) {
+            pArgs->fused = true;
         } else if (strcmp(arg, "--max-grade") == 0) {
             val = argv[++n];
             if ((sscanf(val, "%le", &pArgs->maxGrade) != 1) ||
@@ -336,6 +451,24 @@ static int parseArgs(int argc, char **argv, CmdArgs *pArgs)
                 fprintf(stderr, "Invalid TrkPt range %d,%d\n", pArgs->rangeFrom, pArgs->rangeTo);
                 return -1;
             }
+            pArgs->rangeUnits = byIndex;
+        } else if ((strcmp(arg, "--range-dist") == 0) || (strcmp(arg, "--range-time") == 0)) {
+            val = argv[++n];
+            if (sscanf(val, "%le,%le", &pArgs->rangeStart, &pArgs->rangeEnd) != 2) {
+                invalidArgument(arg, val);
+                return -1;
+            }
+            if ((pArgs->rangeStart < 0.0) || (pArgs->rangeStart >= pArgs->rangeEnd)) {
+                fprintf(stderr, "Invalid TrkPt range %s\n", val);
+                return -1;
+            }
+            if (strcmp(arg, "--range-dist") == 0) {
+                pArgs->rangeUnits = byDist;
+                pArgs->rangeStart = kmToM(pArgs->rangeStart);
+                pArgs->rangeEnd = kmToM(pArgs->rangeEnd);
+            } else {
+                pArgs->rangeUnits = byTime;
+            }
         } else if (strcmp(arg, "--set-speed") == 0) {
             val = argv[++n];
             if (sscanf(val, "%le", &pArgs->setSpeed) != 1) {
@@ -345,19 +478,30 @@ static int parseArgs(int argc, char **argv, CmdArgs *pArgs)
             pArgs->setSpeed = (pArgs->setSpeed / 3.6);  // convert from km/h to m/s
         } else if (strcmp(arg, "--start-time") == 0) {
             val = argv[++n];
-            struct tm brkDwnTime = {0};
-            time_t time0;
+            double time0;
             if (strcmp(val, "now") == 0) {
-                time0 = time(NULL);
-            } else if (strptime(val, "%Y-%m-%dT%H:%M:%S", &brkDwnTime) != NULL) {
-                time0 = mktime(&brkDwnTime);
+                time0 = (double) time(NULL);
             } else {
-                invalidArgument(arg, val);
-                return -1;
+                const char *end = val + strlen(val);
+                const char *p;
+                double offset;
+                if (((p = parseIsoTime(val, end, NULL, &time0)) == NULL) ||
+                    ((p = parseIsoZone(p, end, &offset)) != end)) {
+                    invalidArgument(arg, val);
+                    return -1;
+                }
+                time0 -= offset;    // convert to UTC
             }
-            pArgs->startTime = (double) time0;
+            pArgs->startTime = time0;
         } else if (strcmp(arg, "--summary") == 0) {
             pArgs->summary = true;
+        } else if (strcmp(arg, "--threads") == 0) {
+            val = argv[++n];
+            if ((sscanf(val, "%d", &pArgs->numThreads) != 1) ||
+                (pArgs->numThreads < 1)) {
+                invalidArgument(arg, val);
+                return -1;
+            }
         } else if (strcmp(arg, "--trim") == 0) {
             val = argv[++n];
             if (sscanf(val, "%d,%d", &pArgs->trimFrom, &pArgs->trimTo) != 2) {
@@ -368,6 +512,24 @@ static int parseArgs(int argc, char **argv, CmdArgs *pArgs)
                 fprintf(stderr, "Invalid TrkPt range %d,%d\n", pArgs->trimFrom, pArgs->trimTo);
                 return -1;
             }
+            pArgs->trimUnits = byIndex;
+        } else if ((strcmp(arg, "--trim-dist") == 0) || (strcmp(arg, "--trim-time") == 0)) {
+            val = argv[++n];
+            if (sscanf(val, "%le,%le", &pArgs->trimStart, &pArgs->trimEnd) != 2) {
+                invalidArgument(arg, val);
+                return -1;
+            }
+            if ((pArgs->trimStart < 0.0) || (pArgs->trimStart >= pArgs->trimEnd)) {
+                fprintf(stderr, "Invalid TrkPt range %s\n", val);
+                return -1;
+            }
+            if (strcmp(arg, "--trim-dist") == 0) {
+                pArgs->trimUnits = byDist;
+                pArgs->trimStart = kmToM(pArgs->trimStart);
+                pArgs->trimEnd = kmToM(pArgs->trimEnd);
+            } else {
+                pArgs->trimUnits = byTime;
+            }
         } else if (strcmp(arg, "--verbatim") == 0) {
             pArgs->verbatim = true;
         } else if (strcmp(arg, "--version") == 0) {
@@ -385,22 +547,14 @@ static int parseArgs(int argc, char **argv, CmdArgs *pArgs)
             }
         } else if (strcmp(arg, "--xma-metric") == 0) {
             val = argv[++n];
-            if (strcmp(val, "elevation") == 0) {
-                pArgs->xmaMetric = elevation;
-            } else if (strcmp(val, "grade") == 0) {
-                pArgs->xmaMetric = grade;
-            } else if (strcmp(val, "power") == 0) {
-                pArgs->xmaMetric = power;
-            } else if (strcmp(val, "speed") == 0) {
-                pArgs->xmaMetric = speed;
-            } else {
+            if (parseXmaSpecs(val, pArgs) != 0) {
                 invalidArgument(arg, val);
                 return -1;
             }
         } else if (strcmp(arg, "--xma-window") == 0) {
             val = argv[++n];
             if ((sscanf(val, "%d", &pArgs->xmaWindow) != 1) ||
-                ((pArgs->xmaWindow % 2) == 0)) {
+                !isValidXmaWindow(pArgs->xmaWindow)) {
                 invalidArgument(arg, val);
                 return -1;
             }
@@ -413,155 +567,197 @@ static int parseArgs(int argc, char **argv, CmdArgs *pArgs)
         }
     }
 
+    if (pArgs->numXmaSpecs == 0) {
+        pArgs->xmaSpecs[pArgs->numXmaSpecs++].xmaMetric = elevation;
+    }
+
+    // Metrics that don't specify their own window size
+    // or method use the ones given by --xma-window and
+    // --xma-method.
+    for (x = 0; x < pArgs->numXmaSpecs; x++) {
+        XmaSpec *pSpec = &pArgs->xmaSpecs[x];
+        if (pSpec->xmaWindow == 0) {
+            pSpec->xmaWindow = pArgs->xmaWindow;
+        }
+        if (pSpec->xmaMethod == 0) {
+            pSpec->xmaMethod = pArgs->xmaMethod;
+        }
+    }
+
     pArgs->argc = argc;
     pArgs->argv = argv;
 
     return n;
 }
 
-static TrkPt *trimTrkPts(GpsTrk *pTrk, CmdArgs *pArgs)
+// Mark the TrkPt's in the specified trim range for deletion.
+// Returns the position of the first TrkPt after the range, or
+// -1 if there is nothing to trim, along with the time and the
+// distance trimmed out.
+static int markTrimTrkPts(GpsTrk *pTrk, CmdArgs *pArgs, double *pTrimmedTime, double *pTrimmedDistance)
 {
-    TrkPt *p = TAILQ_FIRST(&pTrk->trkPtList);
-    Bool discTrkPt = false;
-    Bool trimTrkPts = false;
+    TrkPts *pts = &pTrk->trkPts;
+    int p;
+    int p0;
+    int numTrimPts;
     double trimmedTime = 0.0;
     double trimmedDistance = 0.0;
-    TrkPt *p0 = NULL;
 
-    // Discard any points in the specified trim range
-    while (p != NULL) {
-        discTrkPt = false;
+    // Find the points in the specified trim range
+    if ((p0 = trkPtPos(pTrk, pArgs->trimFrom)) == -1) {
+        return -1;
+    }
+
+    // Start trimming
+    if (!pArgs->quiet) {
+        fprintf(stderr, "INFO: start trimming at TrkPt #%d (%s)\n", pts->index[p0], fmtTrkPtIdx(pTrk, p0));
+    }
+
+    // Notice that when the range was specified by index,
+    // --trim a,a trims all the way to the end of the track.
+    p = trkPtPos(pTrk, pArgs->trimTo);
+    if ((p > p0) || ((p == p0) && (pArgs->trimUnits != byIndex))) {
+        // Stop trimming
+        if (!pArgs->quiet) {
+            fprintf(stderr, "INFO: stop trimming at TrkPt #%d (%s)\n", pts->index[p], fmtTrkPtIdx(pTrk, p));
+        }
+        numTrimPts = (p - p0) + 1;
+        trimmedTime = timeToSec(pts->timestamp[p]) - timeToSec(pts->timestamp[p0]);   // total time trimmed out
+        trimmedDistance = pts->distance[p] - pts->distance[p0];   // total distance trimmed out
+    } else {
+        // Trim all the way to the end of the track
+        numTrimPts = pts->count - p0;
+    }
+
+    // Discard all the points in the range at once
+    pTrk->numTrimTrkPts += numTrimPts;
+    delTrkPts(pTrk, p0, numTrimPts);
+
+    *pTrimmedTime = trimmedTime;
+    *pTrimmedDistance = trimmedDistance;
+
+    return (p0 + numTrimPts);
+}
+
+static void trimTrkPts(GpsTrk *pTrk, CmdArgs *pArgs)
+{
+    TrkPts *pts = &pTrk->trkPts;
+    int p;
+    double trimmedTime;
+    double trimmedDistance;
+
+    if ((p = markTrimTrkPts(pTrk, pArgs, &trimmedTime, &trimmedDistance)) == -1) {
+        return;
+    }
+
+    // Now adjust the timestamp and distance values of
+    // the remaining TrkPt's so as to "close the gap".
+    while (p < pts->count) {
+        pts->timestamp[p] -= secToTime(trimmedTime);
+        pts->distance[p] -= trimmedDistance;
+        p++;
+    }
+}
+
+// Run some consistency checks on the given TrkPt, against
+// the previous one. Returns 1 if the TrkPt is to be discarded,
+// 0 if not, or -1 if the TrkPt can't be used at all.
+static int checkTrkPt(GpsTrk *pTrk, CmdArgs *pArgs, int p1, int p2)
+{
+    TrkPts *pts = &pTrk->trkPts;
+    Bool discTrkPt = false;
+
+    // Without elevation data, there isn't much we can do!
+    if (pts->elevation[p2] == nilElev) {
+        fprintf(stderr, "ERROR: TrkPt #%d (%s) is missing its elevation data !\n", pts->index[p2], fmtTrkPtIdx(pTrk, p2));
+        return -1;
+    }
+
+    // The only case when we allow TrkPt's without a
+    // timestamp is when we are processing a "route"
+    // file, to convert it into a "ride" file, in
+    // which case a desired average speed should have
+    // been specified, in order to compute the timing
+    // data from this speed and the distance...
+    if ((pts->timestamp[p2] == 0) && (pArgs->setSpeed == 0.0)) {
+        fprintf(stderr, "ERROR: TrkPt #%d (%s) is missing its date/time data !\n", pts->index[p2], fmtTrkPtIdx(pTrk, p2));
+        return -1;
+    }
 
-        // Do we need to trim out this TrkPt?
-        if (p->index == pArgs->trimFrom) {
-            // Start trimming
+    // Unless the user requested to process the file
+    // verbatim, let's do some checks and clean up...
+    if (!pArgs->verbatim) {
+        // Some GPX tracks may have duplicate TrkPt's. This
+        // can happen when the file has multiple laps, and
+        // the last point in lap N is the same as the first
+        // point in lap N+1.
+        if ((pts->latitude[p2] == pts->latitude[p1]) &&
+            (pts->longitude[p2] == pts->longitude[p1]) &&
+            (pts->elevation[p2] == pts->elevation[p1])) {
             if (!pArgs->quiet) {
-                fprintf(stderr, "INFO: start trimming at TrkPt #%d (%s)\n", p->index, fmtTrkPtIdx(p));
+                fprintf(stderr, "INFO: Discarding duplicate TrkPt #%d (%s) !\n", pts->index[p2], fmtTrkPtIdx(pTrk, p2));
             }
-            trimTrkPts = true;
-            pTrk->numTrimTrkPts++;
+            pTrk->numDupTrkPts++;
             discTrkPt = true;
-            p0 = p; // set baseline
-        } else if (p->index == pArgs->trimTo) {
-            // Stop trimming
+        }
+
+        // Timestamps should increase monotonically
+        if ((pts->timestamp[p2] != 0) && (pts->timestamp[p2] <= pts->timestamp[p1])) {
             if (!pArgs->quiet) {
-                fprintf(stderr, "INFO: stop trimming at TrkPt #%d (%s)\n", p->index, fmtTrkPtIdx(p));
+                fprintf(stderr, "INFO: TrkPt #%d (%s) has a non-increasing timestamp value: %.3lf !\n",
+                        pts->index[p2], fmtTrkPtIdx(pTrk, p2), timeToSec(pts->timestamp[p2]));
             }
-            trimTrkPts = false;
-            trimmedTime = p->timestamp - p0->timestamp;     // total time trimmed out
-            trimmedDistance = p->distance - p0->distance;   // total distance trimmed out
-            pTrk->numTrimTrkPts++;
-            discTrkPt = true;
-        } else if (trimTrkPts) {
-            // Trim this point
-            pTrk->numTrimTrkPts++;
+
+            // Discard as a dummy
+            pTrk->numDiscTrkPts++;
             discTrkPt = true;
         }
 
-        // Discard?
-        if (discTrkPt) {
-            // Remove this TrkPt from the list
-            p = remTrkPt(pTrk, p);
-        } else {
-            // If we trimmed out some previous TrkPt's, then we
-            // need to adjust the timestamp and distance values
-            // of this TrkPt so as to "close the gap".
-            if (p0 != NULL) {
-                p->timestamp -= trimmedTime;
-                p->distance -= trimmedDistance;
+        // Distance should increase monotonically
+        if ((pts->distance[p2] != 0) && (pts->distance[p2] <= pts->distance[p1])) {
+            if (!pArgs->quiet) {
+                fprintf(stderr, "INFO: TrkPt #%d (%s) has a non-increasing distance value: %.3lf !\n",
+                        pts->index[p2], fmtTrkPtIdx(pTrk, p2), pts->distance[p2]);
             }
-            p = nxtTrkPt(NULL, p);
+
+            // Discard as a dummy
+            pTrk->numDiscTrkPts++;
+            discTrkPt = true;
         }
     }
 
-    return TAILQ_FIRST(&pTrk->trkPtList);
+    return discTrkPt ? 1 : 0;
 }
 
 static int checkTrkPts(GpsTrk *pTrk, CmdArgs *pArgs)
 {
-    TrkPt *p1 = TAILQ_FIRST(&pTrk->trkPtList);  // previous TrkPt
-    TrkPt *p2 = TAILQ_NEXT(p1, tqEntry);    // current TrkPt
-    Bool discTrkPt = false;
+    TrkPts *pts = &pTrk->trkPts;
+    int p1 = 0;     // previous TrkPt
+    int p2 = 1;     // current TrkPt
+    int discTrkPt;
     double trimmedTime = 0.0;
     double trimmedDistance = 0.0;
-    TrkPt *p0 = NULL;
-
-    while (p2 != NULL) {
-        // Discard any duplicate points...
-        discTrkPt = false;
-
-        // Without elevation data, there isn't much we can do!
-        if (p2->elevation == nilElev) {
-            fprintf(stderr, "ERROR: TrkPt #%d (%s) is missing its elevation data !\n", p2->index, fmtTrkPtIdx(p2));
-            return -1;
-        }
+    int p0 = -1;
 
-        // The only case when we allow TrkPt's without a
-        // timestamp is when we are processing a "route"
-        // file, to convert it into a "ride" file, in
-        // which case a desired average speed should have
-        // been specified, in order to compute the timing
-        // data from this speed and the distance...
-        if ((p2->timestamp == 0.0) && (pArgs->setSpeed == 0.0)) {
-            fprintf(stderr, "ERROR: TrkPt #%d (%s) is missing its date/time data !\n", p2->index, fmtTrkPtIdx(p2));
+    while (p2 < pts->count) {
+        if ((discTrkPt = checkTrkPt(pTrk, pArgs, p1, p2)) < 0) {
             return -1;
         }
 
-        // Unless the user requested to process the file
-        // verbatim, let's do some checks and clean up...
-        if (!pArgs->verbatim) {
-            // Some GPX tracks may have duplicate TrkPt's. This
-            // can happen when the file has multiple laps, and
-            // the last point in lap N is the same as the first
-            // point in lap N+1.
-            if ((p2->latitude == p1->latitude) &&
-                (p2->longitude == p1->longitude) &&
-                (p2->elevation == p1->elevation)) {
-                if (!pArgs->quiet) {
-                    fprintf(stderr, "INFO: Discarding duplicate TrkPt #%d (%s) !\n", p2->index, fmtTrkPtIdx(p2));
-                }
-                pTrk->numDupTrkPts++;
-                discTrkPt = true;
-            }
-
-            // Timestamps should increase monotonically
-            if ((p2->timestamp != 0.0) && (p2->timestamp <= p1->timestamp)) {
-                if (!pArgs->quiet) {
-                    fprintf(stderr, "INFO: TrkPt #%d (%s) has a non-increasing timestamp value: %.3lf !\n",
-                            p2->index, fmtTrkPtIdx(p2), p2->timestamp);
-                }
-
-                // Discard as a dummy
-                pTrk->numDiscTrkPts++;
-                discTrkPt = true;
-            }
-
-            // Distance should increase monotonically
-            if ((p2->distance != 0) && (p2->distance <= p1->distance)) {
-                if (!pArgs->quiet) {
-                    fprintf(stderr, "INFO: TrkPt #%d (%s) has a non-increasing distance value: %.3lf !\n",
-                            p2->index, fmtTrkPtIdx(p2), p2->distance);
-                }
-
-                // Discard as a dummy
-                pTrk->numDiscTrkPts++;
-                discTrkPt = true;
-            }
-        }
-
         // Discard?
         if (discTrkPt) {
-            // Remove this TrkPt from the list
-            p2 = remTrkPt(pTrk, p2);
+            // Mark this TrkPt for deletion
+            delTrkPt(pTrk, p2);
+            p2++;
         } else {
             // If we trimmed out some previous TrkPt's, then we
             // need to adjust the timestamp and distance values
             // of this TrkPt so as to "close the gap".
-            if (p0 != NULL) {
-                p2->timestamp -= trimmedTime;
-                p2->distance -= trimmedDistance;
+            if (p0 != -1) {
+                pts->timestamp[p2] -= secToTime(trimmedTime);
+                pts->distance[p2] -= trimmedDistance;
             }
-            p2 = nxtTrkPt(&p1, p2);
+            p1 = p2++;
         }
     }
 
@@ -570,452 +766,1365 @@ static int checkTrkPts(GpsTrk *pTrk, CmdArgs *pArgs)
 
 static int closeTimeGap(GpsTrk *pTrk, CmdArgs *pArgs)
 {
-    TrkPt *p1 = TAILQ_FIRST(&pTrk->trkPtList);  // previous TrkPt
-    TrkPt *p2 = TAILQ_NEXT(p1, tqEntry);    // current TrkPt
-    Bool trkPtFound = false;
-    double timeGap = 0.0;
-
-    while (p2 != NULL) {
-        if (!trkPtFound && (p2->index == pArgs->closeGap)) {
-            timeGap = p2->timestamp - p1->timestamp - 1;
-            trkPtFound = true;
-            if (!pArgs->quiet) {
-                fprintf(stderr, "INFO: Closing %.3lf s time gap at TrkPt #%u\n", timeGap, p2->index);
-            }
-        }
+    TrkPts *pts = &pTrk->trkPts;
+    int p2;         // current TrkPt
+    double timeGap;
 
-        if (trkPtFound) {
-            p2->timestamp -= timeGap;
-        }
+    if ((p2 = trkPtPos(pTrk, pArgs->closeGap)) < 1) {
+        // Not found, or it is the first TrkPt
+        return 0;
+    }
+
+    timeGap = timeToSec(pts->timestamp[p2]) - timeToSec(pts->timestamp[p2 - 1]) - 1;
+    if (!pArgs->quiet) {
+        fprintf(stderr, "INFO: Closing %.3lf s time gap at TrkPt #%u\n", timeGap, pts->index[p2]);
+    }
 
-        p2 = nxtTrkPt(&p1, p2);
+    while (p2 < pts->count) {
+        pts->timestamp[p2++] -= secToTime(timeGap);
     }
 
     return 0;
 }
 
-static Bool pointWithinRange(const CmdArgs *pArgs, const TrkPt *p)
+// Get the positions of the first TrkPt, and one past the last
+// TrkPt, in the range specified by the user. Notice that the
+// first TrkPt of the track is never included, as there is no
+// previous TrkPt to compute its metrics from.
+static void getTrkPtRange(const GpsTrk *pTrk, const CmdArgs *pArgs, int *pStart, int *pEnd)
 {
-    if (pArgs->rangeFrom == 0) {
-        // No actual range specified, so all points
-        // are within range...
-        return true;
-    }
+    int start = 1;
+    int end = pTrk->trkPts.count;
+
+    if (pArgs->rangeFrom != 0) {
+        int from = pArgs->rangeFrom;
+        int to = (pArgs->rangeTo < pTrk->trkPts.numPos) ? pArgs->rangeTo : (pTrk->trkPts.numPos - 1);
+
+        // The TrkPt's at either end of the range may have
+        // been discarded, so look for the closest ones that
+        // are still in the track...
+        while ((from <= to) && (trkPtPos(pTrk, from) == -1)) {
+            from++;
+        }
+        while ((to >= from) && (trkPtPos(pTrk, to) == -1)) {
+            to--;
+        }
 
-    if ((p->index >= pArgs->rangeFrom) && (p->index <= pArgs->rangeTo)) {
-        // Point is within specified range
-        return true;
+        if (from <= to) {
+            start = trkPtPos(pTrk, from);
+            start = (start < 1) ? 1 : start;
+            end = trkPtPos(pTrk, to) + 1;
+        } else {
+            start = end = 0;    // empty range
+        }
     }
 
-    return false;
+    *pStart = start;
+    *pEnd = end;
 }
 
-static double xmaGetVal(const TrkPt *p, XmaMetric xmaMetric)
+static double xmaGetVal(const TrkPts *pts, int p, XmaMetric xmaMetric)
 {
     if (xmaMetric == elevation) {
-        return (double) p->elevation;
+        return (double) pts->elevation[p];
     } else if (xmaMetric == grade) {
-        return (double) p->grade;
+        return (double) pts->grade[p];
     } else if (xmaMetric == power) {
-        return (double) p->power;
+        return (double) pts->power[p];
     } else {
-        return p->speed;
+        return pts->speed[p];
     }
 }
 
-static Bool xmaSetVal(TrkPt *p, XmaMetric xmaMetric, double value)
+static Bool xmaSetVal(TrkPts *pts, int p, XmaMetric xmaMetric, double value)
 {
     double oldVal;
 
     if (xmaMetric == elevation) {
-        oldVal = p->elevation;
-        p->elevation = value;
+        oldVal = pts->elevation[p];
+        pts->elevation[p] = value;
     } else if (xmaMetric == grade) {
-        oldVal = p->grade;
-        p->grade = value;
+        oldVal = pts->grade[p];
+        pts->grade[p] = value;
     } else if (xmaMetric == power) {
-        oldVal = p->power;
-        p->power = (int) value;
+        oldVal = pts->power[p];
+        pts->power[p] = (int) value;
     } else {
-        oldVal = p->speed;
-        p->speed = value;
+        oldVal = pts->speed[p];
+        pts->speed[p] = value;
     }
 
     return (value != oldVal) ? true : false;
 }
 
-// Compute the Moving Average (SMA/WMA) of the specified
-// metric at the given point, using a window size of N
-// points, where N is an odd value. The average is computed
-// using the (N-1)/2 values before the point, the given point,
-// and the (N-1)/2 values after the point.
-static void compMovAvg(GpsTrk *pTrk, TrkPt *p, XmaMethod xmaMethod, XmaMetric xmaMetric, int xmaWindow)
+// Override the original value of the metric with the
+// computed SMA/WMA value.
+static void xmaUpdTrkPt(TrkPts *pts, int p, XmaMetric xmaMetric, double value)
 {
-    int i;
-    int n = (xmaWindow - 1) / 2;    // number of points to the L/R of the given point
-    int weight = 1; // SMA
-    int denom = 0;
-    double summ = 0.0;
-    double xmaVal;
-    TrkPt *tp;
-    Bool valAdj;
-
-    // Points before the given point
-    for (i = 0, tp = TAILQ_PREV(p, TrkPtList, tqEntry); (i < n) && (tp != NULL); i++, tp = TAILQ_PREV(tp, TrkPtList, tqEntry)) {
-        if (xmaMethod == weighed)
-            weight = (n - i);
-        summ += (xmaGetVal(tp, xmaMetric) * weight);
-        denom += weight;
-    }
-
-    // The given point
-    if (xmaMethod == weighed)
-        weight = (n + 1);
-    summ += (xmaGetVal(p, xmaMetric) * weight);
-    denom += weight;
-
-    // Points after the given point
-    for (i = 0, tp = TAILQ_NEXT(p, tqEntry); (i < n) && (tp != NULL); i++, tp = TAILQ_NEXT(tp, tqEntry)) {
-        if (xmaMethod == weighed)
-            weight = (n - i);
-        summ += (xmaGetVal(tp, xmaMetric) * weight);
-        denom += weight;
-    }
-
-    // SMA/WMA value
-    xmaVal = summ / denom;
-
-    //fprintf(stderr, "%s: index=%d metric=%d before=%.3lf summ=%.3lf pts=%d after=%.3lf\n", __func__, p->index, xmaMetric, xmaGetVal(p, xmaMetric), summ, denom, xmaVal);
-
-    // Override the original value with the
-    // computed SMA/WMA value.
-    valAdj = xmaSetVal(p, xmaMetric, xmaVal);
-
-    if (valAdj && (xmaMetric == grade)) {
+    if (xmaSetVal(pts, p, xmaMetric, value) && (xmaMetric == grade)) {
         // Flag that this point had its grade adjusted
-        p->adjGrade = true;
+        pts->flags[p] |= TP_ADJ_GRADE;
     }
 }
 
-static int smoothMetric(GpsTrk *pTrk, CmdArgs *pArgs)
+// Add a value to a running sum, keeping track of the rounding
+// error of the addition (Knuth's TwoSum), so that the values
+// that are later subtracted from the sum cancel out exactly.
+static __inline__ void addToSum(double *pSum, double *pErr, double val)
 {
-    TrkPt *p1 = TAILQ_FIRST(&pTrk->trkPtList);  // previous TrkPt
-    TrkPt *p2 = TAILQ_NEXT(p1, tqEntry);    // current TrkPt
+    double sum = *pSum + val;
+    double tmp = sum - *pSum;
 
-    while (p2 != NULL) {
-        if (pointWithinRange(pArgs, p2)) {
-            compMovAvg(pTrk, p2, pArgs->xmaMethod, pArgs->xmaMetric, pArgs->xmaWindow);
-        }
+    *pErr += (*pSum - (sum - tmp)) + (val - tmp);
+    *pSum = sum;
+}
+
+// Compute the sums of all the windows of the given width
+// over the given values: sums[i] = vals[i] + ... + vals[i+width-1]
+// for i in [0, numVals-width].
+static void compBoxSums(const double *vals, int numVals, int width, double *sums)
+{
+    double sum = 0.0;
+    double err = 0.0;
+    int i;
 
-        p2 = nxtTrkPt(&p1, p2);
+    for (i = 0; i < width; i++) {
+        addToSum(&sum, &err, vals[i]);
     }
+    sums[0] = sum + err;
 
-    return 0;
+    for (i = 1; i <= (numVals - width); i++) {
+        addToSum(&sum, &err, vals[i + width - 1]);
+        addToSum(&sum, &err, -vals[i - 1]);
+        sums[i] = sum + err;
+    }
 }
 
-// Compute the great-circle distance (in meters) between two
-// track points using the Haversine formula. See below for
-// the details:
-//
-//   https://en.wikipedia.org/wiki/Haversine_formula
+// Number of TrkPt's in each tile of the SMA/WMA computation
+#define XMA_TILE_SIZE   65536
+
+// The SMA/WMA values are computed in tiles of XMA_TILE_SIZE
+// points, each with its own running sums, so the tiles can be
+// handed out to multiple threads. The tiles are the same no
+// matter how many threads are used, so the results are always
+// the same as well. All the metrics being smoothed out are
+// computed together, one tile at a time, so the whole range
+// is only swept once.
+typedef struct XmaTileQueue {
+    const TrkPts *pts;      // track being smoothed
+    const XmaSpec *specs;   // metrics being smoothed
+    int numSpecs;           // number of metrics being smoothed
+    int maxWindow;          // largest window size
+    int start;              // start of the range
+    int end;                // end of the range
+    double *outVals;        // SMA/WMA values of the points in [start, end), per metric
+    int numTiles;           // number of tiles
+    int nextTile;           // next tile to be picked up
+    int status;             // set to -1 if any tile fails
+} XmaTileQueue;
+
+// Compute the Moving Average (SMA/WMA) of the specified
+// metric over the points in [start, end) of a track of numPts
+// points, using a window size of N points, where N is an odd
+// value. The average at each point is computed using the
+// (N-1)/2 values before the point, the point itself, and the
+// (N-1)/2 values after the point. The WMA weights decrease
+// linearly with the distance to the point: (N+1)/2 for the
+// point itself, down to 1 for the values at the edges of the
+// window.
 //
-static double compDistance(const TrkPt *p1, const TrkPt *p2)
+// All the averages are computed from a copy of the original
+// values of the points in [start-n, end+n), including the
+// (N-1)/2 "halo" values on each side of the tile, so smoothing
+// a point doesn't affect the windows of the points that
+// follow. The window sums are running sums, so the cost is
+// O(N) regardless of the window size: the SMA uses a box
+// window of N points, and the WMA (triangular) window is
+// computed as a box window of (N+1)/2 points over the sums
+// of a box window of (N+1)/2 points.
+static void compMovAvgVals(const XmaSpec *pSpec, const double *inVals, int start, int end, int numPts, double *tmpVals, double *outVals)
 {
-    const double two = (double) 2.0;
-    double phi1 = p1->latitude * degToRad;  // p1's latitude in radians
-    double phi2 = p2->latitude * degToRad;  // p2's latitude in radians
-    double deltaPhi = (phi2 - phi1);        // latitude diff in radians
-    double deltaLambda = (p2->longitude - p1->longitude) * degToRad;   // longitude diff in radians
-    double a = sin(deltaPhi / two);
-    double b = sin(deltaLambda / two);
-    double h = (a * a) + cos(phi1) * cos(phi2) * (b * b);
+    int n = (pSpec->xmaWindow - 1) / 2;     // number of points to the L/R of the given point
+    int numVals = (end - start) + (2 * n);  // number of points in [start-n, end+n)
+    int p;
 
-    assert(h >= 0.0);
+    if (pSpec->xmaMethod == weighed) {
+        compBoxSums(inVals, numVals, (n + 1), tmpVals);
+        compBoxSums(tmpVals, (numVals - n), (n + 1), outVals);
+    } else {
+        compBoxSums(inVals, numVals, pSpec->xmaWindow, outVals);
+    }
 
-    return (two * earthMeanRadius * asin(sqrt(h)));
+    for (p = start; p < end; p++) {
+        int numL = (p < n) ? p : n;     // number of points to the left of p
+        int numR = ((numPts - 1 - p) < n) ? (numPts - 1 - p) : n;  // number of points to the right of p
+        double denom;
+
+        if (pSpec->xmaMethod == weighed) {
+            // The full window has a total weight of (n+1)^2,
+            // minus that of the points that fall outside the
+            // track on each side. It doesn't fit in an int
+            // for the larger windows.
+            double numOutL = n - numL;
+            double numOutR = n - numR;
+            denom = ((n + 1.0) * (n + 1.0)) - ((numOutL * (numOutL + 1.0)) / 2.0) - ((numOutR * (numOutR + 1.0)) / 2.0);
+        } else {
+            denom = numL + numR + 1;
+        }
+
+        outVals[p - start] /= denom;
+    }
 }
 
-// Compute the bearing (in decimal degrees) between two track
-// points.  See below for the details:
-//
-//   https://www.movable-type.co.uk/scripts/latlong.html
-//
-static double compBearing(const TrkPt *p1, const TrkPt *p2)
+static void compMovAvgTile(const XmaTileQueue *pQueue, const XmaSpec *pSpec, double *outVals, int start, int end, double *inVals, double *tmpVals)
 {
-    double phi1 = p1->latitude * degToRad;  // p1's latitude in radians
-    double phi2 = p2->latitude * degToRad;  // p2's latitude in radians
-    double deltaLambda = (p2->longitude - p1->longitude) * degToRad;   // longitude diff in radians
-    double x = sin(deltaLambda) * cos(phi2);
-    double y = cos(phi1) * sin(phi2) - sin(phi1) * cos(phi2) * cos(deltaLambda);
-    double theta = atan2(x, y);  // in radians
+    const TrkPts *pts = pQueue->pts;
+    int n = (pSpec->xmaWindow - 1) / 2;     // number of points to the L/R of the given point
+    int tp;
+
+    // Values outside the track count as zero; they are
+    // also left out of the denominator.
+    for (tp = (start - n); tp < (end + n); tp++) {
+        inVals[tp - (start - n)] = ((tp >= 0) && (tp < pts->count)) ? xmaGetVal(pts, tp, pSpec->xmaMetric) : 0.0;
+    }
 
-    return fmod((theta / degToRad + 360.0), 360.0); // in degrees decimal (0-359.99)
+    compMovAvgVals(pSpec, inVals, start, end, pts->count, tmpVals, (outVals + (start - pQueue->start)));
 }
 
-static int compMetrics(GpsTrk *pTrk, CmdArgs *pArgs)
+static void *xmaWorker(void *arg)
 {
-    TrkPt *p1 = TAILQ_FIRST(&pTrk->trkPtList);  // previous TrkPt
-    TrkPt *p2 = TAILQ_NEXT(p1, tqEntry);    // current TrkPt
+    XmaTileQueue *pQueue = arg;
+    int numVals = XMA_TILE_SIZE + pQueue->maxWindow - 1;
+    double *inVals;     // values of the points in the tile, plus the halos
+    int t, s;
+
+    if ((inVals = malloc(2 * numVals * sizeof (double))) == NULL) {
+        fprintf(stderr, "Failed to alloc SMA/WMA buffers !!!\n");
+        pQueue->status = -1;
+        return NULL;
+    }
 
-    // Compute the distance, elevation diff, speed, and grade
-    // between each pair of points...
-    while (p2 != NULL) {
-        double absRise; // always positive!
-
-        // Compute the elevation difference (can be negative)
-        p2->rise = p2->elevation - p1->elevation;
-
-        // The "rise" is always positive!
-        absRise = fabs(p2->rise);
-
-        // FIT/TCX files include the "distance" metric which
-        // is the distance (in meters) from the start up to
-        // the given point. For GPX files, we need to compute
-        // the distance between consecutive points using the
-        // GPS data.
-        if (p2->distance != 0.0) {
-            if ((p2->dist = p2->distance - p1->distance) == 0.0) {
-                // Stopped?
-                if (!pArgs->verbatim) {
-                    if (!pArgs->quiet) {
-                        fprintf(stderr, "WARNING: TrkPt #%d (%s) has a null distance value !\n",
-                                p2->index, fmtTrkPtIdx(p2));
-                        printTrkPt(p2);
-                    }
-
-                    // Skip and delete this TrkPt
-                    p2 = remTrkPt(pTrk, p2);
-                    pTrk->numDiscTrkPts++;
-                } else {
-                    // Carry over the data from the previous point
-                    p2->bearing = p1->bearing;
-                    p2->distance = p1->distance;
-                    p2->grade = p1->grade;
-                    p2->speed = p1->speed;
-
-                    // Move on to the next point
-                    p2 = nxtTrkPt(&p1, p2);
-                }
-                continue;
-            }
+#ifdef _MSC_FULL_VER
+    for (t = 0; t < pQueue->numTiles; t++) {
+#else
+    while ((t = __sync_fetch_and_add(&pQueue->nextTile, 1)) < pQueue->numTiles) {
+#endif  // _MSC_FULL_VER
+        int start = pQueue->start + (t * XMA_TILE_SIZE);
+        int end = ((pQueue->end - start) > XMA_TILE_SIZE) ? (start + XMA_TILE_SIZE) : pQueue->end;
+        for (s = 0; s < pQueue->numSpecs; s++) {
+            double *outVals = pQueue->outVals + (s * (pQueue->end - pQueue->start));
+            compMovAvgTile(pQueue, &pQueue->specs[s], outVals, start, end, inVals, (inVals + numVals));
+        }
+    }
 
-            if (p2->dist > absRise) {
-                // Compute the horizontal distance "run" using
-                // Pythagoras's Theorem.
-                p2->run = sqrt((p2->dist * p2->dist) - (absRise * absRise));
-            } else {
-                // Bogus data?
-                if (!pArgs->quiet) {
-                    fprintf(stderr, "WARNING: TrkPt #%d (%s) has inconsistent dist=%.3lf and rise=%.3lf values !\n",
-                            p2->index, fmtTrkPtIdx(p2), p2->dist, absRise);
-                    printTrkPt(p2);
-                }
-                p2->run = p2->dist; // assume a null grade
-            }
-        } else {
-            // Compute the horizontal distance "run" between
-            // the two points, based on their latitude and
-            // longitude values.
-            if ((p2->run = compDistance(p1, p2)) == 0.0) {
-                // Stopped?
-                if (!pArgs->verbatim) {
-                    if (!pArgs->quiet) {
-                        fprintf(stderr, "WARNING: TrkPt #%d (%s) has a null run value !\n",
-                                p2->index, fmtTrkPtIdx(p2));
-                        printTrkPt(p2);
-                    }
-
-                    // Skip and delete this TrkPt
-                    p2 = remTrkPt(pTrk, p2);
-                    pTrk->numDiscTrkPts++;
-                } else {
-                    // Carry over the data from the previous point
-                    p2->bearing = p1->bearing;
-                    p2->distance = p1->distance;
-                    p2->grade = p1->grade;
-                    p2->speed = p1->speed;
-
-                    // Move on to the next point
-                    p2 = nxtTrkPt(&p1, p2);
-                }
-                continue;
-            }
+    free(inVals);
 
-            // Compute the actual distance traveled between
-            // the two points.
-            if (absRise == 0.0) {
-                // When riding on the flats, dist equals run!
-                p2->dist = p2->run;
-            } else {
-                // Use Pythagoras's Theorem to compute the
-                // distance (hypotenuse)
-                p2->dist = sqrt((p2->run * p2->run) + (absRise * absRise));
-            }
+    return NULL;
+}
 
-            p2->distance = p1->distance + p2->dist;
-        }
+// Compute the Moving Average (SMA/WMA) of the specified
+// metrics over the given range of points, splitting the
+// range in tiles across up to the specified number of
+// threads.
+static int compMovAvg(GpsTrk *pTrk, int start, int end, const XmaSpec *specs, int numSpecs, int numThreads)
+{
+    TrkPts *pts = &pTrk->trkPts;
+    XmaTileQueue queue = {0};
+    int p, s;
 
-        // Paranoia?
-        if (p2->distance < p1->distance) {
-            fprintf(stderr, "SPONG! TrkPt #%u (%s) has a non-increasing distance !\n",
-                    p2->index, fmtTrkPtIdx(p2));
-            fprintf(stderr, "dist=%.10lf run=%.10lf absRise=%.10lf\n", p2->dist, p2->run, absRise);
-            dumpTrkPts(pTrk, p2, 2, 0);
-        }
+    if ((start >= end) || (numSpecs == 0))
+        return 0;   // empty range
 
-        // Update the max dist value
-        if (p2->dist > pTrk->maxDeltaD) {
-            pTrk->maxDeltaD = p2->dist;
-            pTrk->maxDeltaDTrkPt = p2;
-        }
+    if ((queue.outVals = malloc(numSpecs * (end - start) * sizeof (double))) == NULL) {
+        fprintf(stderr, "Failed to alloc SMA/WMA buffers !!!\n");
+        return -1;
+    }
 
-        // If needed, compute the time interval based on the
-        // distance and the specified average speed.
-        if (p2->timestamp == 0.0) {
-            p2->deltaT = p2->dist / pArgs->setSpeed;
-            p2->timestamp = p1->timestamp + p2->deltaT;
+    queue.pts = pts;
+    queue.specs = specs;
+    queue.numSpecs = numSpecs;
+    for (s = 0; s < numSpecs; s++) {
+        if (specs[s].xmaWindow > queue.maxWindow) {
+            queue.maxWindow = specs[s].xmaWindow;
         }
-
-        // Compute the time interval between the two points.
-        // Typically fixed at 1-sec, but some GPS devices (e.g.
-        // Garmin Edge) may use a "smart" recording mode that
-        // can have several seconds between points, while
-        // other devices (e.g. GoPro Hero) may record multiple
-        // points each second. And when converting a GPX route
-        // into a GPX ride, the time interval is arbitrary,
-        // computed from the distance and the speed.
-        p2->deltaT = (p2->timestamp - p1->timestamp);
-
-        // Paranoia?
-        if (p2->deltaT <= 0.0) {
-            fprintf(stderr, "SPONG! TrkPt #%u (%s) has a non-increasing timestamp ! dist=%.10lf deltaT=%.3lf\n",
-                    p2->index, fmtTrkPtIdx(p2), p2->dist, p2->deltaT);
-            dumpTrkPts(pTrk, p2, 2, 0);
+    }
+    queue.start = start;
+    queue.end = end;
+    queue.numTiles = ((end - start) + XMA_TILE_SIZE - 1) / XMA_TILE_SIZE;
+
+#ifndef _MSC_FULL_VER
+    if ((numThreads > 1) && (queue.numTiles > 1)) {
+        pthread_t *threads;
+        int numWorkers = 0;
+        int n;
+
+        if (numThreads > queue.numTiles) {
+            numThreads = queue.numTiles;
         }
 
-        // Update the max time interval between two points
-        if (p2->deltaT > pTrk->maxDeltaT) {
-            pTrk->maxDeltaT = p2->deltaT;
-            pTrk->maxDeltaTTrkPt = p2;
+        if ((threads = calloc(numThreads, sizeof (pthread_t))) == NULL) {
+            fprintf(stderr, "Failed to alloc SMA/WMA threads !!!\n");
+            free(queue.outVals);
+            return -1;
         }
 
-        if (p2->speed == nilSpeed) {
-            // Compute the speed as "distance over time"
-            p2->speed = p2->dist / p2->deltaT;
-            if (p2->speed > 27.78) {
-                fprintf(stderr, "SPONG! TrkPt #%u (%s) has a bogus speed value ! dist=%.10lf deltaT=%.3lf speed=%.3lf\n",
-                		 p2->index, fmtTrkPtIdx(p2), p2->dist, p2->deltaT, p2->speed);
+        // The calling thread picks up tiles as well, so we
+        // can live with fewer threads than requested.
+        for (n = 1; n < numThreads; n++) {
+            if (pthread_create(&threads[numWorkers], NULL, xmaWorker, &queue) == 0) {
+                numWorkers++;
             }
         }
 
-        // Update the total distance for the activity
-        pTrk->distance += p2->dist;
-
-        // Update the total time for the activity
-        pTrk->time += p2->deltaT;
-
-        if (p2->grade == nilGrade) {
-            // Compute the grade as "rise over run". Notice
-            // that the grade value may get updated later.
-            // Guard against points with run=0, which can
-            // happen when using the "--verbose" option...
-            if (p2->run != 0.0) {
-                p2->grade = (p2->rise * 100.0) / p2->run;   // in [%]
-            } else {
-                if (!pArgs->quiet) {
-                    fprintf(stderr, "WARNING: TrkPt #%d (%s) has a null run value !\n",
-                            p2->index, fmtTrkPtIdx(p2));
-                }
-                p2->grade = p1->grade;  // carry over the previous grade value
-            }
-        }
+        xmaWorker(&queue);
 
-        // Sanity check the grade value
-        if (p2->grade > 99.9) {
-            p2->grade = 99.9;
-        } else if (p2->grade < -99.9) {
-            p2->grade = -99.9;
+        for (n = 0; n < numWorkers; n++) {
+            pthread_join(threads[n], NULL);
         }
 
-        // Compute the bearing
-        p2->bearing = compBearing(p1, p2);
-
-        // Compute the grade change
-        p2->deltaG = fabs(p2->grade - p1->grade);
+        free(threads);
+    } else
+#endif  // _MSC_FULL_VER
+    {
+        xmaWorker(&queue);
+    }
 
-        // Update the activity's end time
-        pTrk->endTime = p2->timestamp;
+    if (queue.status != 0) {
+        free(queue.outVals);
+        return -1;
+    }
 
-        p2 = nxtTrkPt(&p1, p2);
+    // Now that all the tiles are done, override the
+    // original values with the computed SMA/WMA values.
+    for (s = 0; s < numSpecs; s++) {
+        XmaMetric xmaMetric = specs[s].xmaMetric;
+        const double *outVals = queue.outVals + (s * (end - start));
+        for (p = start; p < end; p++) {
+            xmaUpdTrkPt(pts, p, xmaMetric, outVals[p - start]);
+        }
     }
 
+    free(queue.outVals);
+
     return 0;
 }
 
-static void adjMaxGrade(GpsTrk *pTrk, CmdArgs *pArgs, TrkPt *p1, TrkPt *p2)
+// Get the settings of the metrics selected by --xma-metric:
+// either just the elevation, which is smoothed out before the
+// speed and grade are computed, or all the other metrics,
+// which are smoothed out together after the grade is limited.
+// Returns the number of metrics to smooth out.
+static int getXmaSpecs(const CmdArgs *pArgs, Bool elevOnly, XmaSpec *specs)
 {
-    if (!pArgs->quiet) {
-        fprintf(stderr, "WARNING: TrkPt #%d (%s) has a grade of %.2lf%% that is above the max value %.2lf%% !\n",
-                p2->index, fmtTrkPtIdx(p2), p2->grade, pArgs->maxGrade);
-    }
+    int numSpecs = 0;
+    int s;
 
-    // Override original value with the max value
-    p2->grade = pArgs->maxGrade;
+    for (s = 0; s < pArgs->numXmaSpecs; s++) {
+        const XmaSpec *pSpec = &pArgs->xmaSpecs[s];
+        if ((pSpec->xmaWindow != 0) && ((pSpec->xmaMetric == elevation) == elevOnly)) {
+            specs[numSpecs++] = *pSpec;
+        }
+    }
 
-    // Flag that this point had its grade adjusted
-    p2->adjGrade = true;
+    return numSpecs;
 }
 
-static void adjMinGrade(GpsTrk *pTrk, CmdArgs *pArgs, TrkPt *p1, TrkPt *p2)
+static int smoothMetrics(GpsTrk *pTrk, CmdArgs *pArgs, Bool elevOnly)
 {
-    if (!pArgs->quiet) {
-        fprintf(stderr, "WARNING: TrkPt #%d (%s) has a grade of %.2lf%% that is below the min value %.2lf%% !\n",
-                p2->index, fmtTrkPtIdx(p2), p2->grade, pArgs->minGrade);
-    }
+    XmaSpec specs[XMA_MAX_METRICS];
+    int numSpecs;
+    int start;      // start of the range
+    int end;        // end of the range
 
-    // Override original value with the min value
-    p2->grade = pArgs->minGrade;
+    if ((numSpecs = getXmaSpecs(pArgs, elevOnly, specs)) == 0)
+        return 0;   // nothing to smooth out
 
-    // Flag that this point had its grade adjusted
-    p2->adjGrade = true;
+    getTrkPtRange(pTrk, pArgs, &start, &end);
+
+    return compMovAvg(pTrk, start, end, specs, numSpecs, pArgs->numThreads);
 }
 
-static void adjGradeChange(GpsTrk *pTrk, CmdArgs *pArgs, TrkPt *p1, TrkPt *p2)
+// Check whether the TrkPt at the given position, which is the
+// given number of TrkPt's away from the start of the track,
+// is in the range specified by the user. This is the same
+// range returned by getTrkPtRange(), but it can be checked
+// while the track is still being compacted.
+static Bool trkPtInRange(const GpsTrk *pTrk, const CmdArgs *pArgs, int p, int ordinal)
 {
-    if (!pArgs->quiet) {
-        fprintf(stderr, "WARNING: TrkPt #%d (%s) has a grade change of %.2lf%% that is above the limit %.2lf%% !\n",
-                p2->index, fmtTrkPtIdx(p2), p2->deltaG, pArgs->maxGradeChange);
+    int index = pTrk->trkPts.index[p];
+
+    if (ordinal < 1) {
+        // The first TrkPt is never in the range
+        return false;
     }
 
-    // Override original value with the max value
-    if (p2->grade > p1->grade) {
-        p2->grade = p1->grade + pArgs->maxGradeChange;
-    } else {
-        p2->grade = p1->grade - pArgs->maxGradeChange;
+    if (pArgs->rangeFrom == 0) {
+        return true;
     }
 
-    // Flag that this point had its grade adjusted
-    p2->adjGrade = true;
+    return ((index >= pArgs->rangeFrom) && (index <= pArgs->rangeTo)) ? true : false;
 }
 
-#if 0
-static void adjSpeedChange(GpsTrk *pTrk, CmdArgs *pArgs, TrkPt *p1, TrkPt *p2)
+// Streaming version of compMovAvg(), used by the fused
+// pipeline: the TrkPt's are fed one at a time, in order, and
+// each tile is computed as soon as its right halo has been
+// fed. Only the original values of the current tile, plus its
+// halos, are kept, so the buffers are bounded regardless of
+// the length of the track. The tiles are the same ones used
+// by compMovAvg(), so the results are the same as well.
+//
+// The TrkPt's are identified by their position in the track,
+// and by their ordinal; i.e. the number of TrkPt's fed before
+// them, which is the position they will end up at once the
+// track is compacted.
+typedef struct XmaStream {
+    GpsTrk *pTrk;           // track being smoothed
+    const CmdArgs *pArgs;   // command args
+    XmaSpec specs[XMA_MAX_METRICS]; // metrics being smoothed
+    int numSpecs;           // number of metrics being smoothed
+    int halo;               // largest (N-1)/2 of all the metrics
+    int max;                // max number of TrkPt's in the buffers
+    int base;               // ordinal of the first TrkPt in the buffers
+    int count;              // number of TrkPt's fed so far
+    int numReady;           // number of TrkPt's that can be released
+    int numDone;            // number of TrkPt's released so far
+    int start;              // start of the range, or -1 if not found yet
+    int end;                // end of the range, or -1 if not found yet
+    int tileStart;          // start of the current tile
+    Bool eof;               // all the TrkPt's have been fed
+    int *pos;               // position of each TrkPt in the buffers
+    double *vals[XMA_MAX_METRICS];  // original values of each metric
+    double *tmpVals;        // WMA only: sums of the (n+1)-point windows
+    double *outVals;        // SMA/WMA values of the current tile
+} XmaStream;
+
+static int xmaStreamInit(XmaStream *pStream, GpsTrk *pTrk, const CmdArgs *pArgs, const XmaSpec *specs, int numSpecs)
 {
-    double maxSpeedChange = (p1->speed * pArgs->maxSpeedChange) / 100.0;
+    int numVals;
+    int s;
+
+    memset(pStream, 0, sizeof (*pStream));
+    pStream->pTrk = pTrk;
+    pStream->pArgs = pArgs;
+    pStream->numSpecs = numSpecs;
+    for (s = 0; s < numSpecs; s++) {
+        pStream->specs[s] = specs[s];
+        if (((specs[s].xmaWindow - 1) / 2) > pStream->halo) {
+            pStream->halo = (specs[s].xmaWindow - 1) / 2;
+        }
+    }
+    pStream->max = XMA_TILE_SIZE + (2 * pStream->halo) + 1;
+    pStream->base = -pStream->halo;     // values before the track count as zero
+    pStream->start = pStream->end = -1;
+
+    // The buffers of the original values have room for the
+    // right halo of the last TrkPt, which is zero-filled when
+    // the track ends.
+    numVals = pStream->max + pStream->halo;
+    if (((pStream->pos = calloc(pStream->max, sizeof (int))) == NULL) ||
+        ((pStream->tmpVals = calloc(pStream->max + XMA_TILE_SIZE + (numSpecs * numVals), sizeof (double))) == NULL)) {
+        fprintf(stderr, "Failed to alloc SMA/WMA buffers !!!\n");
+        free(pStream->pos);
+        return -1;
+    }
+    pStream->outVals = pStream->tmpVals + pStream->max;
+    for (s = 0; s < numSpecs; s++) {
+        pStream->vals[s] = pStream->outVals + XMA_TILE_SIZE + (s * numVals);
+    }
+
+    return 0;
+}
+
+static void xmaStreamFree(XmaStream *pStream)
+{
+    free(pStream->pos);
+    free(pStream->tmpVals);
+}
+
+// Compute the SMA/WMA values of the TrkPt's in the current
+// tile, and override their original values.
+static void xmaStreamTile(XmaStream *pStream, int tileEnd)
+{
+    TrkPts *pts = &pStream->pTrk->trkPts;
+    int s, k;
+
+    for (s = 0; s < pStream->numSpecs; s++) {
+        const XmaSpec *pSpec = &pStream->specs[s];
+        int n = (pSpec->xmaWindow - 1) / 2;
+
+        // Values after the end of the track count as zero
+        for (k = pStream->count; k < (tileEnd + pStream->halo); k++) {
+            pStream->vals[s][k - pStream->base] = 0.0;
+        }
+
+        compMovAvgVals(pSpec, &pStream->vals[s][pStream->tileStart - n - pStream->base],
+                       pStream->tileStart, tileEnd, pStream->count, pStream->tmpVals, pStream->outVals);
+
+        for (k = pStream->tileStart; k < tileEnd; k++) {
+            xmaUpdTrkPt(pts, pStream->pos[k - pStream->base], pSpec->xmaMetric, pStream->outVals[k - pStream->tileStart]);
+        }
+    }
+}
+
+// Compute all the tiles that have been fed, along with their
+// right halo, and figure out how many TrkPt's can be released.
+static void xmaStreamUpdate(XmaStream *pStream)
+{
+    for (;;) {
+        int tileEnd;
+
+        if ((pStream->start == -1) || (pStream->tileStart == pStream->end)) {
+            // Outside the range: nothing to smooth out
+            pStream->numReady = pStream->count;
+            return;
+        }
+
+        // The TrkPt's in the tile can't be released until
+        // their SMA/WMA values have been computed.
+        pStream->numReady = pStream->tileStart;
+
+        tileEnd = pStream->tileStart + XMA_TILE_SIZE;
+        if ((pStream->end != -1) && (pStream->end < tileEnd)) {
+            tileEnd = pStream->end;
+        }
+
+        // Notice that, with the right halo, we also wait for
+        // the TrkPt that follows it, so the TrkPt's in the
+        // tile don't get smoothed before the stages that
+        // feed the stream are done with them.
+        if (!pStream->eof && (pStream->count <= (tileEnd + pStream->halo))) {
+            return;
+        }
+
+        xmaStreamTile(pStream, tileEnd);
+        pStream->tileStart = tileEnd;
+    }
+}
+
+// Feed the TrkPt at the given position to the stream
+static void xmaStreamFeed(XmaStream *pStream, int p)
+{
+    TrkPts *pts = &pStream->pTrk->trkPts;
+    int k = pStream->count;
+    int s;
+
+    if ((k - pStream->base) == pStream->max) {
+        // Make room in the buffers, keeping the TrkPt's that
+        // have not been released yet, and the left halo of
+        // the current tile.
+        int keep = (pStream->numReady < pStream->count) ? pStream->tileStart : pStream->count;
+        int shift = (keep - pStream->halo) - pStream->base;
+
+        memmove(pStream->pos, (pStream->pos + shift), ((k - pStream->base) - shift) * sizeof (int));
+        for (s = 0; s < pStream->numSpecs; s++) {
+            memmove(pStream->vals[s], (pStream->vals[s] + shift), ((k - pStream->base) - shift) * sizeof (double));
+        }
+        pStream->base += shift;
+    }
+
+    pStream->pos[k - pStream->base] = p;
+    for (s = 0; s < pStream->numSpecs; s++) {
+        pStream->vals[s][k - pStream->base] = xmaGetVal(pts, p, pStream->specs[s].xmaMetric);
+    }
+    pStream->count++;
+
+    // The TrkPt's in the range are always contiguous
+    if (pStream->start == -1) {
+        if (trkPtInRange(pStream->pTrk, pStream->pArgs, p, k)) {
+            pStream->start = pStream->tileStart = k;
+        }
+    } else if ((pStream->end == -1) && !trkPtInRange(pStream->pTrk, pStream->pArgs, p, k)) {
+        pStream->end = k;
+    }
+
+    xmaStreamUpdate(pStream);
+}
+
+// Flag that all the TrkPt's have been fed to the stream
+static void xmaStreamEnd(XmaStream *pStream)
+{
+    pStream->eof = true;
+    if ((pStream->start != -1) && (pStream->end == -1)) {
+        pStream->end = pStream->count;
+    }
+
+    xmaStreamUpdate(pStream);
+}
+
+// Get the position of the next TrkPt released by the stream,
+// or -1 if none.
+static int xmaStreamNext(XmaStream *pStream)
+{
+    if (pStream->numDone == pStream->numReady) {
+        return -1;
+    }
+
+    return pStream->pos[pStream->numDone++ - pStream->base];
+}
+
+// Compute the great-circle distance (in meters) between two
+// track points using the Haversine formula. See below for
+// the details:
+//
+//   https://en.wikipedia.org/wiki/Haversine_formula
+//
+static double compDistance(const TrkPts *pts, int p1, int p2)
+{
+    const double two = (double) 2.0;
+    double phi1 = coordToDeg(pts->latitude[p1]) * degToRad;  // p1's latitude in radians
+    double phi2 = coordToDeg(pts->latitude[p2]) * degToRad;  // p2's latitude in radians
+    double deltaPhi = (phi2 - phi1);        // latitude diff in radians
+    double deltaLambda = (coordToDeg(pts->longitude[p2]) - coordToDeg(pts->longitude[p1])) * degToRad;   // longitude diff in radians
+    double a = sin(deltaPhi / two);
+    double b = sin(deltaLambda / two);
+    double h = (a * a) + cos(phi1) * cos(phi2) * (b * b);
+
+    assert(h >= 0.0);
+
+    return (two * earthMeanRadius * asin(sqrt(h)));
+}
+
+// Max number of TrkPt's handled by each call to compRunsAndBearings()
+#define GEO_BATCH_SIZE  256
+
+// Domains of the polynomial approximations used by
+// compRunsAndBearings(). The latitudes are always within the
+// domain of polySin() and polyCos(), and polyAsin() covers
+// any pair of points less than ~800 km apart.
+#define POLY_TRIG_MAX   1.57        // 89.95 degrees
+#define POLY_ASIN_MAX   0.0625
+
+// Taylor polynomial of cos(x) up to x^22. For |x| <= POLY_TRIG_MAX
+// the truncation error is less than x^24/24! < 1e-19.
+static __inline__ double polyCos(double x)
+{
+    double x2 = x * x;
+
+    return 1.0 + x2 * (-1.0 / 2.0 + x2 * (1.0 / 24.0 + x2 * (-1.0 / 720.0 + x2 * (1.0 / 40320.0 +
+           x2 * (-1.0 / 3628800.0 + x2 * (1.0 / 479001600.0 + x2 * (-1.0 / 87178291200.0 +
+           x2 * (1.0 / 20922789888000.0 + x2 * (-1.0 / 6402373705728000.0 +
+           x2 * (1.0 / 2432902008176640000.0 + x2 * (-1.0 / 1124000727777607680000.0)))))))))));
+}
+
+// Taylor polynomial of sin(x) up to x^23. For |x| <= POLY_TRIG_MAX
+// the truncation error is less than x^25/25! < 1e-20.
+static __inline__ double polySin(double x)
+{
+    double x2 = x * x;
+
+    return x * (1.0 + x2 * (-1.0 / 6.0 + x2 * (1.0 / 120.0 + x2 * (-1.0 / 5040.0 + x2 * (1.0 / 362880.0 +
+           x2 * (-1.0 / 39916800.0 + x2 * (1.0 / 6227020800.0 + x2 * (-1.0 / 1307674368000.0 +
+           x2 * (1.0 / 355687428096000.0 + x2 * (-1.0 / 121645100408832000.0 +
+           x2 * (1.0 / 51090942171709440000.0 + x2 * (-1.0 / 25852016738884976640000.0))))))))))));
+}
+
+// Taylor polynomial of asin(x) up to x^13. For 0 <= x <= POLY_ASIN_MAX
+// the relative truncation error is less than x^14 / 50 < 1e-18.
+static __inline__ double polyAsin(double x)
+{
+    double x2 = x * x;
+
+    return x * (1.0 + x2 * (1.0 / 6.0 + x2 * (3.0 / 40.0 + x2 * (5.0 / 112.0 + x2 * (35.0 / 1152.0 +
+           x2 * (63.0 / 2816.0 + x2 * (231.0 / 13312.0)))))));
+}
+
+// Compute the bearing (in decimal degrees) between two track
+// points.  See below for the details:
+//
+//   https://www.movable-type.co.uk/scripts/latlong.html
+//
+static double compBearing(const TrkPts *pts, int p1, int p2)
+{
+    double phi1 = coordToDeg(pts->latitude[p1]) * degToRad;  // p1's latitude in radians
+    double phi2 = coordToDeg(pts->latitude[p2]) * degToRad;  // p2's latitude in radians
+    double deltaLambda = (coordToDeg(pts->longitude[p2]) - coordToDeg(pts->longitude[p1])) * degToRad;   // longitude diff in radians
+    double x = sin(deltaLambda) * cos(phi2);
+    double y = cos(phi1) * sin(phi2) - sin(phi1) * cos(phi2) * cos(deltaLambda);
+    double theta = atan2(x, y);  // in radians
+
+    return fmod((theta / degToRad + 360.0), 360.0); // in degrees decimal (0-359.99)
+}
+
+// Compute the horizontal distance "run" and, optionally, the
+// bearing between each of the given TrkPt's and the one right
+// before it. This is the same math used by compDistance() and
+// compBearing(), but fused and done in batches: the sin() and
+// cos() of the latitude of each point are only computed once,
+// instead of four times, the sin() and cos() of the longitude
+// diff are derived from those of its half angle (which the
+// Haversine formula needs anyway), and the trig functions
+// are replaced by the branch-free polynomials above, which
+// the compiler can vectorize. The few pairs that fall outside
+// the domain of the polynomials (e.g. at the gap between two
+// stitched files, or when crossing the antimeridian) are
+// redone with compDistance() and compBearing().
+static void compRunsAndBearings(const TrkPts *pts, int p, int numPts, double *runs, double *bearings)
+{
+    double phi[GEO_BATCH_SIZE + 1];
+    double lambda[GEO_BATCH_SIZE + 1];  // in degrees
+    double sinPhi[GEO_BATCH_SIZE + 1];
+    double cosPhi[GEO_BATCH_SIZE + 1];
+    double x[GEO_BATCH_SIZE];
+    double y[GEO_BATCH_SIZE];
+    uint8_t slow[GEO_BATCH_SIZE];
+    int numSlow = 0;
+    int n;
+
+    assert((p >= 1) && (numPts <= GEO_BATCH_SIZE));
+
+    for (n = 0; n <= numPts; n++) {
+        phi[n] = coordToDeg(pts->latitude[p - 1 + n]) * degToRad;
+        lambda[n] = coordToDeg(pts->longitude[p - 1 + n]);
+        sinPhi[n] = polySin(phi[n]);
+        cosPhi[n] = polyCos(phi[n]);
+    }
+
+    for (n = 0; n < numPts; n++) {
+        double halfDeltaPhi = (phi[n + 1] - phi[n]) / 2.0;
+        double halfDeltaLambda = ((lambda[n + 1] - lambda[n]) * degToRad) / 2.0;
+        double a = polySin(halfDeltaPhi);
+        double b = polySin(halfDeltaLambda);
+        double c = sqrt((a * a) + cosPhi[n] * cosPhi[n + 1] * (b * b));
+        double sinDeltaLambda = 2.0 * b * polyCos(halfDeltaLambda);
+        double cosDeltaLambda = 1.0 - 2.0 * (b * b);
+
+        runs[n] = 2.0 * earthMeanRadius * polyAsin(c);
+        x[n] = sinDeltaLambda * cosPhi[n + 1];
+        y[n] = cosPhi[n] * sinPhi[n + 1] - sinPhi[n] * cosPhi[n + 1] * cosDeltaLambda;
+        slow[n] = (fabs(phi[n]) > POLY_TRIG_MAX) | (fabs(phi[n + 1]) > POLY_TRIG_MAX) |
+                  (fabs(halfDeltaLambda) > POLY_TRIG_MAX) | (c > POLY_ASIN_MAX);
+        numSlow += slow[n];
+    }
+
+    if (bearings != NULL) {
+        for (n = 0; n < numPts; n++) {
+            bearings[n] = fmod((atan2(x[n], y[n]) / degToRad + 360.0), 360.0);
+        }
+    }
+
+    for (n = 0; (numSlow != 0) && (n < numPts); n++) {
+        if (slow[n]) {
+            runs[n] = compDistance(pts, (p - 1 + n), (p + n));
+            if (bearings != NULL) {
+                bearings[n] = compBearing(pts, (p - 1 + n), (p + n));
+            }
+            numSlow--;
+        }
+    }
+}
+
+// Get the distance (in meters) of each TrkPt from the start
+// of the track. Before the metrics are computed only the
+// FIT/TCX TrkPt's carry a distance value, so for the other
+// ones we add up the distance between consecutive points,
+// the same way compMetrics() does.
+static double *getTrkPtDistances(const GpsTrk *pTrk)
+{
+    const TrkPts *pts = &pTrk->trkPts;
+    double runs[GEO_BATCH_SIZE];
+    double *distances;
+    int p;
+
+    if ((distances = malloc(pts->count * sizeof (double))) == NULL) {
+        fprintf(stderr, "Failed to alloc distance array !!!\n");
+        return NULL;
+    }
+
+    distances[0] = pts->distance[0];
+    for (p = 1; p < pts->count; p++) {
+        if ((p % GEO_BATCH_SIZE) == 1) {
+            int numPts = pts->count - p;
+            compRunsAndBearings(pts, p, ((numPts < GEO_BATCH_SIZE) ? numPts : GEO_BATCH_SIZE), runs, NULL);
+        }
+
+        if (pts->distance[p] != 0.0) {
+            distances[p] = pts->distance[p];
+        } else {
+            double run = runs[(p - 1) % GEO_BATCH_SIZE];
+            double rise = pts->elevation[p] - pts->elevation[p - 1];
+            distances[p] = distances[p - 1] + sqrt((run * run) + (rise * rise));
+        }
+    }
+
+    return distances;
+}
+
+// Convert a time/distance span, relative to the start of
+// the track, into the indexes of the first and last TrkPt's
+// within that span. As with the --range and --trim options,
+// the first TrkPt of the track (the reference point) is never
+// included. Returns -1 if there are no TrkPt's in the span.
+static int getTrkPtSpan(const GpsTrk *pTrk, const CmdArgs *pArgs, const char *what,
+                        SpanUnits units, double start, double end, int *pFrom, int *pTo)
+{
+    const TrkPts *pts = &pTrk->trkPts;
+    TrkPtState state;
+    int p1;         // first TrkPt in the span
+    int p2;         // last TrkPt in the span
+
+    if (units == byDist) {
+        double *distances;
+
+        if ((distances = getTrkPtDistances(pTrk)) == NULL) {
+            return -1;
+        }
+        p1 = seekTrkPt(pTrk, distances, (distances[0] + start), NULL);
+        p2 = seekTrkPt(pTrk, distances, (distances[0] + end), &state);
+        free(distances);
+    } else {
+        double time0 = timeToSec(pts->timestamp[0]);
+
+        if (pts->timestamp[pts->count - 1] == 0) {
+            // Hu?
+            fprintf(stderr, "Can't %s by time a track without time information !\n", what);
+            return -1;
+        }
+        p1 = seekTrkPtByTime(pTrk, (time0 + start), NULL);
+        p2 = seekTrkPtByTime(pTrk, (time0 + end), &state);
+    }
+
+    if (p1 == 0) {
+        p1 = 1;
+    }
+    if (p2 == -1) {
+        // The span extends past the end of the track
+        p2 = pts->count - 1;
+    } else {
+        p2 = state.p1;
+    }
+
+    if ((p1 == -1) || (p1 > p2)) {
+        if (!pArgs->quiet) {
+            fprintf(stderr, "WARNING: No TrkPt's in the specified %s span !\n", what);
+        }
+        return -1;
+    }
+
+    if (!pArgs->quiet) {
+        fprintf(stderr, "INFO: %s span starts at TrkPt #%d (%s)\n", what, pts->index[p1], fmtTrkPtIdx(pTrk, p1));
+        fprintf(stderr, "INFO: %s span ends at TrkPt #%d (%s)\n", what, pts->index[p2], fmtTrkPtIdx(pTrk, p2));
+    }
+
+    *pFrom = pts->index[p1];
+    *pTo = pts->index[p2];
+
+    return 0;
+}
+
+// Compute the distance, elevation diff, speed, and grade
+// between the given pair of points, given the horizontal
+// distance "run" and the bearing between them. Returns false
+// if the TrkPt was discarded.
+static Bool compTrkPtMetrics(GpsTrk *pTrk, CmdArgs *pArgs, int p1, int p2, double run, double bearing)
+{
+    TrkPts *pts = &pTrk->trkPts;
+    double absRise; // always positive!
+
+    // Compute the elevation difference (can be negative)
+    pts->rise[p2] = pts->elevation[p2] - pts->elevation[p1];
+
+    // The "rise" is always positive!
+    absRise = fabs(pts->rise[p2]);
+
+    // FIT/TCX files include the "distance" metric which
+    // is the distance (in meters) from the start up to
+    // the given point. For GPX files, we need to compute
+    // the distance between consecutive points using the
+    // GPS data.
+    if (pts->distance[p2] != 0.0) {
+        if ((pts->dist[p2] = pts->distance[p2] - pts->distance[p1]) == 0.0) {
+            // Stopped?
+            if (!pArgs->verbatim) {
+                if (!pArgs->quiet) {
+                    fprintf(stderr, "WARNING: TrkPt #%d (%s) has a null distance value !\n",
+                            pts->index[p2], fmtTrkPtIdx(pTrk, p2));
+                    printTrkPt(pTrk, p2);
+                }
+
+                // Skip and delete this TrkPt
+                delTrkPt(pTrk, p2);
+                pTrk->numDiscTrkPts++;
+                return false;
+            }
+
+            // Carry over the data from the previous point
+            pts->bearing[p2] = pts->bearing[p1];
+            pts->distance[p2] = pts->distance[p1];
+            pts->grade[p2] = pts->grade[p1];
+            pts->speed[p2] = pts->speed[p1];
+            return true;
+        }
+
+        if (pts->dist[p2] > absRise) {
+            // Compute the horizontal distance "run" using
+            // Pythagoras's Theorem.
+            pts->run[p2] = sqrt((pts->dist[p2] * pts->dist[p2]) - (absRise * absRise));
+        } else {
+            // Bogus data?
+            if (!pArgs->quiet) {
+                fprintf(stderr, "WARNING: TrkPt #%d (%s) has inconsistent dist=%.3lf and rise=%.3lf values !\n",
+                        pts->index[p2], fmtTrkPtIdx(pTrk, p2), pts->dist[p2], absRise);
+                printTrkPt(pTrk, p2);
+            }
+            pts->run[p2] = pts->dist[p2]; // assume a null grade
+        }
+    } else {
+        // Compute the horizontal distance "run" between
+        // the two points, based on their latitude and
+        // longitude values.
+        if ((pts->run[p2] = run) == 0.0) {
+            // Stopped?
+            if (!pArgs->verbatim) {
+                if (!pArgs->quiet) {
+                    fprintf(stderr, "WARNING: TrkPt #%d (%s) has a null run value !\n",
+                            pts->index[p2], fmtTrkPtIdx(pTrk, p2));
+                    printTrkPt(pTrk, p2);
+                }
+
+                // Skip and delete this TrkPt
+                delTrkPt(pTrk, p2);
+                pTrk->numDiscTrkPts++;
+                return false;
+            }
+
+            // Carry over the data from the previous point
+            pts->bearing[p2] = pts->bearing[p1];
+            pts->distance[p2] = pts->distance[p1];
+            pts->grade[p2] = pts->grade[p1];
+            pts->speed[p2] = pts->speed[p1];
+            return true;
+        }
+
+        // Compute the actual distance traveled between
+        // the two points.
+        if (absRise == 0.0) {
+            // When riding on the flats, dist equals run!
+            pts->dist[p2] = pts->run[p2];
+        } else {
+            // Use Pythagoras's Theorem to compute the
+            // distance (hypotenuse)
+            pts->dist[p2] = sqrt((pts->run[p2] * pts->run[p2]) + (absRise * absRise));
+        }
+
+        pts->distance[p2] = pts->distance[p1] + pts->dist[p2];
+    }
+
+    // Paranoia?
+    if (pts->distance[p2] < pts->distance[p1]) {
+        fprintf(stderr, "SPONG! TrkPt #%u (%s) has a non-increasing distance !\n",
+                pts->index[p2], fmtTrkPtIdx(pTrk, p2));
+        fprintf(stderr, "dist=%.10lf run=%.10lf absRise=%.10lf\n", pts->dist[p2], pts->run[p2], absRise);
+        dumpTrkPts(pTrk, p2, 2, 0);
+    }
+
+    // Update the max dist value
+    if (pts->dist[p2] > pTrk->maxDeltaD) {
+        pTrk->maxDeltaD = pts->dist[p2];
+        pTrk->maxDeltaDTrkPt = p2;
+    }
+
+    // If needed, compute the time interval based on the
+    // distance and the specified average speed.
+    if (pts->timestamp[p2] == 0) {
+        pts->deltaT[p2] = pts->dist[p2] / pArgs->setSpeed;
+        pts->timestamp[p2] = pts->timestamp[p1] + secToTime(pts->deltaT[p2]);
+    }
+
+    // Compute the time interval between the two points.
+    // Typically fixed at 1-sec, but some GPS devices (e.g.
+    // Garmin Edge) may use a "smart" recording mode that
+    // can have several seconds between points, while
+    // other devices (e.g. GoPro Hero) may record multiple
+    // points each second. And when converting a GPX route
+    // into a GPX ride, the time interval is arbitrary,
+    // computed from the distance and the speed.
+    pts->deltaT[p2] = (timeToSec(pts->timestamp[p2]) - timeToSec(pts->timestamp[p1]));
+
+    // Paranoia?
+    if (pts->deltaT[p2] <= 0.0) {
+        fprintf(stderr, "SPONG! TrkPt #%u (%s) has a non-increasing timestamp ! dist=%.10lf deltaT=%.3lf\n",
+                pts->index[p2], fmtTrkPtIdx(pTrk, p2), pts->dist[p2], pts->deltaT[p2]);
+        dumpTrkPts(pTrk, p2, 2, 0);
+    }
+
+    // Update the max time interval between two points
+    if (pts->deltaT[p2] > pTrk->maxDeltaT) {
+        pTrk->maxDeltaT = pts->deltaT[p2];
+        pTrk->maxDeltaTTrkPt = p2;
+    }
+
+    if (pts->speed[p2] == nilSpeed) {
+        // Compute the speed as "distance over time"
+        pts->speed[p2] = pts->dist[p2] / pts->deltaT[p2];
+        if (pts->speed[p2] > 27.78) {
+            fprintf(stderr, "SPONG! TrkPt #%u (%s) has a bogus speed value ! dist=%.10lf deltaT=%.3lf speed=%.3lf\n",
+            		 pts->index[p2], fmtTrkPtIdx(pTrk, p2), pts->dist[p2], pts->deltaT[p2], pts->speed[p2]);
+        }
+    }
+
+    // Update the total distance for the activity
+    pTrk->distance += pts->dist[p2];
+
+    // Update the total time for the activity
+    pTrk->time += pts->deltaT[p2];
+
+    if (pts->grade[p2] == nilGrade) {
+        // Compute the grade as "rise over run". Notice
+        // that the grade value may get updated later.
+        // Guard against points with run=0, which can
+        // happen when using the "--verbose" option...
+        if (pts->run[p2] != 0.0) {
+            pts->grade[p2] = (pts->rise[p2] * 100.0) / pts->run[p2];   // in [%]
+        } else {
+            if (!pArgs->quiet) {
+                fprintf(stderr, "WARNING: TrkPt #%d (%s) has a null run value !\n",
+                        pts->index[p2], fmtTrkPtIdx(pTrk, p2));
+            }
+            pts->grade[p2] = pts->grade[p1];  // carry over the previous grade value
+        }
+    }
+
+    // Sanity check the grade value
+    if (pts->grade[p2] > 99.9) {
+        pts->grade[p2] = 99.9;
+    } else if (pts->grade[p2] < -99.9) {
+        pts->grade[p2] = -99.9;
+    }
+
+    // Compute the bearing
+    pts->bearing[p2] = bearing;
+
+    // Compute the grade change
+    pts->deltaG[p2] = fabs(pts->grade[p2] - pts->grade[p1]);
+
+    // Update the activity's end time
+    pTrk->endTime = timeToSec(pts->timestamp[p2]);
+
+    return true;
+}
+
+#ifndef _MSC_FULL_VER
+// Number of TrkPt's in each chunk of the parallel compMetrics()
+#define METRICS_CHUNK_SIZE  16384
+
+// State of each TrkPt in the parallel compMetrics()
+#define PM_DONE         0x01    // pairwise metrics computed by the workers
+#define PM_NIL_SPEED    0x02    // speed value was computed
+#define PM_NIL_GRADE    0x04    // grade value was computed
+
+// The parallel compMetrics() runs in two phases. First, the
+// worker threads compute the metrics that only depend on each
+// TrkPt and the one right before it (rise, run, dist, deltaT,
+// speed, grade, and bearing), one chunk of TrkPt's at a time.
+// Then a serial scan walks the track, applying the running
+// sums (cumulative distance, total distance and time) and the
+// max deltas, in the same order as the serial version, so the
+// results are exactly the same. Any TrkPt that may need to
+// print a warning, be discarded, or be compared against some
+// other TrkPt, is left alone by the workers and redone by the
+// scan with compTrkPtMetrics().
+typedef struct MetricsQueue {
+    TrkPts *pts;            // track being processed
+    uint8_t *state;         // PM_xxx state of each TrkPt
+    int numChunks;          // number of chunks
+    int nextChunk;          // next chunk to be picked up
+} MetricsQueue;
+
+// Compute the pairwise metrics of the TrkPt at position p2,
+// using the run and bearing from the TrkPt right before it.
+// Returns false, leaving the speed and grade values alone,
+// if the TrkPt needs to be handled by compTrkPtMetrics().
+static Bool compPairMetrics(TrkPts *pts, int p2, double run, double bearing, uint8_t *pState)
+{
+    int p1 = p2 - 1;
+    double absRise;
+    double speed = pts->speed[p2];
+    double grade = pts->grade[p2];
+    uint8_t state = PM_DONE;
+
+    if ((pts->timestamp[p1] == 0) || (pts->timestamp[p2] == 0)) {
+        // Timestamps need to be generated
+        return false;
+    }
+
+    pts->rise[p2] = pts->elevation[p2] - pts->elevation[p1];
+    absRise = fabs(pts->rise[p2]);
+
+    if (pts->distance[p2] != 0.0) {
+        // The cumulative distance of p1 must be final
+        if (pts->distance[p1] == 0.0) {
+            return false;
+        }
+
+        // Null, non-increasing, or inconsistent distance?
+        if ((pts->dist[p2] = pts->distance[p2] - pts->distance[p1]) <= absRise) {
+            return false;
+        }
+        pts->run[p2] = sqrt((pts->dist[p2] * pts->dist[p2]) - (absRise * absRise));
+    } else {
+        if ((pts->run[p2] = run) == 0.0) {
+            return false;
+        }
+        if (absRise == 0.0) {
+            pts->dist[p2] = pts->run[p2];
+        } else {
+            pts->dist[p2] = sqrt((pts->run[p2] * pts->run[p2]) + (absRise * absRise));
+        }
+    }
+
+    if ((pts->deltaT[p2] = (timeToSec(pts->timestamp[p2]) - timeToSec(pts->timestamp[p1]))) <= 0.0) {
+        return false;
+    }
+
+    if (speed == nilSpeed) {
+        if ((speed = pts->dist[p2] / pts->deltaT[p2]) > 27.78) {
+            return false;
+        }
+        state |= PM_NIL_SPEED;
+    }
+
+    if (grade == nilGrade) {
+        if (pts->run[p2] == 0.0) {
+            return false;
+        }
+        grade = (pts->rise[p2] * 100.0) / pts->run[p2];
+        if (grade > 99.9) {
+            grade = 99.9;
+        } else if (grade < -99.9) {
+            grade = -99.9;
+        }
+        state |= PM_NIL_GRADE;
+    } else if ((grade > 99.9) || (grade < -99.9)) {
+        return false;
+    }
+
+    pts->speed[p2] = speed;
+    pts->grade[p2] = grade;
+    pts->bearing[p2] = bearing;
+    *pState = state;
+
+    return true;
+}
+
+static void *metricsWorker(void *arg)
+{
+    MetricsQueue *pQueue = arg;
+    TrkPts *pts = pQueue->pts;
+    double runs[GEO_BATCH_SIZE];
+    double bearings[GEO_BATCH_SIZE];
+    int c, p, n;
+
+    while ((c = __sync_fetch_and_add(&pQueue->nextChunk, 1)) < pQueue->numChunks) {
+        int start = 1 + (c * METRICS_CHUNK_SIZE);
+        int end = ((pts->count - start) > METRICS_CHUNK_SIZE) ? (start + METRICS_CHUNK_SIZE) : pts->count;
+        for (p = start; p < end; p += GEO_BATCH_SIZE) {
+            int numPts = ((end - p) < GEO_BATCH_SIZE) ? (end - p) : GEO_BATCH_SIZE;
+            compRunsAndBearings(pts, p, numPts, runs, bearings);
+            for (n = 0; n < numPts; n++) {
+                compPairMetrics(pts, (p + n), runs[n], bearings[n], &pQueue->state[p + n]);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static int compMetricsParallel(GpsTrk *pTrk, CmdArgs *pArgs, int numThreads)
+{
+    TrkPts *pts = &pTrk->trkPts;
+    MetricsQueue queue = {0};
+    pthread_t *threads;
+    int numWorkers = 0;
+    int p1 = 0;     // previous TrkPt
+    int p2;         // current TrkPt
+    int n;
+
+    queue.pts = pts;
+    queue.numChunks = ((pts->count - 1) + METRICS_CHUNK_SIZE - 1) / METRICS_CHUNK_SIZE;
+    if (numThreads > queue.numChunks) {
+        numThreads = queue.numChunks;
+    }
+
+    if (((queue.state = calloc(pts->count, sizeof (uint8_t))) == NULL) ||
+        ((threads = calloc(numThreads, sizeof (pthread_t))) == NULL)) {
+        fprintf(stderr, "Failed to alloc metrics threads !!!\n");
+        free(queue.state);
+        return -1;
+    }
+
+    // The calling thread picks up chunks as well, so we
+    // can live with fewer threads than requested.
+    for (n = 1; n < numThreads; n++) {
+        if (pthread_create(&threads[numWorkers], NULL, metricsWorker, &queue) == 0) {
+            numWorkers++;
+        }
+    }
+
+    metricsWorker(&queue);
+
+    for (n = 0; n < numWorkers; n++) {
+        pthread_join(threads[n], NULL);
+    }
+
+    free(threads);
+
+    // Now apply the running sums and max deltas, in order
+    for (p2 = 1; p2 < pts->count; p2++) {
+        uint8_t state = queue.state[p2];
+
+        if ((state & PM_DONE) && (p1 == (p2 - 1))) {
+            if (pts->distance[p2] == 0.0) {
+                pts->distance[p2] = pts->distance[p1] + pts->dist[p2];
+            }
+
+            // Update the max dist value
+            if (pts->dist[p2] > pTrk->maxDeltaD) {
+                pTrk->maxDeltaD = pts->dist[p2];
+                pTrk->maxDeltaDTrkPt = p2;
+            }
+
+            // Update the max time interval between two points
+            if (pts->deltaT[p2] > pTrk->maxDeltaT) {
+                pTrk->maxDeltaT = pts->deltaT[p2];
+                pTrk->maxDeltaTTrkPt = p2;
+            }
+
+            pTrk->distance += pts->dist[p2];
+            pTrk->time += pts->deltaT[p2];
+            pts->deltaG[p2] = fabs(pts->grade[p2] - pts->grade[p1]);
+            pTrk->endTime = timeToSec(pts->timestamp[p2]);
+            p1 = p2;
+        } else {
+            double run, bearing;
+
+            // Either the workers left this TrkPt alone, or
+            // the TrkPt before it was discarded: restore the
+            // original speed and grade values, and start
+            // over.
+            if (state & PM_NIL_SPEED) {
+                pts->speed[p2] = nilSpeed;
+            }
+            if (state & PM_NIL_GRADE) {
+                pts->grade[p2] = nilGrade;
+            }
+
+            if (p1 == (p2 - 1)) {
+                compRunsAndBearings(pts, p2, 1, &run, &bearing);
+            } else {
+                run = compDistance(pts, p1, p2);
+                bearing = compBearing(pts, p1, p2);
+            }
+
+            if (compTrkPtMetrics(pTrk, pArgs, p1, p2, run, bearing)) {
+                p1 = p2;
+            }
+        }
+    }
+
+    free(queue.state);
+
+    return 0;
+}
+#endif  // _MSC_FULL_VER
+
+static int compMetrics(GpsTrk *pTrk, CmdArgs *pArgs)
+{
+    TrkPts *pts = &pTrk->trkPts;
+    int p1 = 0;     // previous TrkPt
+    int p2 = 1;     // current TrkPt
+    double runs[GEO_BATCH_SIZE];
+    double bearings[GEO_BATCH_SIZE];
+    int batchStart = 0; // position of the TrkPt of runs[0] and bearings[0]
+    int batchEnd = 0;   // position after the TrkPt of the last run/bearing
+
+    pTrk->minDeltaDTrkPt = pTrk->maxDeltaDTrkPt = -1;
+    pTrk->minDeltaTTrkPt = pTrk->maxDeltaTTrkPt = -1;
+
+#ifndef _MSC_FULL_VER
+    if ((pArgs->numThreads > 1) && (pts->count > (METRICS_CHUNK_SIZE + 1))) {
+        return compMetricsParallel(pTrk, pArgs, pArgs->numThreads);
+    }
+#endif  // _MSC_FULL_VER
+
+    // Compute the distance, elevation diff, speed, and grade
+    // between each pair of points...
+    while (p2 < pts->count) {
+        double run, bearing;
+
+        // The run and bearing between consecutive points
+        // are computed in batches, ahead of time.
+        if (p2 >= batchEnd) {
+            int numPts = pts->count - p2;
+            batchStart = p2;
+            batchEnd = p2 + ((numPts < GEO_BATCH_SIZE) ? numPts : GEO_BATCH_SIZE);
+            compRunsAndBearings(pts, batchStart, (batchEnd - batchStart), runs, bearings);
+        }
+
+        if (p1 == (p2 - 1)) {
+            run = runs[p2 - batchStart];
+            bearing = bearings[p2 - batchStart];
+        } else {
+            run = compDistance(pts, p1, p2);
+            bearing = compBearing(pts, p1, p2);
+        }
+
+        if (compTrkPtMetrics(pTrk, pArgs, p1, p2, run, bearing)) {
+            p1 = p2;
+        }
+        p2++;
+    }
+
+    return 0;
+}
+
+static void adjMaxGrade(GpsTrk *pTrk, CmdArgs *pArgs, int p1, int p2)
+{
+    TrkPts *pts = &pTrk->trkPts;
+    if (!pArgs->quiet) {
+        fprintf(stderr, "WARNING: TrkPt #%d (%s) has a grade of %.2lf%% that is above the max value %.2lf%% !\n",
+                pts->index[p2], fmtTrkPtIdx(pTrk, p2), pts->grade[p2], pArgs->maxGrade);
+    }
 
+    // Override original value with the max value
+    pts->grade[p2] = pArgs->maxGrade;
+
+    // Flag that this point had its grade adjusted
+    pts->flags[p2] |= TP_ADJ_GRADE;
+}
+
+static void adjMinGrade(GpsTrk *pTrk, CmdArgs *pArgs, int p1, int p2)
+{
+    TrkPts *pts = &pTrk->trkPts;
+    if (!pArgs->quiet) {
+        fprintf(stderr, "WARNING: TrkPt #%d (%s) has a grade of %.2lf%% that is below the min value %.2lf%% !\n",
+                pts->index[p2], fmtTrkPtIdx(pTrk, p2), pts->grade[p2], pArgs->minGrade);
+    }
+
+    // Override original value with the min value
+    pts->grade[p2] = pArgs->minGrade;
+
+    // Flag that this point had its grade adjusted
+    pts->flags[p2] |= TP_ADJ_GRADE;
+}
+
+static void adjGradeChange(GpsTrk *pTrk, CmdArgs *pArgs, int p1, int p2)
+{
+    TrkPts *pts = &pTrk->trkPts;
     if (!pArgs->quiet) {
-        fprintf(stderr, "WARNING: TrkPt #%d (%s) has a speed change of %.2lf%% that is above the limit %.2lf%% !\n",
-                p2->index, fmtTrkPtIdx(p2), p2->deltaS, pArgs->maxSpeedChange);
+        fprintf(stderr, "WARNING: TrkPt #%d (%s) has a grade change of %.2lf%% that is above the limit %.2lf%% !\n",
+                pts->index[p2], fmtTrkPtIdx(pTrk, p2), pts->deltaG[p2], pArgs->maxGradeChange);
     }
 
     // Override original value with the max value
-    if (p2->speed > p1->speed) {
-        p2->speed = p1->speed + maxSpeedChange;
+    if (pts->grade[p2] > pts->grade[p1]) {
+        pts->grade[p2] = pts->grade[p1] + pArgs->maxGradeChange;
     } else {
-        p2->speed = p1->speed - maxSpeedChange;
+        pts->grade[p2] = pts->grade[p1] - pArgs->maxGradeChange;
     }
+
+    // Flag that this point had its grade adjusted
+    pts->flags[p2] |= TP_ADJ_GRADE;
 }
-#endif
 
 #if 0
 // Given a fixed distance (dist) figure out what the
@@ -1025,23 +2134,24 @@ static void adjSpeedChange(GpsTrk *pTrk, CmdArgs *pArgs, TrkPt *p1, TrkPt *p2)
 //
 //   rise^2 = dist^2 / (1 + (1 / grade^2));
 //
-static void adjElevation(GpsTrk *pTrk, TrkPt *p1, TrkPt *p2)
+static void adjElevation(GpsTrk *pTrk, int p1, int p2)
 {
-    double grade = (p2->grade / 100.0); // desired grade in decimal (0.00 .. 1.00)
+    TrkPts *pts = &pTrk->trkPts;
+    double grade = (pts->grade[p2] / 100.0); // desired grade in decimal (0.00 .. 1.00)
     double grade2 = (grade * grade);    // grade squared
-    double dist2 = (p2->dist * p2->dist);   // dist squared
+    double dist2 = (pts->dist[p2] * pts->dist[p2]);   // dist squared
     double rise = sqrt(dist2 / (1.0 + (1.0 / grade2)));
     double adjElev;
 
-    if (p2->rise >= 0.0) {
-        p2->rise = rise;
+    if (pts->rise[p2] >= 0.0) {
+        pts->rise[p2] = rise;
     } else {
-        p2->rise = (0.0 - rise);
+        pts->rise[p2] = (0.0 - rise);
     }
-    adjElev = p1->elevation + p2->rise;
-    if (adjElev != p2->elevation) {
-        //fprintf(stderr, "%s: index=%d before=%.3lf after=%.3lf\n", __func__, p2->index, p2->elevation, adjElev);
-        p2->elevation = adjElev;
+    adjElev = pts->elevation[p1] + pts->rise[p2];
+    if (adjElev != pts->elevation[p2]) {
+        //fprintf(stderr, "%s: index=%d before=%.3lf after=%.3lf\n", __func__, pts->index[p2], pts->elevation[p2], adjElev);
+        pts->elevation[p2] = adjElev;
         pTrk->numElevAdj++;
     }
 }
@@ -1053,160 +2163,94 @@ static void adjElevation(GpsTrk *pTrk, TrkPt *p1, TrkPt *p2)
 //   rise = run * grade;
 //   dist = sqrt(run^2 + rise^2);
 //
-static void adjElevation(GpsTrk *pTrk, TrkPt *p1, TrkPt *p2)
+static void adjElevation(GpsTrk *pTrk, int p1, int p2)
 {
-    double run = p2->run;
-    double rise = run * (p2->grade / 100.0);
+    TrkPts *pts = &pTrk->trkPts;
+    double run = pts->run[p2];
+    double rise = run * (pts->grade[p2] / 100.0);
     double dist = sqrt((run * run) + (rise * rise));
     double adjElev;
 
-    adjElev = p1->elevation + rise;
-    if (adjElev != p2->elevation) {
-        //fprintf(stderr, "%s: index=%d before=%.3lf after=%.3lf\n", __func__, p2->index, p2->elevation, adjElev);
-        p2->rise = rise;
-        p2->dist = dist;
-        p2->elevation = adjElev;
-        //if (p2->deltaT != 0.0) {
-        //    p2->speed = (p2->dist / p2->deltaT);
+    adjElev = pts->elevation[p1] + rise;
+    if (adjElev != pts->elevation[p2]) {
+        //fprintf(stderr, "%s: index=%d before=%.3lf after=%.3lf\n", __func__, pts->index[p2], pts->elevation[p2], adjElev);
+        pts->rise[p2] = rise;
+        pts->dist[p2] = dist;
+        pts->elevation[p2] = adjElev;
+        //if (pts->deltaT[p2] != 0.0) {
+        //    pts->speed[p2] = (pts->dist[p2] / pts->deltaT[p2]);
         //}
         pTrk->numElevAdj++;
     }
 }
 #endif
 
-static int limitGrade(GpsTrk *pTrk, CmdArgs *pArgs)
+static void limitTrkPtGrade(GpsTrk *pTrk, CmdArgs *pArgs, int p1, int p2)
 {
-    TrkPt *p1 = TAILQ_FIRST(&pTrk->trkPtList);  // previous TrkPt
-    TrkPt *p2 = TAILQ_NEXT(p1, tqEntry);    // current TrkPt
-
-    while (p2 != NULL) {
-        // The following adjustments are done regardless
-        // of the --verbatim option, but only to the set
-        // of points in the specified range...
-        if (pointWithinRange(pArgs, p2)) {
-            // See if we need to limit the max grade values
-            if ((pArgs->maxGrade != nilGrade) && (p2->grade > pArgs->maxGrade)) {
-                adjMaxGrade(pTrk, pArgs, p1, p2);
-            }
-
-            // See if we need to limit the min grade values
-            if ((pArgs->minGrade != nilGrade) && (p2->grade < pArgs->minGrade)) {
-                adjMinGrade(pTrk, pArgs, p1, p2);
-            }
+    TrkPts *pts = &pTrk->trkPts;
 
-            // See if we need to limit the max grade change
-            if ((pArgs->maxGradeChange != 0.0) && (p2->deltaG > pArgs->maxGradeChange)) {
-                adjGradeChange(pTrk, pArgs, p1, p2);
-            }
-        }
+    // See if we need to limit the max grade values
+    if ((pArgs->maxGrade != nilGrade) && (pts->grade[p2] > pArgs->maxGrade)) {
+        adjMaxGrade(pTrk, pArgs, p1, p2);
+    }
 
-        p2 = nxtTrkPt(&p1, p2);
+    // See if we need to limit the min grade values
+    if ((pArgs->minGrade != nilGrade) && (pts->grade[p2] < pArgs->minGrade)) {
+        adjMinGrade(pTrk, pArgs, p1, p2);
     }
 
-    return 0;
+    // See if we need to limit the max grade change
+    if ((pArgs->maxGradeChange != 0.0) && (pts->deltaG[p2] > pArgs->maxGradeChange)) {
+        adjGradeChange(pTrk, pArgs, p1, p2);
+    }
 }
 
-static int adjElev(GpsTrk *pTrk, CmdArgs *pArgs)
+static int limitGrade(GpsTrk *pTrk, CmdArgs *pArgs)
 {
-    TrkPt *p1 = TAILQ_FIRST(&pTrk->trkPtList);  // previous TrkPt
-    TrkPt *p2 = TAILQ_NEXT(p1, tqEntry);    // current TrkPt
-
-    while (p2 != NULL) {
-        // The following adjustments are done regardless
-        // of the --verbatim option, but only to the set
-        // of points in the specified range...
-        if (pointWithinRange(pArgs, p2)) {
-            if (p2->adjGrade) {
-                adjElevation(pTrk, p1, p2);
-            }
-        }
-
-        p2 = nxtTrkPt(&p1, p2);
+    int p1;         // previous TrkPt
+    int p2;         // current TrkPt
+    int end;        // end of the range
+
+    // The following adjustments are done regardless
+    // of the --verbatim option, but only to the set
+    // of points in the specified range...
+    getTrkPtRange(pTrk, pArgs, &p2, &end);
+    p1 = p2 - 1;
+
+    while (p2 < end) {
+        limitTrkPtGrade(pTrk, pArgs, p1, p2);
+        p1 = p2++;
     }
 
     return 0;
 }
 
-#if 0
-static int compDataPhase2(GpsTrk *pTrk, CmdArgs *pArgs)
+static int adjElev(GpsTrk *pTrk, CmdArgs *pArgs)
 {
-    TrkPt *p1 = TAILQ_FIRST(&pTrk->trkPtList);  // previous TrkPt
-    TrkPt *p2 = TAILQ_NEXT(p1, tqEntry);    // current TrkPt
-
-    while (p2 != NULL) {
-        // The following adjustments are done regardless
-        // of the --verbatim option, but only to the set
-        // of points in the specified range...
-        if (pointWithinRange(pArgs, p2)) {
-            // Do we need to smooth out any values, other
-            // than elevation (which we already did) ?
-            if ((pArgs->xmaWindow != 0) && (pArgs->xmaMetric != elevation)) {
-                compMovAvg(pTrk, p2, pArgs->xmaMethod, pArgs->xmaMetric, pArgs->xmaWindow);
-            }
-
-            // See if we need to limit the max grade values
-            if ((pArgs->maxGrade != 0.0) && (p2->grade > pArgs->maxGrade)) {
-                adjMaxGrade(pTrk, pArgs, p1, p2);
-            }
-
-            // See if we need to limit the min grade values
-            if ((pArgs->minGrade != 0.0) && (p2->grade < pArgs->minGrade)) {
-                adjMinGrade(pTrk, pArgs, p1, p2);
-            }
-
-            // See if we need to limit the max grade change
-            p2->deltaG = fabs(p2->grade - p1->grade);
-            if ((pArgs->maxGradeChange != 0.0) && (p2->deltaG > pArgs->maxGradeChange)) {
-                adjGradeChange(pTrk, pArgs, p1, p2);
-            }
-
-            // Update the max grade change
-            if (p2->deltaG > pTrk->maxDeltaG) {
-                pTrk->maxDeltaG = p2->deltaG;
-                pTrk->maxDeltaGTrkPt = p2;
-            }
-
-            // See if we need to limit the max speed change
-            p2->deltaS = (fabs(p2->speed - p1->speed) / fabs(p1->speed)) * 100.0;
-            if ((pArgs->maxSpeedChange != 0.0) && (p2->deltaS > pArgs->maxSpeedChange)) {
-                adjSpeedChange(pTrk, pArgs, p1, p2);
-            }
-        }
-
-        // If necessary, correct the elevation value based
-        // on the adjusted grade value.
-        if (!pArgs->noElevAdj && p2->adjGrade) {
+    TrkPts *pts = &pTrk->trkPts;
+    int p1;         // previous TrkPt
+    int p2;         // current TrkPt
+    int end;        // end of the range
+
+    // The following adjustments are done regardless
+    // of the --verbatim option, but only to the set
+    // of points in the specified range...
+    getTrkPtRange(pTrk, pArgs, &p2, &end);
+    p1 = p2 - 1;
+
+    while (p2 < end) {
+        if (pts->flags[p2] & TP_ADJ_GRADE) {
             adjElevation(pTrk, p1, p2);
         }
 
-        // Update the rolling elevation gain/loss values
-        if (p2->rise >= 0.0) {
-            pTrk->elevGain += p2->rise;
-        } else {
-            pTrk->elevLoss += fabs(p2->rise);
-        }
-
-        // Update the rolling cadence, grade, heart rate,
-        // power, and temp values used to compute the
-        // averages for the activity.
-        pTrk->cadence += p2->cadence;
-        pTrk->grade += p2->grade;
-        pTrk->heartRate += p2->heartRate;
-        pTrk->power += p2->power;
-        pTrk->temp += p2->ambTemp;
-
-        p2 = nxtTrkPt(&p1, p2);
+        p1 = p2++;
     }
 
     return 0;
 }
-#endif
 
-static int compMinMax(GpsTrk *pTrk, CmdArgs *pArgs)
+static void initMinMax(GpsTrk *pTrk)
 {
-    TrkPt *p1 = TAILQ_FIRST(&pTrk->trkPtList);  // previous TrkPt
-    TrkPt *p2 = TAILQ_NEXT(p1, tqEntry);    // current TrkPt
-
     pTrk->minCadence = +999;
     pTrk->maxCadence = -999;
     pTrk->minHeartRate = +999;
@@ -1222,105 +2266,462 @@ static int compMinMax(GpsTrk *pTrk, CmdArgs *pArgs)
     pTrk->minGrade = +99.9;
     pTrk->maxGrade = -99.9;
 
-    while (p2 != NULL) {
-        // Update the min/max values
-        if (pTrk->inMask & SD_CADENCE) {
-            if (p2->cadence > pTrk->maxCadence) {
-                 pTrk->maxCadence = p2->cadence;
-                 pTrk->maxCadenceTrkPt = p2;
-            } else if ((p2->cadence != 0) && (p2->cadence < pTrk->minCadence)) {
-                pTrk->minCadence = p2->cadence;
-                pTrk->minCadenceTrkPt = p2;
-            }
-        }
+    pTrk->minCadenceTrkPt = pTrk->maxCadenceTrkPt = -1;
+    pTrk->minHeartRateTrkPt = pTrk->maxHeartRateTrkPt = -1;
+    pTrk->minPowerTrkPt = pTrk->maxPowerTrkPt = -1;
+    pTrk->minSpeedTrkPt = pTrk->maxSpeedTrkPt = -1;
+    pTrk->minTempTrkPt = pTrk->maxTempTrkPt = -1;
+    pTrk->minElevTrkPt = pTrk->maxElevTrkPt = -1;
+    pTrk->minGradeTrkPt = pTrk->maxGradeTrkPt = -1;
+    pTrk->maxDeltaGTrkPt = -1;
+}
 
-        if (pTrk->inMask & SD_HR) {
-            if (p2->heartRate > pTrk->maxHeartRate) {
-                 pTrk->maxHeartRate = p2->heartRate;
-                 pTrk->maxHeartRateTrkPt = p2;
-            } else if ((p2->heartRate != 0) && (p2->heartRate < pTrk->minHeartRate)) {
-                pTrk->minHeartRate = p2->heartRate;
-                pTrk->minHeartRateTrkPt = p2;
-            }
+static void updMinMax(GpsTrk *pTrk, int p2)
+{
+    TrkPts *pts = &pTrk->trkPts;
+
+    // Update the min/max values
+    if (pTrk->inMask & SD_CADENCE) {
+        if (pts->cadence[p2] > pTrk->maxCadence) {
+             pTrk->maxCadence = pts->cadence[p2];
+             pTrk->maxCadenceTrkPt = p2;
+        } else if ((pts->cadence[p2] != 0) && (pts->cadence[p2] < pTrk->minCadence)) {
+            pTrk->minCadence = pts->cadence[p2];
+            pTrk->minCadenceTrkPt = p2;
         }
+    }
 
-        if (pTrk->inMask & SD_POWER) {
-            if (p2->power > pTrk->maxPower) {
-                 pTrk->maxPower = p2->power;
-                 pTrk->maxPowerTrkPt = p2;
-            } else if ((p2->power != 0) && (p2->power < pTrk->minPower)) {
-                pTrk->minPower = p2->power;
-                pTrk->minPowerTrkPt = p2;
-            }
+    if (pTrk->inMask & SD_HR) {
+        if (pts->heartRate[p2] > pTrk->maxHeartRate) {
+             pTrk->maxHeartRate = pts->heartRate[p2];
+             pTrk->maxHeartRateTrkPt = p2;
+        } else if ((pts->heartRate[p2] != 0) && (pts->heartRate[p2] < pTrk->minHeartRate)) {
+            pTrk->minHeartRate = pts->heartRate[p2];
+            pTrk->minHeartRateTrkPt = p2;
         }
+    }
 
-        if (p2->speed > pTrk->maxSpeed) {
-             pTrk->maxSpeed = p2->speed;
-             pTrk->maxSpeedTrkPt = p2;
-        } else if ((p2->speed != 0) && (p2->speed < pTrk->minSpeed)) {
-            pTrk->minSpeed = p2->speed;
-            pTrk->minSpeedTrkPt = p2;
+    if (pTrk->inMask & SD_POWER) {
+        if (pts->power[p2] > pTrk->maxPower) {
+             pTrk->maxPower = pts->power[p2];
+             pTrk->maxPowerTrkPt = p2;
+        } else if ((pts->power[p2] != 0) && (pts->power[p2] < pTrk->minPower)) {
+            pTrk->minPower = pts->power[p2];
+            pTrk->minPowerTrkPt = p2;
         }
+    }
 
-        if (pTrk->inMask & SD_ATEMP) {
-            if (p2->ambTemp > pTrk->maxTemp) {
-                 pTrk->maxTemp = p2->ambTemp;
-                 pTrk->maxTempTrkPt = p2;
-            } else if (p2->ambTemp < pTrk->minTemp) {
-                pTrk->minTemp = p2->ambTemp;
-                pTrk->minTempTrkPt = p2;
-            }
+    if (pts->speed[p2] > pTrk->maxSpeed) {
+         pTrk->maxSpeed = pts->speed[p2];
+         pTrk->maxSpeedTrkPt = p2;
+    } else if ((pts->speed[p2] != 0) && (pts->speed[p2] < pTrk->minSpeed)) {
+        pTrk->minSpeed = pts->speed[p2];
+        pTrk->minSpeedTrkPt = p2;
+    }
+
+    if (pTrk->inMask & SD_ATEMP) {
+        if (pts->ambTemp[p2] > pTrk->maxTemp) {
+             pTrk->maxTemp = pts->ambTemp[p2];
+             pTrk->maxTempTrkPt = p2;
+        } else if (pts->ambTemp[p2] < pTrk->minTemp) {
+            pTrk->minTemp = pts->ambTemp[p2];
+            pTrk->minTempTrkPt = p2;
         }
+    }
+
+    if (pts->elevation[p2] > pTrk->maxElev) {
+         pTrk->maxElev = pts->elevation[p2];
+         pTrk->maxElevTrkPt = p2;
+    } else if (pts->elevation[p2] < pTrk->minElev) {
+        pTrk->minElev = pts->elevation[p2];
+        pTrk->minElevTrkPt = p2;
+    }
+
+    if (pts->grade[p2] > pTrk->maxGrade) {
+         pTrk->maxGrade = pts->grade[p2];
+         pTrk->maxGradeTrkPt = p2;
+    } else if (pts->grade[p2] < pTrk->minGrade) {
+        pTrk->minGrade = pts->grade[p2];
+        pTrk->minGradeTrkPt = p2;
+    }
+
+    // Update the max grade change
+    if (pts->deltaG[p2] > pTrk->maxDeltaG) {
+        pTrk->maxDeltaG = pts->deltaG[p2];
+        pTrk->maxDeltaGTrkPt = p2;
+    }
+
+    // Update the rolling elevation gain/loss values
+    if (pts->rise[p2] >= 0.0) {
+        pTrk->elevGain += pts->rise[p2];
+    } else {
+        pTrk->elevLoss += fabs(pts->rise[p2]);
+    }
+
+    // Update the rolling cadence, grade, heart rate,
+    // power, and temp values used to compute the
+    // averages for the activity.
+    pTrk->cadence += pts->cadence[p2];
+    pTrk->grade += pts->grade[p2];
+    pTrk->heartRate += pts->heartRate[p2];
+    pTrk->power += pts->power[p2];
+    pTrk->temp += pts->ambTemp[p2];
+}
+
+static int compMinMax(GpsTrk *pTrk, CmdArgs *pArgs)
+{
+    TrkPts *pts = &pTrk->trkPts;
+    int p2;         // current TrkPt
+
+    initMinMax(pTrk);
+
+    for (p2 = 1; p2 < pts->count; p2++) {
+        updMinMax(pTrk, p2);
+    }
+
+    return 0;
+}
+
+// Run all the processing stages over the TrkPt's, one stage
+// at a time.
+static int procTrkPts(GpsTrk *pTrk, CmdArgs *pArgs)
+{
+    // If the user requested to trim out a range of TrkPt's
+    // do it now...
+    if (pArgs->trimFrom) {
+        trimTrkPts(pTrk, pArgs);
+        compactTrkPts(pTrk);
+    }
+
+    // Now run some consistency checks on all the TrkPt's
+    if (checkTrkPts(pTrk, pArgs) != 0) {
+        fprintf(stderr, "Failed to delete TrkPt's\n");
+        return -1;
+    }
+    compactTrkPts(pTrk);
+
+    // At this point pTrk->trkPts contains all the track
+    // points from all the GPX/TCX/FIT input files...
+
+    if (pArgs->closeGap) {
+        // Close the time gap at the specified track
+        // point.
+        closeTimeGap(pTrk, pArgs);
+    }
+
+    // If requested, smooth out the elevation values before
+    // we compute the speed and grade, so as to minimize the
+    // computational errors.
+    smoothMetrics(pTrk, pArgs, true);
+
+    // Compute metrics
+    if (compMetrics(pTrk, pArgs) != 0) {
+        fprintf(stderr, "Failed to compute speed/grade!\n");
+        return -1;
+    }
+    compactTrkPts(pTrk);
+
+    // If requested, limit the max/min grade values
+    if ((pArgs->maxGrade != nilGrade) ||
+        (pArgs->minGrade != nilGrade) ||
+        (pArgs->maxGradeChange != 0)) {
+        limitGrade(pTrk, pArgs);
+    }
+
+    // If requested, smooth out the specified metrics
+    smoothMetrics(pTrk, pArgs, false);
+
+    // If needed, adjust the elevation values
+    if (!pArgs->noElevAdj) {
+        adjElev(pTrk, pArgs);
+    }
+
+    // Compute min/max values
+    compMinMax(pTrk, pArgs);
+
+    return 0;
+}
+
+// Number of TrkPt's checked at a time by the fused pipeline
+#define FUSED_CHUNK_SIZE    1024
+
+// State of the fused pipeline, which runs all the stages of
+// procTrkPts() in a single pass over the track. Each stage
+// follows right behind the stage before it: the stages that
+// only need the previous TrkPt (checks, metrics, grade limits,
+// elevation adjustments, and min/max values) keep track of it,
+// while the SMA/WMA stages, which need to look ahead, have
+// their own bounded buffers. The TrkPt's that are discarded by
+// the checks are dropped on the fly, so all the other stages
+// see the same positions as they do in procTrkPts().
+typedef struct FusedPipe {
+    GpsTrk *pTrk;           // track being processed
+    CmdArgs *pArgs;         // command args
+    int trimEnd;            // first TrkPt after the trimmed out range, or -1
+    double trimmedTime;     // time trimmed out
+    double trimmedDistance; // distance trimmed out
+    int numChecked;         // number of TrkPt's that passed the checks
+    int numReleased;        // number of TrkPt's released by the check stage
+    Bool closingGap;        // closing the time gap
+    double timeGap;         // time gap being closed
+    Bool smoothElev;        // smooth out the elevation values
+    XmaStream elevXma;      // SMA/WMA of the elevation values
+    int metricsP1;          // previous TrkPt of the metrics stage, or -1
+    int batchStart;         // position of the TrkPt of runs[0] and bearings[0]
+    int batchEnd;           // position after the TrkPt of the last run/bearing
+    double runs[GEO_BATCH_SIZE];
+    double bearings[GEO_BATCH_SIZE];
+    int limitP1;            // previous TrkPt of the grade limit stage
+    int numLimited;         // number of TrkPt's that went through the grade limit stage
+    Bool smoothOther;       // smooth out the other metrics
+    XmaStream otherXma;     // SMA/WMA of the other metrics
+    int finalP1;            // previous TrkPt of the final stage
+    int numFinal;           // number of TrkPt's that went through the final stage
+} FusedPipe;
+
+// Final stage: adjust the elevation values, and update the
+// min/max values.
+static void fusedFinal(FusedPipe *pPipe, int p2)
+{
+    GpsTrk *pTrk = pPipe->pTrk;
+    CmdArgs *pArgs = pPipe->pArgs;
+    int ordinal = pPipe->numFinal++;
+
+    if (!pArgs->noElevAdj && trkPtInRange(pTrk, pArgs, p2, ordinal) &&
+        (pTrk->trkPts.flags[p2] & TP_ADJ_GRADE)) {
+        adjElevation(pTrk, pPipe->finalP1, p2);
+    }
+
+    if (ordinal >= 1) {
+        updMinMax(pTrk, p2);
+    }
+
+    pPipe->finalP1 = p2;
+}
+
+// Grade limit stage, followed by the SMA/WMA of the metrics
+// other than the elevation.
+static void fusedLimit(FusedPipe *pPipe, int p2)
+{
+    int ordinal = pPipe->numLimited++;
+
+    if (trkPtInRange(pPipe->pTrk, pPipe->pArgs, p2, ordinal)) {
+        limitTrkPtGrade(pPipe->pTrk, pPipe->pArgs, pPipe->limitP1, p2);
+    }
+    pPipe->limitP1 = p2;
+
+    if (!pPipe->smoothOther) {
+        fusedFinal(pPipe, p2);
+        return;
+    }
+
+    xmaStreamFeed(&pPipe->otherXma, p2);
+    while ((p2 = xmaStreamNext(&pPipe->otherXma)) != -1) {
+        fusedFinal(pPipe, p2);
+    }
+}
+
+// Metrics stage. Each TrkPt is held back from the grade limit
+// stage until the metrics of the TrkPt that follows it have
+// been computed, as they depend on its original grade value.
+static void fusedMetrics(FusedPipe *pPipe, int p2)
+{
+    TrkPts *pts = &pPipe->pTrk->trkPts;
+    int p1 = pPipe->metricsP1;
+    double run, bearing;
+
+    if (p1 == -1) {
+        // This is the reference point
+        pPipe->metricsP1 = p2;
+        return;
+    }
+
+    // The run and bearing between consecutive points are
+    // computed in batches, up to the last TrkPt that passed
+    // the checks.
+    if (p2 >= pPipe->batchEnd) {
+        int numPts = pPipe->numChecked - p2;
+        pPipe->batchStart = p2;
+        pPipe->batchEnd = p2 + ((numPts < GEO_BATCH_SIZE) ? numPts : GEO_BATCH_SIZE);
+        compRunsAndBearings(pts, pPipe->batchStart, (pPipe->batchEnd - pPipe->batchStart), pPipe->runs, pPipe->bearings);
+    }
+
+    if (p1 == (p2 - 1)) {
+        run = pPipe->runs[p2 - pPipe->batchStart];
+        bearing = pPipe->bearings[p2 - pPipe->batchStart];
+    } else {
+        run = compDistance(pts, p1, p2);
+        bearing = compBearing(pts, p1, p2);
+    }
+
+    if (compTrkPtMetrics(pPipe->pTrk, pPipe->pArgs, p1, p2, run, bearing)) {
+        pPipe->metricsP1 = p2;
+        fusedLimit(pPipe, p1);
+    }
+}
+
+// Close the time gap, if needed, and feed the TrkPt to the
+// SMA/WMA of the elevation values.
+static void fusedRelease(FusedPipe *pPipe, int p2)
+{
+    TrkPts *pts = &pPipe->pTrk->trkPts;
+    CmdArgs *pArgs = pPipe->pArgs;
 
-        if (p2->elevation > pTrk->maxElev) {
-             pTrk->maxElev = p2->elevation;
-             pTrk->maxElevTrkPt = p2;
-        } else if (p2->elevation < pTrk->minElev) {
-            pTrk->minElev = p2->elevation;
-            pTrk->minElevTrkPt = p2;
+    if ((pArgs->closeGap != 0) && (pts->index[p2] == pArgs->closeGap) && (p2 >= 1)) {
+        pPipe->timeGap = timeToSec(pts->timestamp[p2]) - timeToSec(pts->timestamp[p2 - 1]) - 1;
+        if (!pArgs->quiet) {
+            fprintf(stderr, "INFO: Closing %.3lf s time gap at TrkPt #%u\n", pPipe->timeGap, pts->index[p2]);
         }
+        pPipe->closingGap = true;
+    }
+
+    if (pPipe->closingGap) {
+        pts->timestamp[p2] -= secToTime(pPipe->timeGap);
+    }
+
+    if (!pPipe->smoothElev) {
+        fusedMetrics(pPipe, p2);
+        return;
+    }
+
+    xmaStreamFeed(&pPipe->elevXma, p2);
+    while ((p2 = xmaStreamNext(&pPipe->elevXma)) != -1) {
+        fusedMetrics(pPipe, p2);
+    }
+}
 
-        if (p2->grade > pTrk->maxGrade) {
-             pTrk->maxGrade = p2->grade;
-             pTrk->maxGradeTrkPt = p2;
-        } else if (p2->grade < pTrk->minGrade) {
-            pTrk->minGrade = p2->grade;
-            pTrk->minGradeTrkPt = p2;
+// Check stage: close the gap left by the trimmed out TrkPt's,
+// run the consistency checks on the TrkPt, and move it down
+// to its position in the compacted track.
+static int fusedCheck(FusedPipe *pPipe, int p)
+{
+    GpsTrk *pTrk = pPipe->pTrk;
+    TrkPts *pts = &pTrk->trkPts;
+    int q = pPipe->numChecked;
+    int discTrkPt;
+
+    if (!(pts->flags[p] & TP_DELETED)) {
+        if ((pPipe->trimEnd != -1) && (p >= pPipe->trimEnd)) {
+            pts->timestamp[p] -= secToTime(pPipe->trimmedTime);
+            pts->distance[p] -= pPipe->trimmedDistance;
         }
 
-        // Update the max grade change
-        if (p2->deltaG > pTrk->maxDeltaG) {
-            pTrk->maxDeltaG = p2->deltaG;
-            pTrk->maxDeltaGTrkPt = p2;
+        // The first TrkPt is the reference point
+        if (q != 0) {
+            if ((discTrkPt = checkTrkPt(pTrk, pPipe->pArgs, (q - 1), p)) < 0) {
+                return -1;
+            } else if (discTrkPt) {
+                delTrkPt(pTrk, p);
+            }
         }
+    }
 
-        // Update the rolling elevation gain/loss values
-        if (p2->rise >= 0.0) {
-            pTrk->elevGain += p2->rise;
+    if (moveTrkPt(pTrk, q, p)) {
+        pPipe->numChecked++;
+    }
+
+    return 0;
+}
+
+// Run all the stages of procTrkPts() in a single pass over
+// the track. The output data is the same, but as the stages
+// are interleaved, so are their warning and info messages.
+static int procTrkPtsFused(GpsTrk *pTrk, CmdArgs *pArgs)
+{
+    TrkPts *pts = &pTrk->trkPts;
+    FusedPipe pipe = {0};
+    FusedPipe *pPipe = &pipe;
+    XmaSpec specs[XMA_MAX_METRICS];
+    int numSpecs;
+    int numPts = pts->count;
+    int status = 0;
+    int p;
+
+    pPipe->pTrk = pTrk;
+    pPipe->pArgs = pArgs;
+    pPipe->trimEnd = -1;
+    pPipe->metricsP1 = -1;
+
+    if ((numSpecs = getXmaSpecs(pArgs, true, specs)) != 0) {
+        if (xmaStreamInit(&pPipe->elevXma, pTrk, pArgs, specs, numSpecs) != 0) {
+            return -1;
+        }
+        pPipe->smoothElev = true;
+    }
+    if ((numSpecs = getXmaSpecs(pArgs, false, specs)) != 0) {
+        if (xmaStreamInit(&pPipe->otherXma, pTrk, pArgs, specs, numSpecs) != 0) {
+            status = -1;
         } else {
-            pTrk->elevLoss += fabs(p2->rise);
+            pPipe->smoothOther = true;
         }
+    }
 
-        // Update the rolling cadence, grade, heart rate,
-        // power, and temp values used to compute the
-        // averages for the activity.
-        pTrk->cadence += p2->cadence;
-        pTrk->grade += p2->grade;
-        pTrk->heartRate += p2->heartRate;
-        pTrk->power += p2->power;
-        pTrk->temp += p2->ambTemp;
+    // If the user requested to trim out a range of TrkPt's
+    // mark them for deletion: the check stage drops them.
+    if ((status == 0) && pArgs->trimFrom) {
+        pPipe->trimEnd = markTrimTrkPts(pTrk, pArgs, &pPipe->trimmedTime, &pPipe->trimmedDistance);
+    }
 
-        p2 = nxtTrkPt(&p1, p2);
+    pTrk->minDeltaDTrkPt = pTrk->maxDeltaDTrkPt = -1;
+    pTrk->minDeltaTTrkPt = pTrk->maxDeltaTTrkPt = -1;
+    initMinMax(pTrk);
+
+    for (p = 0; (status == 0) && (p < numPts); p++) {
+        status = fusedCheck(pPipe, p);
+
+        // The TrkPt's are released by the check stage in
+        // chunks, so the metrics stage can compute the runs
+        // and bearings in batches. The last TrkPt checked is
+        // always held back, as the checks of the next TrkPt
+        // need its original timestamp.
+        if ((status == 0) && ((p % FUSED_CHUNK_SIZE) == (FUSED_CHUNK_SIZE - 1))) {
+            while (pPipe->numReleased < (pPipe->numChecked - 1)) {
+                fusedRelease(pPipe, pPipe->numReleased++);
+            }
+        }
     }
 
-    return 0;
+    if (status == 0) {
+        // Flush all the stages
+        pts->count = pPipe->numChecked;
+        while (pPipe->numReleased < pPipe->numChecked) {
+            fusedRelease(pPipe, pPipe->numReleased++);
+        }
+        if (pPipe->smoothElev) {
+            xmaStreamEnd(&pPipe->elevXma);
+            while ((p = xmaStreamNext(&pPipe->elevXma)) != -1) {
+                fusedMetrics(pPipe, p);
+            }
+        }
+        if (pPipe->metricsP1 != -1) {
+            fusedLimit(pPipe, pPipe->metricsP1);
+        }
+        if (pPipe->smoothOther) {
+            xmaStreamEnd(&pPipe->otherXma);
+            while ((p = xmaStreamNext(&pPipe->otherXma)) != -1) {
+                fusedFinal(pPipe, p);
+            }
+        }
+
+        // Remove the TrkPt's discarded by the metrics stage
+        compactTrkPts(pTrk);
+    }
+
+    if (pPipe->smoothElev) {
+        xmaStreamFree(&pPipe->elevXma);
+    }
+    if (pPipe->smoothOther) {
+        xmaStreamFree(&pPipe->otherXma);
+    }
+
+    return status;
 }
 
 int main(int argc, char **argv)
 {
     CmdArgs cmdArgs = {0};
     GpsTrk gpsTrk = {0};
-    TrkPt *pTrkPt;
+    TrkPts *pts = &gpsTrk.trkPts;
     int n;
 
     // Parse the command arguments
@@ -1328,58 +2729,38 @@ int main(int argc, char **argv)
         return -1;
     }
 
-    TAILQ_INIT(&gpsTrk.trkPtList);
-
     // Process each FIT/GPX/TCX input file
-    while (n < argc) {
-        const char *fileSuffix;
-        int s;
-        cmdArgs.inFile = argv[n++];
-        if ((fileSuffix = strrchr(cmdArgs.inFile, '.')) == NULL) {
-            fprintf(stderr, "Unsupported input file %s\n", cmdArgs.inFile);
-            return -1;
-        }
-        if (strcmp(fileSuffix, ".csv") == 0) {
-            s = parseCsvFile(&cmdArgs, &gpsTrk, cmdArgs.inFile);
-        } else if (strcmp(fileSuffix, ".fit") == 0) {
-            s = parseFitFile(&cmdArgs, &gpsTrk, cmdArgs.inFile);
-        } else if (strcmp(fileSuffix, ".gpx") == 0) {
-            s = parseGpxFile(&cmdArgs, &gpsTrk, cmdArgs.inFile);
-        } else if (strcmp(fileSuffix, ".tcx") == 0) {
-            s = parseTcxFile(&cmdArgs, &gpsTrk, cmdArgs.inFile);
-        } else {
-            fprintf(stderr, "Unsupported input file %s\n", cmdArgs.inFile);
-            return -1;
-        }
-        if (s != 0) {
-            fprintf(stderr, "Failed to parse input file %s\n", cmdArgs.inFile);
-            return -1;
-        }
-        cmdArgs.inFile = NULL;
+    if (parseInFiles(&cmdArgs, &gpsTrk, (argc - n), &argv[n]) != 0) {
+        return -1;
     }
 
     // Done parsing all the input files. Make sure we have
     // at least one TrkPt!
-    if ((pTrkPt = TAILQ_FIRST(&gpsTrk.trkPtList)) == NULL) {
+    if (pts->count == 0) {
         // Hu?
         fprintf(stderr, "No track points found!\n");
         return -1;
     }
 
+    // Build the table used to look up the TrkPt's by index
+    if (indexTrkPts(&gpsTrk) != 0) {
+        return -1;
+    }
+
     // The first point is used as the reference point, so we
     // must check a few things before we proceed...
 
-    if (pTrkPt->elevation == nilElev) {
+    if (pts->elevation[0] == nilElev) {
         // If the first TrkPt is missing its elevation data,
         // as is the case with some GPX/TCX files exported by
         // some tools, the grade value of the second TrkPt
         // will be huge...
         fprintf(stderr, "ERROR: TrkPt #%d (%s) is missing its elevation data !\n",
-                pTrkPt->index, fmtTrkPtIdx(pTrkPt));
+                pts->index[0], fmtTrkPtIdx(&gpsTrk, 0));
         return -1;
     }
 
-    if (pTrkPt->timestamp == 0.0) {
+    if (pts->timestamp[0] == 0) {
         // TrkPt has no time information, likely because this is
         // a GPX/TCX route, and not an actual GPX/TCX activity.
         // In this case we need to have a start time and a set
@@ -1387,87 +2768,59 @@ int main(int argc, char **argv)
         // timestamps that turn the route into a ride.
         if ((cmdArgs.startTime == 0) || (cmdArgs.setSpeed == 0.0)) {
             fprintf(stderr, "TrkPt #%d (%s) is missing time information and no startTime or setSpeed has been specified to turn a route into an activity!\n",
-                    pTrkPt->index, fmtTrkPtIdx(pTrkPt));
+                    pts->index[0], fmtTrkPtIdx(&gpsTrk, 0));
             return -1;
         }
 
         // Set the timestamp of the first point to the desired
         // start time of the ride (activity).
-        pTrkPt->timestamp = cmdArgs.startTime;
+        pts->timestamp[0] = secToTime(cmdArgs.startTime);
     } else if (cmdArgs.startTime != 0.0) {
         // We are changing the start date/time of the activity
         // so set the time offset used to adjust the timestamp
         // of each point accordingly.
-        gpsTrk.timeOffset = cmdArgs.startTime - pTrkPt->timestamp;
+        gpsTrk.timeOffset = cmdArgs.startTime - timeToSec(pts->timestamp[0]);
     }
 
-    // If the user requested to trim out a range of TrkPt's
-    // do it now...
-    if (cmdArgs.trimFrom) {
-        pTrkPt = trimTrkPts(&gpsTrk, &cmdArgs);
+    // If the range of TrkPt's to trim out and/or to process
+    // was specified by time or distance, find the actual
+    // TrkPt's in the range...
+    if ((cmdArgs.trimUnits != byIndex) &&
+        (getTrkPtSpan(&gpsTrk, &cmdArgs, "trim", cmdArgs.trimUnits, cmdArgs.trimStart, cmdArgs.trimEnd,
+                      &cmdArgs.trimFrom, &cmdArgs.trimTo) != 0)) {
+        cmdArgs.trimFrom = cmdArgs.trimTo = 0;
+    }
+    if ((cmdArgs.rangeUnits != byIndex) &&
+        (getTrkPtSpan(&gpsTrk, &cmdArgs, "range", cmdArgs.rangeUnits, cmdArgs.rangeStart, cmdArgs.rangeEnd,
+                      &cmdArgs.rangeFrom, &cmdArgs.rangeTo) != 0)) {
+        // Empty range: no TrkPt has a negative index
+        cmdArgs.rangeFrom = cmdArgs.rangeTo = -1;
     }
 
-    // Now run some consistency checks on all the TrkPt's
-    if (checkTrkPts(&gpsTrk, &cmdArgs) != 0) {
-        fprintf(stderr, "Failed to delete TrkPt's\n");
+    // Process the TrkPt's, either one stage at a time, or
+    // with all the stages fused in a single pass.
+    if (cmdArgs.fused) {
+        if (procTrkPtsFused(&gpsTrk, &cmdArgs) != 0) {
+            fprintf(stderr, "Failed to process the TrkPt's!\n");
+            return -1;
+        }
+    } else if (procTrkPts(&gpsTrk, &cmdArgs) != 0) {
         return -1;
     }
 
     // Set the activity's start time
-    gpsTrk.startTime = pTrkPt->timestamp;
+    gpsTrk.startTime = timeToSec(pts->timestamp[0]);
 
     // Set the base distance reference used to generate
     // relative distance values.
-    gpsTrk.baseDistance = pTrkPt->distance;
+    gpsTrk.baseDistance = pts->distance[0];
 
     // If necessary, set the base time reference used to
     // generate relative timestamps in the CSV output data.
     if (cmdArgs.tsFmt != utc) {
-        gpsTrk.baseTime = pTrkPt->timestamp;
-    }
-
-    // At this point gpsTrk.trkPtList contains all the track
-    // points from all the GPX/TCX/FIT input files...
-
-    if (cmdArgs.closeGap) {
-        // Close the time gap at the specified track
-        // point.
-        closeTimeGap(&gpsTrk, &cmdArgs);
-    }
-
-    // If requested, smooth out the elevation values before
-    // we compute the speed and grade, so as to minimize the
-    // computational errors.
-    if ((cmdArgs.xmaWindow != 0) && (cmdArgs.xmaMetric == elevation)) {
-        smoothMetric(&gpsTrk, &cmdArgs);
-    }
-
-    // Compute metrics
-    if (compMetrics(&gpsTrk, &cmdArgs) != 0) {
-        fprintf(stderr, "Failed to compute speed/grade!\n");
-        return -1;
-    }
-
-    // If requested, limit the max/min grade values
-    if ((cmdArgs.maxGrade != nilGrade) ||
-        (cmdArgs.minGrade != nilGrade) ||
-        (cmdArgs.maxGradeChange != 0)) {
-        limitGrade(&gpsTrk, &cmdArgs);
-    }
-
-    // If requested, smooth out the specified metric
-    if ((cmdArgs.xmaWindow != 0) && (cmdArgs.xmaMetric != elevation)) {
-        smoothMetric(&gpsTrk, &cmdArgs);
-    }
-
-    // If needed, adjust the elevation values
-    if (!cmdArgs.noElevAdj) {
-        adjElev(&gpsTrk, &cmdArgs);
+        gpsTrk.baseTime = timeToSec(pts->timestamp[0]);
     }
 
-    // Compute min/max values
-    compMinMax(&gpsTrk, &cmdArgs);
-
     // Generate the output data
     printOutput(&gpsTrk, &cmdArgs);
 
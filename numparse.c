@@ -0,0 +1,396 @@
+/*=========================================================================
+ *
+ *   Filename:           numparse.c
+ *
+ *   Author:             Marcelo Mourier
+ *   Created:            Mon Apr 11 11:24:16 MDT 2022
+ *
+ *   Description:        Decimal to floating-point conversion
+ *
+ *=========================================================================
+ *
+ *                  Copyright (c) 2022 Marcelo Mourier
+ *
+ *=========================================================================
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "numparse.h"
+
+// The decimal values in the GPX/TCX/CSV files are plain
+// "[+-]ddd.ddd[e[+-]dd]" numbers, typically with anywhere
+// from 6 to 30 significant digits. We convert them to the
+// nearest double using:
+//
+//   1. The classic "Clinger" fast path, when the decimal
+//      mantissa and the power of 10 are both exact doubles.
+//   2. The Eisel-Lemire algorithm, which uses a 128-bit
+//      approximation of the power of 10 and bails out when
+//      it can't guarantee the correctly rounded result.
+//   3. The C library's strtod() as the slow path, for the
+//      (rare) cases the first two can't handle. Notice that
+//      this tool never calls setlocale(), so strtod() always
+//      runs in the "C" locale.
+
+// Exact powers of 10 as doubles
+static const double exactPow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+    1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+    1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// 128-bit mantissa approximations (rounded down) of the
+// powers of 10 used by the Eisel-Lemire algorithm, as
+// { lo64, hi64 } pairs. Only the exponent range we are
+// likely to see in the input files is covered; anything
+// else takes the slow path.
+#define MIN_POW10   -64
+#define MAX_POW10   63
+
+static const uint64_t detailedPow10[][2] = {
+    { 0x3F2398D747B36224, 0xA87FEA27A539E9A5 },   // 1e-64
+    { 0x8EEC7F0D19A03AAD, 0xD29FE4B18E88640E },   // 1e-63
+    { 0x1953CF68300424AC, 0x83A3EEEEF9153E89 },   // 1e-62
+    { 0x5FA8C3423C052DD7, 0xA48CEAAAB75A8E2B },   // 1e-61
+    { 0x3792F412CB06794D, 0xCDB02555653131B6 },   // 1e-60
+    { 0xE2BBD88BBEE40BD0, 0x808E17555F3EBF11 },   // 1e-59
+    { 0x5B6ACEAEAE9D0EC4, 0xA0B19D2AB70E6ED6 },   // 1e-58
+    { 0xF245825A5A445275, 0xC8DE047564D20A8B },   // 1e-57
+    { 0xEED6E2F0F0D56712, 0xFB158592BE068D2E },   // 1e-56
+    { 0x55464DD69685606B, 0x9CED737BB6C4183D },   // 1e-55
+    { 0xAA97E14C3C26B886, 0xC428D05AA4751E4C },   // 1e-54
+    { 0xD53DD99F4B3066A8, 0xF53304714D9265DF },   // 1e-53
+    { 0xE546A8038EFE4029, 0x993FE2C6D07B7FAB },   // 1e-52
+    { 0xDE98520472BDD033, 0xBF8FDB78849A5F96 },   // 1e-51
+    { 0x963E66858F6D4440, 0xEF73D256A5C0F77C },   // 1e-50
+    { 0xDDE7001379A44AA8, 0x95A8637627989AAD },   // 1e-49
+    { 0x5560C018580D5D52, 0xBB127C53B17EC159 },   // 1e-48
+    { 0xAAB8F01E6E10B4A6, 0xE9D71B689DDE71AF },   // 1e-47
+    { 0xCAB3961304CA70E8, 0x9226712162AB070D },   // 1e-46
+    { 0x3D607B97C5FD0D22, 0xB6B00D69BB55C8D1 },   // 1e-45
+    { 0x8CB89A7DB77C506A, 0xE45C10C42A2B3B05 },   // 1e-44
+    { 0x77F3608E92ADB242, 0x8EB98A7A9A5B04E3 },   // 1e-43
+    { 0x55F038B237591ED3, 0xB267ED1940F1C61C },   // 1e-42
+    { 0x6B6C46DEC52F6688, 0xDF01E85F912E37A3 },   // 1e-41
+    { 0x2323AC4B3B3DA015, 0x8B61313BBABCE2C6 },   // 1e-40
+    { 0xABEC975E0A0D081A, 0xAE397D8AA96C1B77 },   // 1e-39
+    { 0x96E7BD358C904A21, 0xD9C7DCED53C72255 },   // 1e-38
+    { 0x7E50D64177DA2E54, 0x881CEA14545C7575 },   // 1e-37
+    { 0xDDE50BD1D5D0B9E9, 0xAA242499697392D2 },   // 1e-36
+    { 0x955E4EC64B44E864, 0xD4AD2DBFC3D07787 },   // 1e-35
+    { 0xBD5AF13BEF0B113E, 0x84EC3C97DA624AB4 },   // 1e-34
+    { 0xECB1AD8AEACDD58E, 0xA6274BBDD0FADD61 },   // 1e-33
+    { 0x67DE18EDA5814AF2, 0xCFB11EAD453994BA },   // 1e-32
+    { 0x80EACF948770CED7, 0x81CEB32C4B43FCF4 },   // 1e-31
+    { 0xA1258379A94D028D, 0xA2425FF75E14FC31 },   // 1e-30
+    { 0x096EE45813A04330, 0xCAD2F7F5359A3B3E },   // 1e-29
+    { 0x8BCA9D6E188853FC, 0xFD87B5F28300CA0D },   // 1e-28
+    { 0x775EA264CF55347D, 0x9E74D1B791E07E48 },   // 1e-27
+    { 0x95364AFE032A819D, 0xC612062576589DDA },   // 1e-26
+    { 0x3A83DDBD83F52204, 0xF79687AED3EEC551 },   // 1e-25
+    { 0xC4926A9672793542, 0x9ABE14CD44753B52 },   // 1e-24
+    { 0x75B7053C0F178293, 0xC16D9A0095928A27 },   // 1e-23
+    { 0x5324C68B12DD6338, 0xF1C90080BAF72CB1 },   // 1e-22
+    { 0xD3F6FC16EBCA5E03, 0x971DA05074DA7BEE },   // 1e-21
+    { 0x88F4BB1CA6BCF584, 0xBCE5086492111AEA },   // 1e-20
+    { 0x2B31E9E3D06C32E5, 0xEC1E4A7DB69561A5 },   // 1e-19
+    { 0x3AFF322E62439FCF, 0x9392EE8E921D5D07 },   // 1e-18
+    { 0x09BEFEB9FAD487C2, 0xB877AA3236A4B449 },   // 1e-17
+    { 0x4C2EBE687989A9B3, 0xE69594BEC44DE15B },   // 1e-16
+    { 0x0F9D37014BF60A10, 0x901D7CF73AB0ACD9 },   // 1e-15
+    { 0x538484C19EF38C94, 0xB424DC35095CD80F },   // 1e-14
+    { 0x2865A5F206B06FB9, 0xE12E13424BB40E13 },   // 1e-13
+    { 0xF93F87B7442E45D3, 0x8CBCCC096F5088CB },   // 1e-12
+    { 0xF78F69A51539D748, 0xAFEBFF0BCB24AAFE },   // 1e-11
+    { 0xB573440E5A884D1B, 0xDBE6FECEBDEDD5BE },   // 1e-10
+    { 0x31680A88F8953030, 0x89705F4136B4A597 },   // 1e-9
+    { 0xFDC20D2B36BA7C3D, 0xABCC77118461CEFC },   // 1e-8
+    { 0x3D32907604691B4C, 0xD6BF94D5E57A42BC },   // 1e-7
+    { 0xA63F9A49C2C1B10F, 0x8637BD05AF6C69B5 },   // 1e-6
+    { 0x0FCF80DC33721D53, 0xA7C5AC471B478423 },   // 1e-5
+    { 0xD3C36113404EA4A8, 0xD1B71758E219652B },   // 1e-4
+    { 0x645A1CAC083126E9, 0x83126E978D4FDF3B },   // 1e-3
+    { 0x3D70A3D70A3D70A3, 0xA3D70A3D70A3D70A },   // 1e-2
+    { 0xCCCCCCCCCCCCCCCC, 0xCCCCCCCCCCCCCCCC },   // 1e-1
+    { 0x0000000000000000, 0x8000000000000000 },   // 1e0
+    { 0x0000000000000000, 0xA000000000000000 },   // 1e1
+    { 0x0000000000000000, 0xC800000000000000 },   // 1e2
+    { 0x0000000000000000, 0xFA00000000000000 },   // 1e3
+    { 0x0000000000000000, 0x9C40000000000000 },   // 1e4
+    { 0x0000000000000000, 0xC350000000000000 },   // 1e5
+    { 0x0000000000000000, 0xF424000000000000 },   // 1e6
+    { 0x0000000000000000, 0x9896800000000000 },   // 1e7
+    { 0x0000000000000000, 0xBEBC200000000000 },   // 1e8
+    { 0x0000000000000000, 0xEE6B280000000000 },   // 1e9
+    { 0x0000000000000000, 0x9502F90000000000 },   // 1e10
+    { 0x0000000000000000, 0xBA43B74000000000 },   // 1e11
+    { 0x0000000000000000, 0xE8D4A51000000000 },   // 1e12
+    { 0x0000000000000000, 0x9184E72A00000000 },   // 1e13
+    { 0x0000000000000000, 0xB5E620F480000000 },   // 1e14
+    { 0x0000000000000000, 0xE35FA931A0000000 },   // 1e15
+    { 0x0000000000000000, 0x8E1BC9BF04000000 },   // 1e16
+    { 0x0000000000000000, 0xB1A2BC2EC5000000 },   // 1e17
+    { 0x0000000000000000, 0xDE0B6B3A76400000 },   // 1e18
+    { 0x0000000000000000, 0x8AC7230489E80000 },   // 1e19
+    { 0x0000000000000000, 0xAD78EBC5AC620000 },   // 1e20
+    { 0x0000000000000000, 0xD8D726B7177A8000 },   // 1e21
+    { 0x0000000000000000, 0x878678326EAC9000 },   // 1e22
+    { 0x0000000000000000, 0xA968163F0A57B400 },   // 1e23
+    { 0x0000000000000000, 0xD3C21BCECCEDA100 },   // 1e24
+    { 0x0000000000000000, 0x84595161401484A0 },   // 1e25
+    { 0x0000000000000000, 0xA56FA5B99019A5C8 },   // 1e26
+    { 0x0000000000000000, 0xCECB8F27F4200F3A },   // 1e27
+    { 0x4000000000000000, 0x813F3978F8940984 },   // 1e28
+    { 0x5000000000000000, 0xA18F07D736B90BE5 },   // 1e29
+    { 0xA400000000000000, 0xC9F2C9CD04674EDE },   // 1e30
+    { 0x4D00000000000000, 0xFC6F7C4045812296 },   // 1e31
+    { 0xF020000000000000, 0x9DC5ADA82B70B59D },   // 1e32
+    { 0x6C28000000000000, 0xC5371912364CE305 },   // 1e33
+    { 0xC732000000000000, 0xF684DF56C3E01BC6 },   // 1e34
+    { 0x3C7F400000000000, 0x9A130B963A6C115C },   // 1e35
+    { 0x4B9F100000000000, 0xC097CE7BC90715B3 },   // 1e36
+    { 0x1E86D40000000000, 0xF0BDC21ABB48DB20 },   // 1e37
+    { 0x1314448000000000, 0x96769950B50D88F4 },   // 1e38
+    { 0x17D955A000000000, 0xBC143FA4E250EB31 },   // 1e39
+    { 0x5DCFAB0800000000, 0xEB194F8E1AE525FD },   // 1e40
+    { 0x5AA1CAE500000000, 0x92EFD1B8D0CF37BE },   // 1e41
+    { 0xF14A3D9E40000000, 0xB7ABC627050305AD },   // 1e42
+    { 0x6D9CCD05D0000000, 0xE596B7B0C643C719 },   // 1e43
+    { 0xE4820023A2000000, 0x8F7E32CE7BEA5C6F },   // 1e44
+    { 0xDDA2802C8A800000, 0xB35DBF821AE4F38B },   // 1e45
+    { 0xD50B2037AD200000, 0xE0352F62A19E306E },   // 1e46
+    { 0x4526F422CC340000, 0x8C213D9DA502DE45 },   // 1e47
+    { 0x9670B12B7F410000, 0xAF298D050E4395D6 },   // 1e48
+    { 0x3C0CDD765F114000, 0xDAF3F04651D47B4C },   // 1e49
+    { 0xA5880A69FB6AC800, 0x88D8762BF324CD0F },   // 1e50
+    { 0x8EEA0D047A457A00, 0xAB0E93B6EFEE0053 },   // 1e51
+    { 0x72A4904598D6D880, 0xD5D238A4ABE98068 },   // 1e52
+    { 0x47A6DA2B7F864750, 0x85A36366EB71F041 },   // 1e53
+    { 0x999090B65F67D924, 0xA70C3C40A64E6C51 },   // 1e54
+    { 0xFFF4B4E3F741CF6D, 0xD0CF4B50CFE20765 },   // 1e55
+    { 0xBFF8F10E7A8921A4, 0x82818F1281ED449F },   // 1e56
+    { 0xAFF72D52192B6A0D, 0xA321F2D7226895C7 },   // 1e57
+    { 0x9BF4F8A69F764490, 0xCBEA6F8CEB02BB39 },   // 1e58
+    { 0x02F236D04753D5B4, 0xFEE50B7025C36A08 },   // 1e59
+    { 0x01D762422C946590, 0x9F4F2726179A2245 },   // 1e60
+    { 0x424D3AD2B7B97EF5, 0xC722F0EF9D80AAD6 },   // 1e61
+    { 0xD2E0898765A7DEB2, 0xF8EBAD2B84E0D58B },   // 1e62
+    { 0x63CC55F49F88EB2F, 0x9B934C3B330C8577 },   // 1e63
+};
+
+#define MAX_MANTISSA_DIGITS 19
+
+static __inline__ int leadingZeros64(uint64_t x)
+{
+    return __builtin_clzll(x);
+}
+
+static __inline__ void mul64(uint64_t a, uint64_t b, uint64_t *pHi, uint64_t *pLo)
+{
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 r = (unsigned __int128) a * b;
+
+    *pHi = (uint64_t) (r >> 64);
+    *pLo = (uint64_t) r;
+#else
+    uint64_t aLo = (uint32_t) a, aHi = a >> 32;
+    uint64_t bLo = (uint32_t) b, bHi = b >> 32;
+    uint64_t p0 = aLo * bLo;
+    uint64_t p1 = aLo * bHi;
+    uint64_t p2 = aHi * bLo;
+    uint64_t p3 = aHi * bHi;
+    uint64_t mid = (p0 >> 32) + (uint32_t) p1 + (uint32_t) p2;
+
+    *pHi = p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+    *pLo = (mid << 32) | (uint32_t) p0;
+#endif
+}
+
+// Compute the double nearest to man * 10^exp10 using the
+// Eisel-Lemire algorithm. Returns false if the result can't
+// be determined with certainty.
+static Bool eiselLemire(uint64_t man, int exp10, Bool neg, double *pVal)
+{
+    const uint64_t *pow10;
+    uint64_t xHi, xLo, yHi, yLo;
+    uint64_t retMantissa, retExp2, msb, bits;
+    int clz;
+
+    if (man == 0) {
+        *pVal = neg ? -0.0 : 0.0;
+        return true;
+    }
+
+    if ((exp10 < MIN_POW10) || (exp10 > MAX_POW10))
+        return false;
+
+    pow10 = detailedPow10[exp10 - MIN_POW10];
+
+    // Normalization
+    clz = leadingZeros64(man);
+    man <<= clz;
+    retExp2 = (uint64_t) (((217706 * exp10) >> 16) + 64 + 1023) - (uint64_t) clz;
+
+    // Multiplication
+    mul64(man, pow10[1], &xHi, &xLo);
+
+    // Wider approximation
+    if (((xHi & 0x1FF) == 0x1FF) && ((xLo + man) < man)) {
+        uint64_t mergedHi, mergedLo;
+
+        mul64(man, pow10[0], &yHi, &yLo);
+        mergedHi = xHi;
+        mergedLo = xLo + yHi;
+        if (mergedLo < xLo)
+            mergedHi++;
+        if (((mergedHi & 0x1FF) == 0x1FF) && ((mergedLo + 1) == 0) && ((yLo + man) < man))
+            return false;
+        xHi = mergedHi;
+        xLo = mergedLo;
+    }
+
+    // Shifting to 54 bits
+    msb = xHi >> 63;
+    retMantissa = xHi >> (msb + 9);
+    retExp2 -= 1 ^ msb;
+
+    // Half-way ambiguity
+    if ((xLo == 0) && ((xHi & 0x1FF) == 0) && ((retMantissa & 3) == 1))
+        return false;
+
+    // From 54 to 53 bits
+    retMantissa += (retMantissa & 1);
+    retMantissa >>= 1;
+    if ((retMantissa >> 53) > 0) {
+        retMantissa >>= 1;
+        retExp2 += 1;
+    }
+
+    // Subnormal, Inf, or NaN
+    if ((retExp2 - 1) >= (0x7FF - 1))
+        return false;
+
+    bits = (retExp2 << 52) | (retMantissa & 0x000FFFFFFFFFFFFFULL);
+    if (neg)
+        bits |= 0x8000000000000000ULL;
+    memcpy(pVal, &bits, sizeof (*pVal));
+
+    return true;
+}
+
+const char *parseDouble(const char *str, const char *end, double *pVal)
+{
+    const char *p = str;
+    const char *numEnd;
+    uint64_t man = 0;
+    int numDigits = 0;      // significant digits stored in man
+    int exp10 = 0;
+    Bool neg = false;
+    Bool anyDigits = false;
+    Bool truncated = false;
+    char *endPtr;
+
+    // Skip any leading white space, same as strtod()
+    while ((p < end) && ((*p == ' ') || (*p == '\t')))
+        p++;
+
+    if ((p < end) && ((*p == '-') || (*p == '+'))) {
+        neg = (*p == '-');
+        p++;
+    }
+
+    // Integer part
+    for (; (p < end) && (*p >= '0') && (*p <= '9'); p++) {
+        anyDigits = true;
+        if (numDigits < MAX_MANTISSA_DIGITS) {
+            man = (man * 10) + (*p - '0');
+            if (man != 0)
+                numDigits++;
+        } else {
+            exp10++;
+            if (*p != '0')
+                truncated = true;
+        }
+    }
+
+    // Fraction part
+    if ((p < end) && (*p == '.')) {
+        for (p++; (p < end) && (*p >= '0') && (*p <= '9'); p++) {
+            anyDigits = true;
+            if (numDigits < MAX_MANTISSA_DIGITS) {
+                man = (man * 10) + (*p - '0');
+                if (man != 0)
+                    numDigits++;
+                exp10--;
+            } else if (*p != '0') {
+                truncated = true;
+            }
+        }
+    }
+
+    if (!anyDigits)
+        goto slowPath;  // e.g. "inf" or "nan"
+
+    // Exponent part
+    if ((p < end) && ((*p == 'e') || (*p == 'E'))) {
+        const char *q = p + 1;
+        Bool expNeg = false;
+        int exp = 0;
+
+        if ((q < end) && ((*q == '-') || (*q == '+'))) {
+            expNeg = (*q == '-');
+            q++;
+        }
+
+        if ((q < end) && (*q >= '0') && (*q <= '9')) {
+            for (; (q < end) && (*q >= '0') && (*q <= '9'); q++) {
+                if (exp < 10000)
+                    exp = (exp * 10) + (*q - '0');
+            }
+            exp10 += expNeg ? -exp : exp;
+            p = q;
+        }
+    }
+
+    numEnd = p;
+
+    if (!truncated) {
+        // Clinger's fast path: both the mantissa and the power
+        // of 10 are exact, so a single multiply or divide gives
+        // the correctly rounded result.
+        if ((man <= (1ULL << 53)) && (exp10 >= -22) && (exp10 <= 22)) {
+            double val = (double) man;
+
+            val = (exp10 < 0) ? (val / exactPow10[-exp10]) : (val * exactPow10[exp10]);
+            *pVal = neg ? -val : val;
+            return numEnd;
+        }
+
+        if (eiselLemire(man, exp10, neg, pVal))
+            return numEnd;
+    } else {
+        double lo, hi;
+
+        // The value lies somewhere between man and man+1 (times
+        // the power of 10). If both round to the same double, we
+        // are done.
+        if ((man < UINT64_MAX) &&
+            eiselLemire(man, exp10, neg, &lo) &&
+            eiselLemire(man + 1, exp10, neg, &hi) &&
+            (lo == hi)) {
+            *pVal = lo;
+            return numEnd;
+        }
+    }
+
+slowPath:
+    *pVal = strtod(str, &endPtr);
+    if ((endPtr == str) || (endPtr > end))
+        return NULL;
+
+    return endPtr;
+}
+
@@ -0,0 +1,35 @@
+/*=========================================================================
+ *
+ *   Filename:           numparse.h
+ *
+ *   Author:             Marcelo Mourier
+ *   Created:            Mon Apr 11 11:24:16 MDT 2022
+ *
+ *   Description:        Decimal to floating-point conversion
+ *
+ *=========================================================================
+ *
+ *                  Copyright (c) 2022 Marcelo Mourier
+ *
+ *=========================================================================
+*/
+
+#ifndef NUMPARSE_H_
+#define NUMPARSE_H_
+
+#include "defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Convert the decimal number at str, without going past end,
+// to the nearest double. Returns a pointer to the character
+// right after the number, or NULL if there is no number.
+extern const char *parseDouble(const char *str, const char *end, double *pVal);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* NUMPARSE_H_ */
@@ -60,8 +60,9 @@ static const char *fmtTimeStamp(time_t ts, time_t baseTime, TsFmt fmt)
 
 static void printSummary(GpsTrk *pTrk, CmdArgs *pArgs)
 {
+    const TrkPts *pts = &pTrk->trkPts;
     time_t time;
-    const TrkPt *p;
+    int p;
 
     fprintf(pArgs->outFile, "      numTrkPts: %d\n", pTrk->numTrkPts);
     fprintf(pArgs->outFile, "   numDupTrkPts: %d\n", pTrk->numDupTrkPts);
@@ -76,8 +77,8 @@ static void printSummary(GpsTrk *pTrk, CmdArgs *pArgs)
         char timeBuf[128];
         time_t dateAndTime;
 
-        p = TAILQ_FIRST(&pTrk->trkPtList);
-        timeStamp = (p->adjTime != 0) ? p->adjTime : p->timestamp;    // use the adjusted timestamp if there is one
+        p = 0;
+        timeStamp = timeToSec(pts->timestamp[p]);
         timeStamp += pTrk->timeOffset;
         dateAndTime = (time_t) timeStamp;  // sec only
         strftime(timeBuf, sizeof (timeBuf), "%Y-%m-%dT%H:%M:%S", gmtime_r(&dateAndTime, &brkDwnTime));
@@ -105,83 +106,91 @@ static void printSummary(GpsTrk *pTrk, CmdArgs *pArgs)
     fprintf(pArgs->outFile, "       elevLoss: %.3lf m\n", pTrk->elevLoss);
 
     // Max/Min/Avg values
-    if ((p = pTrk->maxElevTrkPt) != NULL) {
+    if ((p = pTrk->maxElevTrkPt) != -1) {
         fprintf(pArgs->outFile, "        maxElev: %.3lf m @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
-                pTrk->maxElev, p->index, fmtTrkPtIdx(p), (long) (p->timestamp - pTrk->baseTime), mToKm(p->distance));
+                pTrk->maxElev, pts->index[p], fmtTrkPtIdx(pTrk, p), (long) (timeToSec(pts->timestamp[p]) - pTrk->baseTime), mToKm(pts->distance[p]));
     }
-    if ((p = pTrk->minElevTrkPt) != NULL) {
+    if ((p = pTrk->minElevTrkPt) != -1) {
         fprintf(pArgs->outFile, "        minElev: %.3lf m @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
-                pTrk->minElev, p->index, fmtTrkPtIdx(p), (long) (p->timestamp - pTrk->baseTime), mToKm(p->distance));
+                pTrk->minElev, pts->index[p], fmtTrkPtIdx(pTrk, p), (long) (timeToSec(pts->timestamp[p]) - pTrk->baseTime), mToKm(pts->distance[p]));
     }
 
-    if ((p = pTrk->maxSpeedTrkPt) != NULL) {
+    if ((p = pTrk->maxSpeedTrkPt) != -1) {
         fprintf(pArgs->outFile, "       maxSpeed: %.3lf km/h @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km, deltaD = %.3lf m, deltaT = %.3lf s\n",
-                mpsToKph(pTrk->maxSpeed), p->index, fmtTrkPtIdx(p), (long) (p->timestamp - pTrk->baseTime), mToKm(p->distance), p->dist, p->deltaT);
+                mpsToKph(pTrk->maxSpeed), pts->index[p], fmtTrkPtIdx(pTrk, p), (long) (timeToSec(pts->timestamp[p]) - pTrk->baseTime), mToKm(pts->distance[p]), pts->dist[p], pts->deltaT[p]);
     }
-    if ((p = pTrk->minSpeedTrkPt) != NULL) {
+    if ((p = pTrk->minSpeedTrkPt) != -1) {
         fprintf(pArgs->outFile, "       minSpeed: %.3lf km/h @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km, deltaD = %.3lf m, deltaT = %.3lf s\n",
-                mpsToKph(pTrk->minSpeed), p->index, fmtTrkPtIdx(p), (long) (p->timestamp - pTrk->baseTime), mToKm(p->distance), p->dist, p->deltaT);
+                mpsToKph(pTrk->minSpeed), pts->index[p], fmtTrkPtIdx(pTrk, p), (long) (timeToSec(pts->timestamp[p]) - pTrk->baseTime), mToKm(pts->distance[p]), pts->dist[p], pts->deltaT[p]);
     }
     fprintf(pArgs->outFile, "       avgSpeed: %.3lf km/h\n", mpsToKph(pTrk->distance / pTrk->time));
 
-    if ((p = pTrk->maxGradeTrkPt) != NULL) {
+    if ((p = pTrk->maxGradeTrkPt) != -1) {
         fprintf(pArgs->outFile, "       maxGrade: %.2lf%% @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km, run = %.3lf m, rise = %.3lf m\n",
-                pTrk->maxGrade, p->index, fmtTrkPtIdx(p), (long) (p->timestamp - pTrk->baseTime), mToKm(p->distance), p->run, p->rise);
+                pTrk->maxGrade, pts->index[p], fmtTrkPtIdx(pTrk, p), (long) (timeToSec(pts->timestamp[p]) - pTrk->baseTime), mToKm(pts->distance[p]), pts->run[p], pts->rise[p]);
     }
-    if ((p = pTrk->minGradeTrkPt) != NULL) {
+    if ((p = pTrk->minGradeTrkPt) != -1) {
         fprintf(pArgs->outFile, "       minGrade: %.2lf%% @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km, run = %.3lf m, rise = %.3lf m\n",
-                pTrk->minGrade, p->index, fmtTrkPtIdx(p), (long) (p->timestamp - pTrk->baseTime), mToKm(p->distance), p->run, p->rise);
+                pTrk->minGrade, pts->index[p], fmtTrkPtIdx(pTrk, p), (long) (timeToSec(pts->timestamp[p]) - pTrk->baseTime), mToKm(pts->distance[p]), pts->run[p], pts->rise[p]);
     }
     fprintf(pArgs->outFile, "       avgGrade: %.2lf%%\n", (pTrk->grade / pTrk->numTrkPts));
 
     if (pTrk->inMask & SD_CADENCE) {
-        p = pTrk->maxCadenceTrkPt;
-        fprintf(pArgs->outFile, "     maxCadence: %d rpm @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
-                pTrk->maxCadence, p->index, fmtTrkPtIdx(p), (long) (p->timestamp - pTrk->baseTime), mToKm(p->distance));
-        p = pTrk->minCadenceTrkPt;
-        fprintf(pArgs->outFile, "     minCadence: %d rpm @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
-                pTrk->minCadence, p->index, fmtTrkPtIdx(p), (long) (p->timestamp - pTrk->baseTime), mToKm(p->distance));
+        if ((p = pTrk->maxCadenceTrkPt) != -1) {
+            fprintf(pArgs->outFile, "     maxCadence: %d rpm @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
+                    pTrk->maxCadence, pts->index[p], fmtTrkPtIdx(pTrk, p), (long) (timeToSec(pts->timestamp[p]) - pTrk->baseTime), mToKm(pts->distance[p]));
+        }
+        if ((p = pTrk->minCadenceTrkPt) != -1) {
+            fprintf(pArgs->outFile, "     minCadence: %d rpm @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
+                    pTrk->minCadence, pts->index[p], fmtTrkPtIdx(pTrk, p), (long) (timeToSec(pts->timestamp[p]) - pTrk->baseTime), mToKm(pts->distance[p]));
+        }
         fprintf(pArgs->outFile, "     avgCadence: %d rpm\n", (pTrk->cadence / pTrk->numTrkPts));
     }
     if (pTrk->inMask & SD_HR) {
-        p = pTrk->maxHeartRateTrkPt;
-        fprintf(pArgs->outFile, "          maxHR: %d bpm @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
-                pTrk->maxHeartRate, p->index, fmtTrkPtIdx(p), (long) (p->timestamp - pTrk->baseTime), mToKm(p->distance));
-        p = pTrk->minHeartRateTrkPt;
-        fprintf(pArgs->outFile, "          minHR: %d bpm @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
-                pTrk->minHeartRate, p->index, fmtTrkPtIdx(p), (long) (p->timestamp - pTrk->baseTime), mToKm(p->distance));
+        if ((p = pTrk->maxHeartRateTrkPt) != -1) {
+            fprintf(pArgs->outFile, "          maxHR: %d bpm @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
+                    pTrk->maxHeartRate, pts->index[p], fmtTrkPtIdx(pTrk, p), (long) (timeToSec(pts->timestamp[p]) - pTrk->baseTime), mToKm(pts->distance[p]));
+        }
+        if ((p = pTrk->minHeartRateTrkPt) != -1) {
+            fprintf(pArgs->outFile, "          minHR: %d bpm @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
+                    pTrk->minHeartRate, pts->index[p], fmtTrkPtIdx(pTrk, p), (long) (timeToSec(pts->timestamp[p]) - pTrk->baseTime), mToKm(pts->distance[p]));
+        }
         fprintf(pArgs->outFile, "          avgHR: %d bpm\n", (pTrk->heartRate / pTrk->numTrkPts));
     }
     if (pTrk->inMask & SD_POWER) {
-        p = pTrk->maxPowerTrkPt;
-        fprintf(pArgs->outFile, "       maxPower: %d watts @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
-                pTrk->maxPower, p->index, fmtTrkPtIdx(p), (long) (p->timestamp - pTrk->baseTime), mToKm(p->distance));
-        p = pTrk->minPowerTrkPt;
-        fprintf(pArgs->outFile, "       minPower: %d watts @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
-                pTrk->minPower, p->index, fmtTrkPtIdx(p), (long) (p->timestamp - pTrk->baseTime), mToKm(p->distance));
+        if ((p = pTrk->maxPowerTrkPt) != -1) {
+            fprintf(pArgs->outFile, "       maxPower: %d watts @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
+                    pTrk->maxPower, pts->index[p], fmtTrkPtIdx(pTrk, p), (long) (timeToSec(pts->timestamp[p]) - pTrk->baseTime), mToKm(pts->distance[p]));
+        }
+        if ((p = pTrk->minPowerTrkPt) != -1) {
+            fprintf(pArgs->outFile, "       minPower: %d watts @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
+                    pTrk->minPower, pts->index[p], fmtTrkPtIdx(pTrk, p), (long) (timeToSec(pts->timestamp[p]) - pTrk->baseTime), mToKm(pts->distance[p]));
+        }
         fprintf(pArgs->outFile, "       avgPower: %d watts\n", (pTrk->power / pTrk->numTrkPts));
     }
     if (pTrk->inMask & SD_ATEMP) {
-        p = pTrk->maxTempTrkPt;
-        fprintf(pArgs->outFile, "        maxTemp: %d C @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
-                pTrk->maxTemp, p->index, fmtTrkPtIdx(p), (long) (p->timestamp - pTrk->baseTime), mToKm(p->distance));
-        p = pTrk->minTempTrkPt;
-        fprintf(pArgs->outFile, "        minTemp: %d C @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
-                pTrk->minTemp, p->index, fmtTrkPtIdx(p), (long) (p->timestamp - pTrk->baseTime), mToKm(p->distance));
+        if ((p = pTrk->maxTempTrkPt) != -1) {
+            fprintf(pArgs->outFile, "        maxTemp: %d C @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
+                    pTrk->maxTemp, pts->index[p], fmtTrkPtIdx(pTrk, p), (long) (timeToSec(pts->timestamp[p]) - pTrk->baseTime), mToKm(pts->distance[p]));
+        }
+        if ((p = pTrk->minTempTrkPt) != -1) {
+            fprintf(pArgs->outFile, "        minTemp: %d C @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
+                    pTrk->minTemp, pts->index[p], fmtTrkPtIdx(pTrk, p), (long) (timeToSec(pts->timestamp[p]) - pTrk->baseTime), mToKm(pts->distance[p]));
+        }
         fprintf(pArgs->outFile, "        avgTemp: %d C\n", (pTrk->temp / pTrk->numTrkPts));
     }
 
-    if ((p = pTrk->maxDeltaDTrkPt) != NULL) {
+    if ((p = pTrk->maxDeltaDTrkPt) != -1) {
         fprintf(pArgs->outFile, "      maxDeltaD: %.3lf m @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
-                pTrk->maxDeltaD, p->index, fmtTrkPtIdx(p), (long) (p->timestamp - pTrk->baseTime), mToKm(p->distance));
+                pTrk->maxDeltaD, pts->index[p], fmtTrkPtIdx(pTrk, p), (long) (timeToSec(pts->timestamp[p]) - pTrk->baseTime), mToKm(pts->distance[p]));
     }
-    if ((p = pTrk->maxDeltaTTrkPt) != NULL) {
+    if ((p = pTrk->maxDeltaTTrkPt) != -1) {
         fprintf(pArgs->outFile, "      maxDeltaT: %.3lf sec @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
-                pTrk->maxDeltaT, p->index, fmtTrkPtIdx(p), (long) (p->timestamp - pTrk->baseTime), mToKm(p->distance));
+                pTrk->maxDeltaT, pts->index[p], fmtTrkPtIdx(pTrk, p), (long) (timeToSec(pts->timestamp[p]) - pTrk->baseTime), mToKm(pts->distance[p]));
     }
-    if ((p = pTrk->maxDeltaGTrkPt) != NULL) {
+    if ((p = pTrk->maxDeltaGTrkPt) != -1) {
         fprintf(pArgs->outFile, "      maxDeltaG: %.2lf%% @ TrkPt #%d (%s) : time = %ld s, distance = %.3lf km\n",
-                pTrk->maxDeltaG, p->index, fmtTrkPtIdx(p), (long) (p->timestamp - pTrk->baseTime), mToKm(p->distance));
+                pTrk->maxDeltaG, pts->index[p], fmtTrkPtIdx(pTrk, p), (long) (timeToSec(pts->timestamp[p]) - pTrk->baseTime), mToKm(pts->distance[p]));
     }
 }
 
@@ -209,39 +218,40 @@ static int csvTemp(int temp, const CmdArgs *pArgs)
 // you also change the expected format in parseCsvFile() !!!
 static void printCsvFmt(GpsTrk *pTrk, CmdArgs *pArgs)
 {
-    TrkPt *p;
+    const TrkPts *pts = &pTrk->trkPts;
+    int p;
 
     // Print column banner line
     fprintf(pArgs->outFile, "%s\n", csvBannerLine);
 
-    TAILQ_FOREACH(p, &pTrk->trkPtList, tqEntry) {
-        double timeStamp = (p->adjTime != 0.0) ? p->adjTime : p->timestamp;    // use the adjusted timestamp if there is one
-        double distance = p->distance - pTrk->baseDistance;
+    for (p = 0; p < pts->count; p++) {
+        double timeStamp = timeToSec(pts->timestamp[p]);
+        double distance = pts->distance[p] - pTrk->baseDistance;
 
         fprintf(pArgs->outFile, "%d,%s,%d,%s,",
-                p->index,                               // <trkPt>
-                p->inFile,                              // <inFile>
-                p->lineNum,                             // <line#>
+                pts->index[p],                          // <trkPt>
+                trkPtInFile(pTrk, p),                   // <inFile>
+                pts->lineNum[p],                        // <line#>
                 fmtTimeStamp(timeStamp, pTrk->baseTime, pArgs->tsFmt));   // <time>
         fprintf(pArgs->outFile, "%.10lf,%.10lf,%.3lf,%.3lf,%.3lf,",
-                p->latitude,                            // <lat> [decimal degrees]
-                p->longitude,                           // <lon> [decimal degrees]
-                csvElev(p->elevation, pArgs),           // <ele> [meters/feet]
+                coordToDeg(pts->latitude[p]),           // <lat> [decimal degrees]
+                coordToDeg(pts->longitude[p]),          // <lon> [decimal degrees]
+                csvElev(pts->elevation[p], pArgs),      // <ele> [meters/feet]
                 csvDist(mToKm(distance), pArgs),        // <distance> [km/miles]
-                csvSpeed(mpsToKph(p->speed), pArgs));   // <speed> [kph/mph]
+                csvSpeed(mpsToKph(pts->speed[p]), pArgs)); // <speed> [kph/mph]
         fprintf(pArgs->outFile, "%d,%d,%d,%d,",
-                p->power,                               // <power> [watts]
-                csvTemp(p->ambTemp, pArgs),             // <atemp> [C/F degrees]
-                p->cadence,                             // <cadence> [RPM]
-                p->heartRate);                          // <hr> [BPM]
+                pts->power[p],                          // <power> [watts]
+                csvTemp(pts->ambTemp[p], pArgs),        // <atemp> [C/F degrees]
+                pts->cadence[p],                        // <cadence> [RPM]
+                pts->heartRate[p]);                     // <hr> [BPM]
         fprintf(pArgs->outFile, "%.3lf,%.3lf,%.3lf,%.3lf,%.3lf,%.3lf,%.3f\n",
-                p->run,                                 // <run> [meters/feet]
-                p->rise,                                // <rise> [meters/feet]
-                csvElev(p->dist, pArgs),                // <dist> [meters/feet]
-                p->grade,                               // <grade> [%]
-                p->deltaG,                              // <deltaG> [%]
-                p->deltaS,                              // <deltaS> [kph/mph]
-                p->deltaT);                             // <deltaT> [s]
+                pts->run[p],                            // <run> [meters/feet]
+                pts->rise[p],                           // <rise> [meters/feet]
+                csvElev(pts->dist[p], pArgs),           // <dist> [meters/feet]
+                pts->grade[p],                          // <grade> [%]
+                pts->deltaG[p],                         // <deltaG> [%]
+                pts->deltaS[p],                         // <deltaS> [kph/mph]
+                pts->deltaT[p]);                        // <deltaT> [s]
     }
 }
 
@@ -265,7 +275,8 @@ static void printGpxFmt(GpsTrk *pTrk, CmdArgs *pArgs)
     time_t now;
     struct tm brkDwnTime = {0};
     char timeBuf[128];
-    TrkPt *p;
+    const TrkPts *pts = &pTrk->trkPts;
+    int p;
 
     // Print headers
     fprintf(pArgs->outFile, "%s", xmlHeader);
@@ -296,8 +307,8 @@ static void printGpxFmt(GpsTrk *pTrk, CmdArgs *pArgs)
     fprintf(pArgs->outFile, "    <trkseg>\n");
 
     // Print all the track points
-    TAILQ_FOREACH(p, &pTrk->trkPtList, tqEntry) {
-        double timeStamp = (p->adjTime != 0.0) ? p->adjTime : p->timestamp;    // use the adjusted timestamp if there is one
+    for (p = 0; p < pts->count; p++) {
+        double timeStamp = timeToSec(pts->timestamp[p]);
         time_t time;
         int ms = 0;
 
@@ -305,24 +316,24 @@ static void printGpxFmt(GpsTrk *pTrk, CmdArgs *pArgs)
         time = (time_t) timeStamp;  // sec only
         ms = (timeStamp - (double) time) * 1000.0;  // milliseconds
         strftime(timeBuf, sizeof (timeBuf), "%Y-%m-%dT%H:%M:%S", gmtime_r(&time, &brkDwnTime));
-        fprintf(pArgs->outFile, "      <trkpt lat=\"%.10lf\" lon=\"%.10lf\">\n", p->latitude, p->longitude);
-        fprintf(pArgs->outFile, "        <ele>%.10lf</ele>\n", p->elevation);
+        fprintf(pArgs->outFile, "      <trkpt lat=\"%.10lf\" lon=\"%.10lf\">\n", coordToDeg(pts->latitude[p]), coordToDeg(pts->longitude[p]));
+        fprintf(pArgs->outFile, "        <ele>%.10lf</ele>\n", pts->elevation[p]);
         fprintf(pArgs->outFile, "        <time>%s.%03dZ</time>\n", timeBuf, ms);
         if (pArgs->outMask != SD_NONE) {
             fprintf(pArgs->outFile, "        <extensions>\n");
             if ((pTrk->inMask & SD_POWER) && (pArgs->outMask & SD_POWER)) {
-                fprintf(pArgs->outFile, "          <power>%d</power>\n", p->power);
+                fprintf(pArgs->outFile, "          <power>%d</power>\n", pts->power[p]);
             }
             if ((pTrk->inMask & (SD_ATEMP | SD_CADENCE | SD_HR)) && (pArgs->outMask & (SD_ATEMP | SD_CADENCE | SD_HR))) {
                 fprintf(pArgs->outFile, "          <gpxtpx:TrackPointExtension>\n");
                 if ((pTrk->inMask & SD_ATEMP) && (pArgs->outMask & SD_ATEMP)) {
-                    fprintf(pArgs->outFile, "            <gpxtpx:atemp>%d</gpxtpx:atemp>\n", p->ambTemp);
+                    fprintf(pArgs->outFile, "            <gpxtpx:atemp>%d</gpxtpx:atemp>\n", pts->ambTemp[p]);
                 }
                 if ((pTrk->inMask & SD_HR) && (pArgs->outMask & SD_HR)) {
-                    fprintf(pArgs->outFile, "            <gpxtpx:hr>%d</gpxtpx:hr>\n", p->heartRate);
+                    fprintf(pArgs->outFile, "            <gpxtpx:hr>%d</gpxtpx:hr>\n", pts->heartRate[p]);
                 }
                 if ((pTrk->inMask & SD_CADENCE) && (pArgs->outMask & SD_CADENCE)) {
-                    fprintf(pArgs->outFile, "            <gpxtpx:cad>%d</gpxtpx:cad>\n", p->cadence);
+                    fprintf(pArgs->outFile, "            <gpxtpx:cad>%d</gpxtpx:cad>\n", pts->cadence[p]);
                 }
                 fprintf(pArgs->outFile, "          </gpxtpx:TrackPointExtension>\n");
             }
@@ -374,9 +385,10 @@ static void printShizFmt(GpsTrk *pTrk, CmdArgs *pArgs)
     time_t now;
     struct tm brkDwnTime = {0};
     char dateBuf[64];
-    double startTime = TAILQ_FIRST(&pTrk->trkPtList)->timestamp;
-    double endTime = TAILQ_LAST(&pTrk->trkPtList, TrkPtList)->timestamp;
-    TrkPt *p;
+    const TrkPts *pts = &pTrk->trkPts;
+    double startTime = timeToSec(pts->timestamp[0]);
+    double endTime = timeToSec(pts->timestamp[pts->count - 1]);
+    int p;
 
     now = time(NULL);
     strftime(dateBuf, sizeof (dateBuf), "%A, %B %d, %Y", gmtime_r(&now, &brkDwnTime));
@@ -387,13 +399,13 @@ static void printShizFmt(GpsTrk *pTrk, CmdArgs *pArgs)
     fprintf(pArgs->outFile, "{\"extra\":{\"duration\":\"%s\",\"distance\":%.5lf,\"toughness\":\"%d\",\"elevation_gain\":%u,\"date_processed\":\"%s\",\"speed_filter\":\"%d\",\"elevation_filter\":\"%d\",\"grade_filter\":\"%d\",\"timeshift\":\"%d\"},\"gpx\":{\"trk\":{\"trkseg\":{\"trkpt\":[",
             fmtTimeStamp((endTime - startTime), 0, hms), mToKm(pTrk->distance), toughness, (unsigned) pTrk->elevGain, dateBuf, speed_filter, elevation_filter, grade_filter, timeshift);
 
-    TAILQ_FOREACH(p, &pTrk->trkPtList, tqEntry) {
+    for (p = 0; p < pts->count; p++) {
         // The first "trkpt" is included in the header line,
         // while all the other ones are printed on separate
         // lines...
 
         fprintf(pArgs->outFile, "{\"-lon\":\"%.7lf\",\"-lat\":\"%.7lf\",\"speed\":\"%.1lf\",\"ele\":\"%.3lf\",\"distance\":\"%.5lf\",\"bearing\":\"%.2lf\",\"slope\":\"%.1lf\",\"time\":\"%s\",\"index\":%u,\"cadence\":%u,\"p\":%u}%s",
-                p->longitude, p->latitude, mpsToKph(p->speed), p->elevation, mToKm(p->distance), p->bearing, p->grade, fmtTimeStamp((p->timestamp - startTime), 0, hms), p->index, p->cadence, 0, (TAILQ_NEXT(p, tqEntry) != NULL) ? ",\n" : "");
+                coordToDeg(pts->longitude[p]), coordToDeg(pts->latitude[p]), mpsToKph(pts->speed[p]), pts->elevation[p], mToKm(pts->distance[p]), pts->bearing[p], pts->grade[p], fmtTimeStamp((timeToSec(pts->timestamp[p]) - startTime), 0, hms), pts->index[p], pts->cadence[p], 0, (p != (pts->count - 1)) ? ",\n" : "");
     }
 
     fprintf(pArgs->outFile, "]}},\"seg\":[]}}\n");
@@ -405,7 +417,8 @@ static void printTcxFmt(GpsTrk *pTrk, CmdArgs *pArgs)
     time_t now;
     struct tm brkDwnTime = {0};
     char timeBuf[128];
-    TrkPt *p;
+    const TrkPts *pts = &pTrk->trkPts;
+    int p;
 
     // Print headers
     fprintf(pArgs->outFile, "%s", xmlHeader);
@@ -433,8 +446,8 @@ static void printTcxFmt(GpsTrk *pTrk, CmdArgs *pArgs)
     fprintf(pArgs->outFile, "        <Track>\n");
 
     // Print all the track points
-    TAILQ_FOREACH(p, &pTrk->trkPtList, tqEntry) {
-        double timeStamp = (p->adjTime != 0.0) ? p->adjTime : p->timestamp;    // use the adjusted timestamp if there is one
+    for (p = 0; p < pts->count; p++) {
+        double timeStamp = timeToSec(pts->timestamp[p]);
         time_t time;
         int ms = 0;
 
@@ -446,25 +459,25 @@ static void printTcxFmt(GpsTrk *pTrk, CmdArgs *pArgs)
         fprintf(pArgs->outFile, "          <Trackpoint>\n");
         fprintf(pArgs->outFile, "            <Time>%s.%03dZ</Time>\n", timeBuf, ms);
         fprintf(pArgs->outFile, "            <Position>\n");
-        fprintf(pArgs->outFile, "              <LatitudeDegrees>%.10lf</LatitudeDegrees>\n", p->latitude);
-        fprintf(pArgs->outFile, "              <LongitudeDegrees>%.10lf</LongitudeDegrees>\n", p->longitude);
+        fprintf(pArgs->outFile, "              <LatitudeDegrees>%.10lf</LatitudeDegrees>\n", coordToDeg(pts->latitude[p]));
+        fprintf(pArgs->outFile, "              <LongitudeDegrees>%.10lf</LongitudeDegrees>\n", coordToDeg(pts->longitude[p]));
         fprintf(pArgs->outFile, "            </Position>\n");
-        fprintf(pArgs->outFile, "            <AltitudeMeters>%.10lf</AltitudeMeters>\n", p->elevation);
-        fprintf(pArgs->outFile, "            <DistanceMeters>%.10lf</DistanceMeters>\n", p->distance);
+        fprintf(pArgs->outFile, "            <AltitudeMeters>%.10lf</AltitudeMeters>\n", pts->elevation[p]);
+        fprintf(pArgs->outFile, "            <DistanceMeters>%.10lf</DistanceMeters>\n", pts->distance[p]);
         if ((pTrk->inMask & SD_HR) && (pArgs->outMask & SD_HR)) {
             fprintf(pArgs->outFile, "            <HeartRateBpm>\n");
-            fprintf(pArgs->outFile, "              <Value>%d</Value>\n", p->heartRate);
+            fprintf(pArgs->outFile, "              <Value>%d</Value>\n", pts->heartRate[p]);
             fprintf(pArgs->outFile, "            </HeartRateBpm>\n");
         }
         if ((pTrk->inMask & SD_CADENCE) && (pArgs->outMask & SD_CADENCE)) {
-            fprintf(pArgs->outFile, "            <Cadence>%d</Cadence>\n", p->cadence);
+            fprintf(pArgs->outFile, "            <Cadence>%d</Cadence>\n", pts->cadence[p]);
         }
         fprintf(pArgs->outFile, "            <Extensions>\n");
-        fprintf(pArgs->outFile, "              <GradePercent>%.2lf</GradePercent>\n", p->grade);
+        fprintf(pArgs->outFile, "              <GradePercent>%.2lf</GradePercent>\n", pts->grade[p]);
         fprintf(pArgs->outFile, "              <ns3:TPX>\n");
-        fprintf(pArgs->outFile, "                <ns3:Speed>%.10lf</ns3:Speed>\n", p->speed);
+        fprintf(pArgs->outFile, "                <ns3:Speed>%.10lf</ns3:Speed>\n", pts->speed[p]);
         if ((pTrk->inMask & SD_POWER) && (pArgs->outMask & SD_POWER)) {
-            fprintf(pArgs->outFile, "                <ns3:Watts>%d</ns3:Watts>\n", p->power);
+            fprintf(pArgs->outFile, "                <ns3:Watts>%d</ns3:Watts>\n", pts->power[p]);
         }
         fprintf(pArgs->outFile, "              </ns3:TPX>\n");
         fprintf(pArgs->outFile, "            </Extensions>\n");
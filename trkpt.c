@@ -14,36 +14,349 @@
  *=========================================================================
 */
 
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "const.h"
 #include "trkpt.h"
 
-TrkPt *nxtTrkPt(TrkPt **p1, TrkPt *p2)
+// Initial number of TrkPt's allocated in the track
+#define MIN_TRK_PTS 1024
+
+// Number of TrkPt's in each packed block
+#define TRK_PTS_BLK_SIZE    MIN_TRK_PTS
+
+// Encoding of each array in a packed block
+#define BLK_COL_CONST   0   // all the values are the same
+#define BLK_COL_DELTA   1   // delta+varint encoded
+
+// Alignment (in bytes) of each of the TrkPts arrays; i.e.
+// the size of a cache line, which is also good enough for
+// any SIMD instruction set.
+#define TRK_PTS_ALIGN   64
+
+// Location and element size of each of the TrkPts arrays,
+// so that the arrays can be allocated, moved, and copied
+// without having to spell out each one of them...
+typedef struct TrkPtsCol {
+    size_t offset;      // offset of the array pointer in TrkPts
+    size_t size;        // size of each array element
+} TrkPtsCol;
+
+#define TRK_PTS_COL(name)   { offsetof(TrkPts, name), sizeof (*((TrkPts *) 0)->name) }
+
+static const TrkPtsCol trkPtsCols[] = {
+    TRK_PTS_COL(index),
+    TRK_PTS_COL(lineNum),
+    TRK_PTS_COL(timestamp),
+    TRK_PTS_COL(latitude),
+    TRK_PTS_COL(longitude),
+    TRK_PTS_COL(elevation),
+    TRK_PTS_COL(ambTemp),
+    TRK_PTS_COL(cadence),
+    TRK_PTS_COL(heartRate),
+    TRK_PTS_COL(power),
+    TRK_PTS_COL(speed),
+    TRK_PTS_COL(distance),
+    TRK_PTS_COL(flags),
+    TRK_PTS_COL(deltaG),
+    TRK_PTS_COL(deltaS),
+    TRK_PTS_COL(deltaT),
+    TRK_PTS_COL(dist),
+    TRK_PTS_COL(rise),
+    TRK_PTS_COL(run),
+    TRK_PTS_COL(bearing),
+    TRK_PTS_COL(grade),
+};
+
+#define NUM_TRK_PTS_COLS    (sizeof (trkPtsCols) / sizeof (trkPtsCols[0]))
+
+static __inline__ char **trkPtsCol(TrkPts *pts, const TrkPtsCol *pCol)
+{
+    return (char **) ((char *) pts + pCol->offset);
+}
+
+static __inline__ int clampInt(int value, int min, int max)
+{
+    return (value < min) ? min : (value > max) ? max : value;
+}
+
+static __inline__ size_t alignUp(size_t size)
+{
+    return (size + (TRK_PTS_ALIGN - 1)) & ~((size_t) (TRK_PTS_ALIGN - 1));
+}
+
+// Resize the arrays to hold the given number of TrkPt's.
+// All the arrays are carved out of a single memory block,
+// each one starting on a cache line boundary.
+static int resizeTrkPts(GpsTrk *pTrk, int max)
+{
+    TrkPts *pts = &pTrk->trkPts;
+    TrkPts newPts = *pts;
+    size_t bufLen = 0;
+    uintptr_t base;
+    int n;
+
+    for (n = 0; n < NUM_TRK_PTS_COLS; n++) {
+        bufLen += alignUp(max * trkPtsCols[n].size);
+    }
+
+    if ((newPts.buf = malloc(bufLen + TRK_PTS_ALIGN - 1)) == NULL) {
+        fprintf(stderr, "Failed to alloc TrkPt arrays !!!\n");
+        return -1;
+    }
+
+    base = alignUp((uintptr_t) newPts.buf);
+    for (n = 0; n < NUM_TRK_PTS_COLS; n++) {
+        const TrkPtsCol *pCol = &trkPtsCols[n];
+        char **col = trkPtsCol(&newPts, pCol);
+        *col = (char *) base;
+        if (pts->count != 0) {
+            memcpy(*col, *trkPtsCol(pts, pCol), (pts->count * pCol->size));
+        }
+        base += alignUp(max * pCol->size);
+    }
+
+    free(pts->buf);
+    *pts = newPts;
+    pts->max = max;
+
+    return 0;
+}
+
+// Make room for (at least) the given number of TrkPt's in
+// the track.
+static int growTrkPts(GpsTrk *pTrk, int numPts)
+{
+    int max = (pTrk->trkPts.max != 0) ? pTrk->trkPts.max : MIN_TRK_PTS;
+
+    while (max < numPts) {
+        max *= 2;
+    }
+
+    return resizeTrkPts(pTrk, max);
+}
+
+// Make room for exactly the given number of TrkPt's in the
+// track; e.g. before appending several tracks to it.
+int reserveTrkPts(GpsTrk *pTrk, int numPts)
+{
+    if (pTrk->trkPts.max >= numPts) {
+        // Nothing to do!
+        return 0;
+    }
+
+    return resizeTrkPts(pTrk, numPts);
+}
+
+// Append/fetch a varint to/from a packed block
+static __inline__ size_t putVarint(uint8_t *data, uint64_t val)
+{
+    size_t len = 0;
+
+    while (val >= 0x80) {
+        data[len++] = (uint8_t) (val | 0x80);
+        val >>= 7;
+    }
+    data[len++] = (uint8_t) val;
+
+    return len;
+}
+
+static __inline__ uint64_t getVarint(const uint8_t **pData)
+{
+    const uint8_t *data = *pData;
+    uint64_t val = 0;
+    int shift = 0;
+    uint8_t b;
+
+    do {
+        b = *data++;
+        val |= (uint64_t) (b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+
+    *pData = data;
+
+    return val;
+}
+
+// Get/set the raw bits of the p-th element of an array
+static __inline__ uint64_t getColBits(const char *col, size_t size, int p)
+{
+    const char *src = col + (p * size);
+
+    switch (size) {
+    case 1: { uint8_t v; memcpy(&v, src, 1); return v; }
+    case 2: { uint16_t v; memcpy(&v, src, 2); return v; }
+    case 4: { uint32_t v; memcpy(&v, src, 4); return v; }
+    default: { uint64_t v; memcpy(&v, src, 8); return v; }
+    }
+}
+
+static __inline__ void setColBits(char *col, size_t size, int p, uint64_t bits)
+{
+    char *dst = col + (p * size);
+
+    switch (size) {
+    case 1: { uint8_t v = (uint8_t) bits; memcpy(dst, &v, 1); break; }
+    case 2: { uint16_t v = (uint16_t) bits; memcpy(dst, &v, 2); break; }
+    case 4: { uint32_t v = (uint32_t) bits; memcpy(dst, &v, 4); break; }
+    default: { memcpy(dst, &bits, 8); break; }
+    }
+}
+
+// Pack the TrkPt's in the arrays into a new block, and empty
+// the arrays. Each array is encoded separately: if all its
+// values are the same, just that value is stored; otherwise
+// its first value is followed by the difference between the
+// raw bits of each value and those of the previous one, as
+// a zigzag varint. As the values of consecutive TrkPt's are
+// close to each other, most of the differences fit in a few
+// bytes, and the encoding is lossless for any type.
+static int packTrkPtsBlk(TrkPts *pts)
 {
-    if (p1 != NULL)
-        *p1 = p2;
-    return TAILQ_NEXT(p2, tqEntry);
+    TrkPtsBlk *pBlk;
+    uint8_t *data;
+    size_t len = 0;
+    int n, p;
+
+    if (pts->numBlks == pts->maxBlks) {
+        int maxBlks = (pts->maxBlks != 0) ? (pts->maxBlks * 2) : 16;
+        TrkPtsBlk *blks;
+        if ((blks = realloc(pts->blks, (maxBlks * sizeof (TrkPtsBlk)))) == NULL) {
+            fprintf(stderr, "Failed to alloc TrkPtsBlk table !!!\n");
+            return -1;
+        }
+        pts->blks = blks;
+        pts->maxBlks = maxBlks;
+    }
+
+    // Worst case: a tag, plus a 10-byte varint for each
+    // value of each array.
+    if ((pts->blkBuf == NULL) &&
+        ((pts->blkBuf = malloc(NUM_TRK_PTS_COLS * (1 + (TRK_PTS_BLK_SIZE * 10)))) == NULL)) {
+        fprintf(stderr, "Failed to alloc TrkPtsBlk buffer !!!\n");
+        return -1;
+    }
+    data = pts->blkBuf;
+
+    for (n = 0; n < NUM_TRK_PTS_COLS; n++) {
+        const TrkPtsCol *pCol = &trkPtsCols[n];
+        const char *col = *trkPtsCol(pts, pCol);
+        uint64_t prev = getColBits(col, pCol->size, 0);
+        size_t tag = len++;
+
+        len += putVarint(&data[len], prev);
+
+        data[tag] = BLK_COL_CONST;
+        for (p = 1; (p < pts->count) && (getColBits(col, pCol->size, p) == prev); p++)
+            ;
+        if (p == pts->count) {
+            continue;
+        }
+
+        data[tag] = BLK_COL_DELTA;
+        for (p = 1; p < pts->count; p++) {
+            uint64_t bits = getColBits(col, pCol->size, p);
+            int64_t delta = (int64_t) (bits - prev);
+            len += putVarint(&data[len], (((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63)));
+            prev = bits;
+        }
+    }
+
+    pBlk = &pts->blks[pts->numBlks];
+    if ((pBlk->data = malloc(len)) == NULL) {
+        fprintf(stderr, "Failed to alloc TrkPtsBlk data !!!\n");
+        return -1;
+    }
+    memcpy(pBlk->data, data, len);
+    pBlk->count = pts->count;
+    pBlk->len = len;
+    pts->numBlks++;
+
+    pts->count = 0;
+
+    return 0;
+}
+
+// Unpack the given block into the arrays, starting at the
+// given position.
+static void unpackTrkPtsBlk(TrkPts *pts, int q, const TrkPtsBlk *pBlk)
+{
+    const uint8_t *data = pBlk->data;
+    int n, p;
+
+    for (n = 0; n < NUM_TRK_PTS_COLS; n++) {
+        const TrkPtsCol *pCol = &trkPtsCols[n];
+        char *col = *trkPtsCol(pts, pCol);
+        uint8_t tag = *data++;
+        uint64_t prev = getVarint(&data);
+
+        setColBits(col, pCol->size, q, prev);
+
+        if (tag == BLK_COL_CONST) {
+            for (p = 1; p < pBlk->count; p++) {
+                setColBits(col, pCol->size, (q + p), prev);
+            }
+            continue;
+        }
+
+        for (p = 1; p < pBlk->count; p++) {
+            uint64_t zz = getVarint(&data);
+            prev += (uint64_t) ((int64_t) (zz >> 1) ^ -((int64_t) (zz & 1)));
+            setColBits(col, pCol->size, (q + p), prev);
+        }
+    }
 }
 
-TrkPt *remTrkPt(GpsTrk *pTrk, TrkPt *p)
+// From now on, pack the TrkPt's added to the track as each
+// block of them fills up, to save memory while the track is
+// parsed, only to be appended to another track. A packed
+// track can only be appended to another track or freed:
+// nothing else decodes the blocks, so this doesn't reduce
+// the memory used by the processing stages, which always
+// work on the unpacked arrays of the main track.
+void packTrkPts(GpsTrk *pTrk)
 {
-    TrkPt *nxt = TAILQ_NEXT(p, tqEntry);
-    TAILQ_REMOVE(&pTrk->trkPtList, p, tqEntry);
-    free(p);
-    return nxt;
+    pTrk->trkPts.pack = true;
 }
 
-TrkPt *newTrkPt(int index, const char *inFile, int lineNum)
+// Pack the remaining TrkPt's of a packed track, and free the
+// arrays and buffers that are only needed to add TrkPt's to
+// it, once all its TrkPt's have been added.
+int flushTrkPts(GpsTrk *pTrk)
 {
-    TrkPt *pTrkPt;
+    TrkPts *pts = &pTrk->trkPts;
+    int s = 0;
+
+    if ((pts->count != 0) && (pts->numBlks != 0)) {
+        s = packTrkPtsBlk(pts);
+    }
 
-    if ((pTrkPt = calloc(1, sizeof(TrkPt))) == NULL) {
-        fprintf(stderr, "Failed to alloc TrkPt object !!!\n");
-        return NULL;
+    if (pts->count == 0) {
+        free(pts->buf);
+        pts->buf = NULL;
+        pts->max = 0;
     }
 
-    pTrkPt->index = index;
+    free(pts->blkBuf);
+    pts->blkBuf = NULL;
+
+    return s;
+}
+
+// Init the given TrkPt object, which is used to collect
+// the data of a new TrkPt while parsing the input file.
+// Once complete, the TrkPt is added to the track using
+// addTrkPt().
+TrkPt *newTrkPt(GpsTrk *pTrk, TrkPt *pTrkPt, const char *inFile, int lineNum)
+{
+    memset(pTrkPt, 0, sizeof (TrkPt));
+
+    pTrkPt->index = pTrk->numTrkPts++;
     pTrkPt->inFile = inFile;
     pTrkPt->lineNum = lineNum;
     pTrkPt->elevation = nilElev;
@@ -53,48 +366,481 @@ TrkPt *newTrkPt(int index, const char *inFile, int lineNum)
     return pTrkPt;
 }
 
-const char *fmtTrkPtIdx(const TrkPt *pTrkPt)
+// Record that the TrkPt's starting at the given index came
+// from the specified input file.
+static int addTrkPtSrc(TrkPts *pts, int index, const char *inFile)
+{
+    TrkPtSrc *srcs;
+
+    if ((pts->numSrcs != 0) && (pts->srcs[pts->numSrcs - 1].inFile == inFile)) {
+        // Same file as the previous TrkPt's
+        return 0;
+    }
+
+    if ((srcs = realloc(pts->srcs, ((pts->numSrcs + 1) * sizeof (TrkPtSrc)))) == NULL) {
+        fprintf(stderr, "Failed to alloc TrkPtSrc table !!!\n");
+        return -1;
+    }
+
+    srcs[pts->numSrcs].index = index;
+    srcs[pts->numSrcs].inFile = inFile;
+    pts->srcs = srcs;
+    pts->numSrcs++;
+
+    return 0;
+}
+
+// Append the given TrkPt at the end of the track. Sensor
+// values that don't fit in their storage type are clamped.
+int addTrkPt(GpsTrk *pTrk, const TrkPt *pTrkPt)
+{
+    TrkPts *pts = &pTrk->trkPts;
+    int p;
+
+    if ((pts->count == pts->max) &&
+        (growTrkPts(pTrk, (pts->count + 1)) != 0)) {
+        return -1;
+    }
+
+    if (addTrkPtSrc(pts, pTrkPt->index, pTrkPt->inFile) != 0) {
+        return -1;
+    }
+
+    p = pts->count++;
+
+    pts->index[p] = pTrkPt->index;
+    pts->lineNum[p] = pTrkPt->lineNum;
+    pts->timestamp[p] = secToTime(pTrkPt->timestamp);
+    pts->latitude[p] = degToCoord(pTrkPt->latitude);
+    pts->longitude[p] = degToCoord(pTrkPt->longitude);
+    pts->elevation[p] = pTrkPt->elevation;
+    pts->ambTemp[p] = clampInt(pTrkPt->ambTemp, INT8_MIN, INT8_MAX);
+    pts->cadence[p] = clampInt(pTrkPt->cadence, 0, UINT8_MAX);
+    pts->heartRate[p] = clampInt(pTrkPt->heartRate, 0, UINT8_MAX);
+    pts->power[p] = clampInt(pTrkPt->power, 0, UINT16_MAX);
+    pts->speed[p] = pTrkPt->speed;
+    pts->distance[p] = pTrkPt->distance;
+    pts->flags[p] = pTrkPt->adjGrade ? TP_ADJ_GRADE : 0;
+    pts->deltaG[p] = pTrkPt->deltaG;
+    pts->deltaS[p] = pTrkPt->deltaS;
+    pts->deltaT[p] = pTrkPt->deltaT;
+    pts->dist[p] = pTrkPt->dist;
+    pts->rise[p] = pTrkPt->rise;
+    pts->run[p] = pTrkPt->run;
+    pts->bearing[p] = pTrkPt->bearing;
+    pts->grade[p] = pTrkPt->grade;
+
+    if (pts->pack && (pts->count == TRK_PTS_BLK_SIZE)) {
+        return packTrkPtsBlk(pts);
+    }
+
+    return 0;
+}
+
+// Mark the given TrkPt for deletion. The TrkPt stays in
+// place, so that the positions of the TrkPt's don't change
+// in the middle of a pass over the track, until the next call
+// to compactTrkPts().
+void delTrkPt(GpsTrk *pTrk, int p)
+{
+    TrkPts *pts = &pTrk->trkPts;
+
+    if (!(pts->flags[p] & TP_DELETED)) {
+        pts->flags[p] |= TP_DELETED;
+        pts->numDel++;
+    }
+}
+
+void delTrkPts(GpsTrk *pTrk, int p, int numPts)
+{
+    int n;
+
+    for (n = 0; n < numPts; n++) {
+        delTrkPt(pTrk, (p + n));
+    }
+}
+
+// Remove all the TrkPt's marked for deletion from the track,
+// in a single sweep that moves each run of remaining TrkPt's
+// down to fill the gaps. The positions of the min/max TrkPt's
+// in the GpsTrk are updated accordingly.
+void compactTrkPts(GpsTrk *pTrk)
+{
+    TrkPts *pts = &pTrk->trkPts;
+    int *refs[] = {
+        &pTrk->maxCadenceTrkPt, &pTrk->maxDeltaDTrkPt, &pTrk->maxDeltaGTrkPt,
+        &pTrk->maxDeltaTTrkPt, &pTrk->maxElevTrkPt, &pTrk->maxGradeTrkPt,
+        &pTrk->maxHeartRateTrkPt, &pTrk->maxPowerTrkPt, &pTrk->maxSpeedTrkPt,
+        &pTrk->maxTempTrkPt, &pTrk->minCadenceTrkPt, &pTrk->minDeltaDTrkPt,
+        &pTrk->minDeltaTTrkPt, &pTrk->minElevTrkPt, &pTrk->minGradeTrkPt,
+        &pTrk->minHeartRateTrkPt, &pTrk->minPowerTrkPt, &pTrk->minSpeedTrkPt,
+        &pTrk->minTempTrkPt
+    };
+    int numRefs = sizeof (refs) / sizeof (refs[0]);
+    int p = 0;  // read position
+    int q = 0;  // write position
+    int n;
+
+    if (pts->numDel == 0) {
+        // Nothing to do!
+        return;
+    }
+
+    while (p < pts->count) {
+        int start = p;
+
+        // Skip the deleted TrkPt's
+        while ((p < pts->count) && (pts->flags[p] & TP_DELETED)) {
+            p++;
+        }
+
+        for (n = 0; (start != p) && (n < numRefs); n++) {
+            if ((*refs[n] >= start) && (*refs[n] < p)) {
+                *refs[n] = -1;  // TrkPt is gone
+            }
+        }
+
+        for (n = start; (pts->pos != NULL) && (n < p); n++) {
+            pts->pos[pts->index[n]] = -1;
+        }
+
+        // Find the end of the run of remaining TrkPt's
+        start = p;
+        while ((p < pts->count) && !(pts->flags[p] & TP_DELETED)) {
+            p++;
+        }
+
+        if ((start == p) || (start == q)) {
+            // Nothing to move
+            q += (p - start);
+            continue;
+        }
+
+        for (n = 0; n < NUM_TRK_PTS_COLS; n++) {
+            const TrkPtsCol *pCol = &trkPtsCols[n];
+            char *col = *trkPtsCol(pts, pCol);
+            memmove((col + (q * pCol->size)), (col + (start * pCol->size)), ((p - start) * pCol->size));
+        }
+
+        for (n = 0; n < numRefs; n++) {
+            if ((*refs[n] >= start) && (*refs[n] < p)) {
+                *refs[n] -= (start - q);
+            }
+        }
+
+        for (n = q; (pts->pos != NULL) && (n < (q + (p - start))); n++) {
+            pts->pos[pts->index[n]] = n;
+        }
+
+        q += (p - start);
+    }
+
+    pts->count = q;
+    pts->numDel = 0;
+}
+
+// Move the TrkPt at position p down to position q (q <= p), or
+// drop it if it is marked for deletion. This allows the track
+// to be compacted on the fly, while it is being walked from
+// the start (see procTrkPtsFused). Returns false if the TrkPt
+// was dropped.
+Bool moveTrkPt(GpsTrk *pTrk, int q, int p)
+{
+    TrkPts *pts = &pTrk->trkPts;
+    int n;
+
+    if (pts->flags[p] & TP_DELETED) {
+        if (pts->pos != NULL) {
+            pts->pos[pts->index[p]] = -1;
+        }
+        pts->numDel--;
+        return false;
+    }
+
+    if (q != p) {
+        for (n = 0; n < NUM_TRK_PTS_COLS; n++) {
+            const TrkPtsCol *pCol = &trkPtsCols[n];
+            char *col = *trkPtsCol(pts, pCol);
+            memcpy((col + (q * pCol->size)), (col + (p * pCol->size)), pCol->size);
+        }
+    }
+
+    if (pts->pos != NULL) {
+        pts->pos[pts->index[q]] = q;
+    }
+
+    return true;
+}
+
+// Move all the TrkPt's of the source track to the end of the
+// given track. The TrkPt's are renumbered so that the indices
+// keep increasing across both tracks.
+int appendTrkPts(GpsTrk *pTrk, GpsTrk *pSrcTrk)
+{
+    TrkPts *pts = &pTrk->trkPts;
+    TrkPts *srcPts = &pSrcTrk->trkPts;
+    int numPts = srcPts->count;
+    int q = pts->count;     // position of the first appended TrkPt
+    int n;
+
+    for (n = 0; n < srcPts->numBlks; n++) {
+        numPts += srcPts->blks[n].count;
+    }
+
+    for (n = 0; n < srcPts->numSrcs; n++) {
+        srcPts->srcs[n].index += pTrk->numTrkPts;
+    }
+
+    if ((pts->count == 0) && (srcPts->numBlks == 0)) {
+        // Just take over the source arrays
+        free(pts->buf);
+        free(pts->srcs);
+        *pts = *srcPts;
+        pts->pack = false;
+        memset(srcPts, 0, sizeof (TrkPts));
+    } else {
+        for (n = 0; n < srcPts->numSrcs; n++) {
+            if (addTrkPtSrc(pts, srcPts->srcs[n].index, srcPts->srcs[n].inFile) != 0) {
+                return -1;
+            }
+        }
+        if (((pts->count + numPts) > pts->max) &&
+            (growTrkPts(pTrk, (pts->count + numPts)) != 0)) {
+            return -1;
+        }
+        for (n = 0; n < srcPts->numBlks; n++) {
+            unpackTrkPtsBlk(pts, pts->count, &srcPts->blks[n]);
+            pts->count += srcPts->blks[n].count;
+        }
+        for (n = 0; (srcPts->count != 0) && (n < NUM_TRK_PTS_COLS); n++) {
+            const TrkPtsCol *pCol = &trkPtsCols[n];
+            memcpy((*trkPtsCol(pts, pCol) + (pts->count * pCol->size)), *trkPtsCol(srcPts, pCol), (srcPts->count * pCol->size));
+        }
+        pts->count += srcPts->count;
+    }
+
+    for (n = q; n < pts->count; n++) {
+        pts->index[n] += pTrk->numTrkPts;
+    }
+
+    pTrk->numTrkPts += pSrcTrk->numTrkPts;
+
+    freeTrkPts(pSrcTrk);
+
+    return 0;
+}
+
+void freeTrkPts(GpsTrk *pTrk)
+{
+    int n;
+
+    free(pTrk->trkPts.buf);
+    free(pTrk->trkPts.srcs);
+    free(pTrk->trkPts.pos);
+    for (n = 0; n < pTrk->trkPts.numBlks; n++) {
+        free(pTrk->trkPts.blks[n].data);
+    }
+    free(pTrk->trkPts.blks);
+    free(pTrk->trkPts.blkBuf);
+    memset(&pTrk->trkPts, 0, sizeof (TrkPts));
+}
+
+// Build the table used to look up the position of a
+// TrkPt in the track by its index. Once built, the table
+// is kept up to date by compactTrkPts().
+int indexTrkPts(GpsTrk *pTrk)
+{
+    TrkPts *pts = &pTrk->trkPts;
+    int numPos = pTrk->numTrkPts;   // total number of TrkPt's read in
+    int p;
+
+    free(pts->pos);
+    if ((pts->pos = malloc((numPos + 1) * sizeof (int))) == NULL) {
+        fprintf(stderr, "Failed to alloc TrkPt index table !!!\n");
+        pts->numPos = 0;
+        return -1;
+    }
+    pts->numPos = numPos;
+
+    for (p = 0; p < numPos; p++) {
+        pts->pos[p] = -1;
+    }
+
+    for (p = 0; p < pts->count; p++) {
+        pts->pos[pts->index[p]] = p;
+    }
+
+    return 0;
+}
+
+// Return the position in the track of the TrkPt with the
+// given index, or -1 if there is no such TrkPt.
+int trkPtPos(const GpsTrk *pTrk, int index)
+{
+    const TrkPts *pts = &pTrk->trkPts;
+
+    if ((index < 0) || (index >= pts->numPos)) {
+        return -1;
+    }
+
+    return pts->pos[index];
+}
+
+// Fill in the state of the track at the given fraction of
+// the way between the two TrkPt's that bracket it.
+static void interpTrkPt(const TrkPts *pts, int p1, int p2, double frac, TrkPtState *pState)
+{
+    double lat1 = coordToDeg(pts->latitude[p1]);
+    double lon1 = coordToDeg(pts->longitude[p1]);
+    double time1 = timeToSec(pts->timestamp[p1]);
+
+    pState->p1 = p1;
+    pState->p2 = p2;
+    pState->frac = frac;
+    pState->timestamp = time1 + frac * (timeToSec(pts->timestamp[p2]) - time1);
+    pState->distance = pts->distance[p1] + frac * (pts->distance[p2] - pts->distance[p1]);
+    pState->latitude = lat1 + frac * (coordToDeg(pts->latitude[p2]) - lat1);
+    pState->longitude = lon1 + frac * (coordToDeg(pts->longitude[p2]) - lon1);
+    pState->elevation = pts->elevation[p1] + frac * (pts->elevation[p2] - pts->elevation[p1]);
+    pState->speed = pts->speed[p1] + frac * (pts->speed[p2] - pts->speed[p1]);
+}
+
+// Seek the point of the track at which the given monotonic
+// key array (one value per TrkPt; e.g. pts->distance) reaches
+// the specified key value. Returns the position of the first
+// TrkPt at or after that point, or -1 if the key value is
+// past the end of the track. If requested, the state of the
+// track at that point is also interpolated from the two
+// TrkPt's that bracket it.
+int seekTrkPt(const GpsTrk *pTrk, const double *keys, double key, TrkPtState *pState)
+{
+    const TrkPts *pts = &pTrk->trkPts;
+    int lo = 0, hi = pts->count;
+    int p2;
+
+    // Binary search for the first TrkPt with a key
+    // value that is not less than the given one.
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (keys[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if ((p2 = lo) == pts->count) {
+        // Past the end of the track
+        return -1;
+    }
+
+    if (pState != NULL) {
+        if ((p2 == 0) || (keys[p2] == key)) {
+            // No need to interpolate
+            interpTrkPt(pts, p2, p2, 0.0, pState);
+        } else {
+            interpTrkPt(pts, (p2 - 1), p2, ((key - keys[p2 - 1]) / (keys[p2] - keys[p2 - 1])), pState);
+        }
+    }
+
+    return p2;
+}
+
+// Same as seekTrkPt(), but using the timestamp (in seconds
+// since the Epoch) of the TrkPt's as the key.
+int seekTrkPtByTime(const GpsTrk *pTrk, double timestamp, TrkPtState *pState)
+{
+    const TrkPts *pts = &pTrk->trkPts;
+    TimeVal key = secToTime(timestamp);
+    int lo = 0, hi = pts->count;
+    int p2;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (pts->timestamp[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if ((p2 = lo) == pts->count) {
+        // Past the end of the track
+        return -1;
+    }
+
+    if (pState != NULL) {
+        if ((p2 == 0) || (pts->timestamp[p2] == key)) {
+            // No need to interpolate
+            interpTrkPt(pts, p2, p2, 0.0, pState);
+        } else {
+            double time1 = timeToSec(pts->timestamp[p2 - 1]);
+            interpTrkPt(pts, (p2 - 1), p2, ((timestamp - time1) / (timeToSec(pts->timestamp[p2]) - time1)), pState);
+        }
+    }
+
+    return p2;
+}
+
+// Return the input file the given TrkPt came from
+const char *trkPtInFile(const GpsTrk *pTrk, int p)
+{
+    const TrkPts *pts = &pTrk->trkPts;
+    int index = pts->index[p];
+    int lo = 0, hi = (pts->numSrcs - 1);
+
+    // Binary search for the last run of TrkPt's that
+    // starts at, or before, the given TrkPt.
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (pts->srcs[mid].index <= index) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    return pts->srcs[lo].inFile;
+}
+
+const char *fmtTrkPtIdx(const GpsTrk *pTrk, int p)
 {
     static char fmtBuf[1024];
 
-    snprintf(fmtBuf, sizeof (fmtBuf), "%s:%u", pTrkPt->inFile, pTrkPt->lineNum);
+    snprintf(fmtBuf, sizeof (fmtBuf), "%s:%u", trkPtInFile(pTrk, p), pTrk->trkPts.lineNum[p]);
 
     return fmtBuf;
 }
 
-void printTrkPt(TrkPt *p)
+void printTrkPt(const GpsTrk *pTrk, int p)
 {
-    fprintf(stderr, "TrkPt #%u at %s {\n", p->index, fmtTrkPtIdx(p));
+    const TrkPts *pts = &pTrk->trkPts;
+
+    fprintf(stderr, "TrkPt #%u at %s {\n", pts->index[p], fmtTrkPtIdx(pTrk, p));
     fprintf(stderr, "  latitude=%.10lf longitude=%.10lf elevation=%.10lf time=%.3lf distance=%.10lf speed=%.10lf dist=%.10lf run=%.10lf rise=%.10lf grade=%.2lf\n",
-            p->latitude, p->longitude, p->elevation, p->timestamp, p->distance, p->speed, p->dist, p->run, p->rise, p->grade);
+            coordToDeg(pts->latitude[p]), coordToDeg(pts->longitude[p]), pts->elevation[p], timeToSec(pts->timestamp[p]), pts->distance[p], pts->speed[p], pts->dist[p], pts->run[p], pts->rise[p], pts->grade[p]);
     fprintf(stderr, "}\n");
 }
 
 // Dump the specified number of track points before and
 // after the given TrkPt.
-void dumpTrkPts(GpsTrk *pTrk, TrkPt *p, int numPtsBefore, int numPtsAfter)
+void dumpTrkPts(const GpsTrk *pTrk, int p, int numPtsBefore, int numPtsAfter)
 {
-    int i;
-    TrkPt *tp;
+    int tp;
 
     // Rewind numPtsBefore points...
-    for (i = 0, tp = p; (i < numPtsBefore) && (tp != NULL); i++) {
-        tp = TAILQ_PREV(tp, TrkPtList, tqEntry);
-    }
+    tp = (p > numPtsBefore) ? (p - numPtsBefore) : 0;
 
     // Points before the given point
     while (tp != p) {
-        printTrkPt(tp);
-        tp = TAILQ_NEXT(tp, tqEntry);
+        printTrkPt(pTrk, tp++);
     }
 
     // The point in question
-    printTrkPt(p);
+    printTrkPt(pTrk, p);
 
     // Points after the given point
-    for (i = 0, tp = TAILQ_NEXT(p, tqEntry); (i < numPtsAfter) && (tp != NULL); i++, tp = TAILQ_NEXT(tp, tqEntry)) {
-        printTrkPt(tp);
+    for (tp = (p + 1); (tp <= (p + numPtsAfter)) && (tp < pTrk->trkPts.count); tp++) {
+        printTrkPt(pTrk, tp);
     }
 }
-
-
@@ -23,12 +23,25 @@
 extern "C" {
 #endif
 
-extern TrkPt *nxtTrkPt(TrkPt **p1, TrkPt *p2);
-extern TrkPt *remTrkPt(GpsTrk *pTrk, TrkPt *p);
-extern TrkPt *newTrkPt(int index, const char *inFile, int lineNum);
-extern const char *fmtTrkPtIdx(const TrkPt *pTrkPt);
-extern void printTrkPt(TrkPt *p);
-extern void dumpTrkPts(GpsTrk *pTrk, TrkPt *p, int numPtsBefore, int numPtsAfter);
+extern TrkPt *newTrkPt(GpsTrk *pTrk, TrkPt *pTrkPt, const char *inFile, int lineNum);
+extern int addTrkPt(GpsTrk *pTrk, const TrkPt *pTrkPt);
+extern void delTrkPt(GpsTrk *pTrk, int p);
+extern void delTrkPts(GpsTrk *pTrk, int p, int numPts);
+extern void compactTrkPts(GpsTrk *pTrk);
+extern Bool moveTrkPt(GpsTrk *pTrk, int q, int p);
+extern int appendTrkPts(GpsTrk *pTrk, GpsTrk *pSrcTrk);
+extern void packTrkPts(GpsTrk *pTrk);
+extern int flushTrkPts(GpsTrk *pTrk);
+extern int reserveTrkPts(GpsTrk *pTrk, int numPts);
+extern void freeTrkPts(GpsTrk *pTrk);
+extern int indexTrkPts(GpsTrk *pTrk);
+extern int trkPtPos(const GpsTrk *pTrk, int index);
+extern int seekTrkPt(const GpsTrk *pTrk, const double *keys, double key, TrkPtState *pState);
+extern int seekTrkPtByTime(const GpsTrk *pTrk, double timestamp, TrkPtState *pState);
+extern const char *trkPtInFile(const GpsTrk *pTrk, int p);
+extern const char *fmtTrkPtIdx(const GpsTrk *pTrk, int p);
+extern void printTrkPt(const GpsTrk *pTrk, int p);
+extern void dumpTrkPts(const GpsTrk *pTrk, int p, int numPtsBefore, int numPtsAfter);
 
 #ifdef __cplusplus
 };